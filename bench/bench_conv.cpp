@@ -0,0 +1,436 @@
+// bench_conv: micro-benchmarks for the app's hot paths, run against the
+// offline stand-in SDK so results do not depend on the network.
+//
+//   bench_conv [--filter substr] [--min-time seconds] [--json out.json] [--data-dir dir]
+//
+// Prints a table (ns/op, MB/s, allocations/op) and, with --json, writes the
+// same results as JSON for comparing runs.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_log.h"
+#include "audio_handler.h"
+#include "base64.h"
+#include "bench_harness.h"
+#include "conversation.h"
+#include "conversation_handler.h"
+#include "conversation_utils.h"
+#include "json/json.h"
+#include "mapped_audio.h"
+#include "response_fields.h"
+
+using namespace convsdk;
+
+// Globals normally owned by main.cpp.
+std::string g_log_level = "error";
+std::string g_mode = "push2talk";
+std::string g_url = "ws://127.0.0.1:0/";
+std::string g_output_dir = "tmp";
+std::string g_workspace_dir = "resources_aec_kws_vad_android";
+Conversation* conversation = NULL;
+DialogStateMonitor g_dialog_state;
+EventDispatcher g_event_dispatcher(HandleEventRecord);
+RoundTracer g_round_tracer;
+ConnectionManager g_connection;
+double g_send_speed = 0.0;
+std::string g_uplink_format = "pcm";
+std::string g_opus_cache_dir = "tmp/opus_cache";
+EventLogWriter* g_event_log = NULL;
+VqaCache g_vqa_cache;
+TtsQueue g_tts_queue;
+TranscriptStore g_transcripts;
+
+namespace {
+#ifndef CONV_SOURCE_DIR
+#define CONV_SOURCE_DIR "."
+#endif
+
+// One 80 ms downlink packet at 24 kHz, as the service sends them.
+const std::size_t kDownlinkPacketBytes = 3840;
+// The pcm writer queues at most 256 chunks; drain well before that.
+const uint64_t kSaveBatch = 64;
+const std::size_t kUplinkChunkBytes = 640;
+
+struct BenchOptions {
+    std::string filter;
+    std::string json_path;
+    std::string data_dir = CONV_SOURCE_DIR;
+    double min_time_s = 0.5;
+};
+
+bool FileSize(const std::string& path, uint64_t* size) {
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    *size = static_cast<uint64_t>(in.tellg());
+    return true;
+}
+
+// The Json::Value builders the request templates replaced, kept as the
+// baseline and as the reference output.
+std::string JsoncppTtsRequest(const std::string& text) {
+    Json::Value root;
+    root["text"] = text;
+    root["type"] = "transcript";
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    return Json::writeString(writer, root);
+}
+
+std::string JsoncppInitParams() {
+    Json::FastWriter writer;
+    Json::Value root;
+    root["mode"] = g_mode;
+    root["chain_mode"] = "ws";
+    root["ws_version"] = 3;
+    root["debug_mode"] = "normal";
+    root["workspace"] = g_workspace_dir;
+    root["save_log"] = true;
+    root["save_wav"] = true;
+    root["log_level"] = g_log_level;
+    root["url"] = g_url;
+    root["apikey"] = "sk-cebc306c1a7d44579af8d99c199789a2";
+    root["app_id"] = "mm_62600140f1b743d7bad25d552b78";
+    root["workspace_id"] = "llm-2d2jbauuwkp1250n";
+    root["debug_path"] = g_output_dir + "/";
+    Json::Value upstream;
+    upstream["type"] = "AudioOnly";
+    upstream["audio_format"] = "pcm";
+    upstream["sample_rate"] = 16000;
+    root["upstream"] = upstream;
+    Json::Value downstream;
+    downstream["type"] = "Audio";
+    downstream["voice"] = "longanhuan";
+    downstream["sample_rate"] = 24000;
+    downstream["audio_format"] = "pcm";
+    downstream["intermediate_text"] = "transcript,dialog";
+    downstream["debug"] = true;
+    root["downstream"] = downstream;
+    root["client_info"]["user_id"] = "bin23439207";
+    root["dialog_attributes"]["prompt"] = "你是个有用的助手。";
+    root["acoustic_echo_cancelling_attributes"]["enable_external_aec_module"] = false;
+    root["voice_activity_detection_attributes"]["enable_external_vad_module"] = false;
+    root["key_words_spotting_attributes"]["enable_external_kws_module"] = false;
+    root["key_words_spotting_attributes"]["independent_kws_mode"] = false;
+    return writer.write(root);
+}
+
+// Short TTS prompt with characters that need escaping.
+const char kBenchTtsText[] = "幸福是一种技能，是你摒弃了外在多余欲望后的\"内心平和\"。\n";
+
+// A kRespondingDetail frame as the service sends it, midway through a reply.
+const char kBenchResponseDetail[] =
+    "{\"header\":{\"event\":\"result-generated\",\"task_id\":\"9b1c0f6e-5a4d-4c1e-8f0a-2d7e3b6a1c55\"},"
+    "\"payload\":{\"output\":{\"event\":\"RespondingContent\","
+    "\"dialog_id\":\"5d3e7a1b-02f4-4c8e-9b6d-a1f0e2c3b4d5\",\"round_id\":\"c0ffee-round-7\","
+    "\"llm_request_id\":\"2f9a8b7c-6d5e-4f3a-b2c1-d0e9f8a7b6c5\",\"text\":\"你好，我是一个离线测试用的语音助手，\","
+    "\"spoken\":\"你好，我是一个离线测试用的语音助手，\",\"finished\":false,"
+    "\"extra_info\":{\"commands\":\"[]\",\"tool_calls\":[]}}}}";
+
+void OnBenchMessage(ConvEvent*, void*) {}
+
+// Connect the stand-in SDK and open the uplink so SendAudioData accepts data.
+bool ConnectForUplink() {
+    if (conversation) return true;
+    conversation = Conversation::CreateConversation(OnBenchMessage, NULL, NULL);
+    if (!conversation) return false;
+    std::string params = gen_init_params();
+    if (conversation->Connect(params.c_str()) != kSuccess) return false;
+    return conversation->SetAction(kStartHumanSpeech) == kSuccess;
+}
+
+void RegisterBenchmarks(BenchRunner& runner, const BenchOptions& options) {
+    const std::string wav_path = options.data_dir + "/audio_16k.wav";
+    const std::string image_path = options.data_dir + "/test_img.jpg";
+
+    // Downlink packet -> pooled writer queue (I/O thread drains untimed).
+    runner.Register("save_binary_event", [](BenchState& state) {
+        std::vector<unsigned char> pcm(kDownlinkPacketBytes, 0x11);
+        ConvEvent event(pcm, "{\"payload\":{\"output\":{\"event\":\"AudioData\",\"dialog_id\":\"bench\"}}}", "");
+        if (event.GetBinaryDataSize() != static_cast<int>(kDownlinkPacketBytes)) {
+            state.SkipWithError("SDK did not build a binary event");
+            return;
+        }
+        state.SetBytesPerOp(kDownlinkPacketBytes);
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            SaveBinaryEventToFile(&event);
+            if ((i + 1) % kSaveBatch == 0) {
+                state.PauseTiming();
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                state.ResumeTiming();
+            }
+        }
+    });
+
+    // SendAudioFile read loop with pacing disabled, 20 ms chunks.
+    runner.Register("send_audio_file_unpaced", [wav_path](BenchState& state) {
+        std::string error;
+        std::shared_ptr<const MappedAudioFile> file = MappedAudioFile::Open(wav_path, &error);
+        if (!file) {
+            state.SkipWithError(error);
+            return;
+        }
+        if (!ConnectForUplink()) {
+            state.SkipWithError("stand-in SDK did not accept audio");
+            return;
+        }
+        state.SetBytesPerOp(file->payload_size());
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            SendAudioFile(conversation, wav_path, "pcm", 16000, kUplinkChunkBytes, true, 0.0);
+        }
+    });
+
+    // Same corpus through the opus uplink: cached packets, no encoder.
+    runner.Register("send_opus_frames_unpaced", [wav_path](BenchState& state) {
+        OpusFrameCache::Frames frames;
+        std::string error;
+        if (!OpusFrameCache::Load(wav_path, g_opus_cache_dir, &frames, &error)) {
+            state.SkipWithError(error);
+            return;
+        }
+        if (!ConnectForUplink()) {
+            state.SkipWithError("stand-in SDK did not accept audio");
+            return;
+        }
+        state.SetBytesPerOp(frames.pcm_bytes);
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            SendOpusFrames(conversation, frames, 0.0);
+        }
+    });
+
+    runner.Register("gen_init_params", [](BenchState& state) {
+        if (gen_init_params() != JsoncppInitParams()) {
+            state.SkipWithError("output differs from jsoncpp");
+            return;
+        }
+        uint64_t bytes = 0;
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            std::string params = gen_init_params();
+            bytes = params.size();
+            DoNotOptimize(params);
+        }
+        state.SetBytesPerOp(bytes);
+    });
+
+    runner.Register("gen_init_params_jsoncpp", [](BenchState& state) {
+        uint64_t bytes = 0;
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            std::string params = JsoncppInitParams();
+            bytes = params.size();
+            DoNotOptimize(params);
+        }
+        state.SetBytesPerOp(bytes);
+    });
+
+    runner.Register("gen_tts_request", [](BenchState& state) {
+        const std::string text = kBenchTtsText;
+        if (gen_tts_request(text) != JsoncppTtsRequest(text)) {
+            state.SkipWithError("output differs from jsoncpp");
+            return;
+        }
+        uint64_t bytes = 0;
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            std::string request = gen_tts_request(text);
+            bytes = request.size();
+            DoNotOptimize(request);
+        }
+        state.SetBytesPerOp(bytes);
+    });
+
+    // What text_to_speech_request sends: no copy out of the scratch buffer.
+    runner.Register("tts_request_json", [](BenchState& state) {
+        const std::string text = kBenchTtsText;
+        uint64_t bytes = 0;
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            const std::string& request = tts_request_json(text);
+            bytes = request.size();
+            DoNotOptimize(request);
+        }
+        state.SetBytesPerOp(bytes);
+    });
+
+    runner.Register("gen_tts_request_jsoncpp", [](BenchState& state) {
+        const std::string text = kBenchTtsText;
+        uint64_t bytes = 0;
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            std::string request = JsoncppTtsRequest(text);
+            bytes = request.size();
+            DoNotOptimize(request);
+        }
+        state.SetBytesPerOp(bytes);
+    });
+
+    runner.Register("extract_response_fields", [](BenchState& state) {
+        const std::string response = kBenchResponseDetail;
+        ResponseFields fields;
+        if (!ExtractResponseFields(response, &fields) || fields.round_id != "c0ffee-round-7" || fields.finished) {
+            state.SkipWithError("extractor did not find the fields");
+            return;
+        }
+        state.SetBytesPerOp(response.size());
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            ExtractResponseFields(response, &fields);
+            DoNotOptimize(fields.text);
+        }
+    });
+
+    // The DOM parse a handler needed for the same fields.
+    runner.Register("extract_response_fields_jsoncpp", [](BenchState& state) {
+        const std::string response = kBenchResponseDetail;
+        state.SetBytesPerOp(response.size());
+        Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            Json::Value root;
+            std::string errs;
+            reader->parse(response.data(), response.data() + response.size(), &root, &errs);
+            const Json::Value& output = root["payload"]["output"];
+            std::string text = output["text"].asString();
+            bool finished = output["finished"].asBool();
+            DoNotOptimize(text);
+            DoNotOptimize(finished);
+        }
+    });
+
+    // Streamed replies: cumulative details in, appended suffixes out. The
+    // budget is small so rounds are evicted and blocks recycled as well.
+    runner.Register("transcript_store_update", [](BenchState& state) {
+        const std::string reply = "你好，我是一个离线测试用的语音助手，这段回复由脚本生成。";
+        std::vector<std::string> partials;
+        for (std::size_t upto = 3; upto <= reply.size(); upto += 3) partials.push_back(reply.substr(0, upto));
+        std::vector<std::string> round_ids;
+        for (int r = 0; r < 1024; ++r) round_ids.push_back("round-" + std::to_string(r));
+        TranscriptStore store;
+        store.Configure(256u << 10);
+        state.SetBytesPerOp(reply.size());
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            const std::string& round_id = round_ids[i % round_ids.size()];
+            for (std::size_t p = 0; p < partials.size(); ++p) {
+                TranscriptStore::Change change = store.Update(TranscriptStore::kSpeakerAssistant, "dialog",
+                                                              round_id, partials[p], p + 1 == partials.size());
+                DoNotOptimize(change.size);
+            }
+        }
+    });
+
+    runner.Register("gen_vqa_request", [image_path](BenchState& state) {
+        uint64_t image_bytes = 0;
+        if (!FileSize(image_path, &image_bytes)) {
+            state.SkipWithError("cannot read " + image_path);
+            return;
+        }
+        state.SetBytesPerOp(image_bytes);
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            std::string request = gen_vqa_request(image_path);
+            DoNotOptimize(request);
+        }
+    });
+
+    // In-memory encode only, to compare the vector path with the scalar one.
+    std::vector<uint8_t> image_data;
+    {
+        std::ifstream in(image_path.c_str(), std::ios::binary);
+        image_data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    runner.Register(std::string("base64_encode_") + Base64Backend(), [image_data](BenchState& state) {
+        if (image_data.empty()) {
+            state.SkipWithError("no image data");
+            return;
+        }
+        std::string out(Base64EncodedSize(image_data.size()), '\0');
+        state.SetBytesPerOp(image_data.size());
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            Base64Encode(image_data.data(), image_data.size(), &out[0]);
+            DoNotOptimize(out);
+        }
+    });
+
+    runner.Register("base64_encode_scalar", [image_data](BenchState& state) {
+        if (image_data.empty()) {
+            state.SkipWithError("no image data");
+            return;
+        }
+        std::string out(Base64EncodedSize(image_data.size()), '\0');
+        state.SetBytesPerOp(image_data.size());
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            Base64EncodeScalar(image_data.data(), image_data.size(), &out[0]);
+            DoNotOptimize(out);
+        }
+    });
+
+    runner.Register("base64_encode_from_file", [image_path](BenchState& state) {
+        uint64_t image_bytes = 0;
+        if (!FileSize(image_path, &image_bytes)) {
+            state.SkipWithError("cannot read " + image_path);
+            return;
+        }
+        state.SetBytesPerOp(image_bytes);
+        ConversationUtils utils;
+        for (uint64_t i = 0; i < state.iterations(); ++i) {
+            std::string encoded = utils.Base64EncodeFromFilePath(image_path);
+            DoNotOptimize(encoded);
+        }
+    });
+}
+
+bool ParseArgs(int argc, char* argv[], BenchOptions* options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            options->filter = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            options->json_path = argv[++i];
+        } else if (arg == "--data-dir" && i + 1 < argc) {
+            options->data_dir = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options->min_time_s = std::atof(argv[++i]);
+        } else {
+            std::printf("usage: %s [--filter substr] [--min-time seconds] [--json out.json] [--data-dir dir]\n",
+                        argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!ParseArgs(argc, argv, &options)) return 1;
+
+    // Only errors reach the log; the hot paths still evaluate their LOGx calls.
+    AsyncLog::Instance().SetLevel(AsyncLog::ParseLevel(g_log_level));
+    AsyncLog::Instance().Start();
+
+    BenchRunner runner;
+    RegisterBenchmarks(runner, options);
+    std::vector<BenchResult> results = runner.RunAll(options.filter, options.min_time_s);
+
+    if (conversation) {
+        conversation->Disconnect();
+        conversation->DestroyConversation();
+        conversation = NULL;
+    }
+    CloseSessionWriters();
+    AsyncLog::Instance().Stop();
+
+    BenchRunner::PrintTable(results);
+    if (!options.json_path.empty()) {
+        char context[512];
+        std::snprintf(context, sizeof(context), "stand-in SDK, data %s, min time %.2f s",
+                      options.data_dir.c_str(), options.min_time_s);
+        std::ofstream out(options.json_path.c_str());
+        out << BenchRunner::ToJson(results, context);
+        if (!out) {
+            std::fprintf(stderr, "failed to write %s\n", options.json_path.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
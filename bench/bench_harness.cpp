@@ -0,0 +1,175 @@
+#include "bench_harness.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "json/json.h"
+
+namespace {
+std::atomic<uint64_t> g_alloc_count(0);
+std::atomic<uint64_t> g_alloc_bytes(0);
+
+void* CountedAlloc(std::size_t size) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    return p;
+}
+
+// Stop doubling once a single run would exceed this many operations.
+const uint64_t kMaxIterations = 1ULL << 30;
+}
+
+void* operator new(std::size_t size) {
+    void* p = CountedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    void* p = CountedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return CountedAlloc(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+uint64_t BenchAllocCount() {
+    return g_alloc_count.load(std::memory_order_relaxed);
+}
+
+uint64_t BenchAllocBytes() {
+    return g_alloc_bytes.load(std::memory_order_relaxed);
+}
+
+BenchState::BenchState(uint64_t iterations)
+    : iterations_(iterations),
+      bytes_per_op_(0),
+      paused_(true),
+      elapsed_(Clock::duration::zero()),
+      allocs_started_(0),
+      alloc_bytes_started_(0),
+      allocs_(0),
+      alloc_bytes_(0) {}
+
+void BenchState::PauseTiming() {
+    if (paused_) return;
+    elapsed_ += Clock::now() - started_;
+    allocs_ += BenchAllocCount() - allocs_started_;
+    alloc_bytes_ += BenchAllocBytes() - alloc_bytes_started_;
+    paused_ = true;
+}
+
+void BenchState::ResumeTiming() {
+    if (!paused_) return;
+    paused_ = false;
+    allocs_started_ = BenchAllocCount();
+    alloc_bytes_started_ = BenchAllocBytes();
+    started_ = Clock::now();
+}
+
+void BenchRunner::Register(const std::string& name, Function fn) {
+    benchmarks_.push_back(std::make_pair(name, fn));
+}
+
+std::vector<BenchResult> BenchRunner::RunAll(const std::string& filter, double min_time_s) {
+    std::vector<BenchResult> results;
+    for (std::size_t i = 0; i < benchmarks_.size(); ++i) {
+        if (!filter.empty() && benchmarks_[i].first.find(filter) == std::string::npos) continue;
+        results.push_back(Run(benchmarks_[i].first, benchmarks_[i].second, min_time_s));
+    }
+    return results;
+}
+
+BenchResult BenchRunner::Run(const std::string& name, const Function& fn, double min_time_s) {
+    BenchResult result;
+    result.name = name;
+
+    // One untimed warm-up op fills caches, lazily opened files and pools.
+    {
+        BenchState warmup(1);
+        warmup.ResumeTiming();
+        fn(warmup);
+        warmup.PauseTiming();
+        if (!warmup.error_.empty()) {
+            result.error = warmup.error_;
+            return result;
+        }
+    }
+
+    for (uint64_t iterations = 1;; iterations *= 2) {
+        BenchState state(iterations);
+        state.ResumeTiming();
+        fn(state);
+        state.PauseTiming();
+        if (!state.error_.empty()) {
+            result.error = state.error_;
+            return result;
+        }
+
+        double seconds = std::chrono::duration<double>(state.elapsed_).count();
+        if (seconds >= min_time_s || iterations >= kMaxIterations) {
+            double ops = static_cast<double>(iterations);
+            result.iterations = iterations;
+            result.ns_per_op = seconds * 1e9 / ops;
+            result.bytes_per_second = seconds > 0 ? state.bytes_per_op_ * ops / seconds : 0;
+            result.allocs_per_op = state.allocs_ / ops;
+            result.alloc_bytes_per_op = state.alloc_bytes_ / ops;
+            return result;
+        }
+    }
+}
+
+void BenchRunner::PrintTable(const std::vector<BenchResult>& results) {
+    std::printf("%-28s %12s %14s %14s %12s %14s\n", "benchmark", "iterations", "ns/op", "MB/s",
+                "allocs/op", "alloc B/op");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        if (!r.error.empty()) {
+            std::printf("%-28s skipped: %s\n", r.name.c_str(), r.error.c_str());
+            continue;
+        }
+        std::printf("%-28s %12llu %14.1f %14.2f %12.2f %14.1f\n", r.name.c_str(),
+                    static_cast<unsigned long long>(r.iterations), r.ns_per_op,
+                    r.bytes_per_second / 1e6, r.allocs_per_op, r.alloc_bytes_per_op);
+    }
+}
+
+std::string BenchRunner::ToJson(const std::vector<BenchResult>& results, const std::string& context) {
+    Json::Value root;
+    root["context"] = context;
+    Json::Value list(Json::arrayValue);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        Json::Value item;
+        item["name"] = r.name;
+        if (!r.error.empty()) {
+            item["error"] = r.error;
+        } else {
+            item["iterations"] = static_cast<Json::UInt64>(r.iterations);
+            item["ns_per_op"] = r.ns_per_op;
+            item["bytes_per_second"] = r.bytes_per_second;
+            item["allocs_per_op"] = r.allocs_per_op;
+            item["alloc_bytes_per_op"] = r.alloc_bytes_per_op;
+        }
+        list.append(item);
+    }
+    root["benchmarks"] = list;
+
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "  ";
+    return Json::writeString(writer, root) + "\n";
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 微基准测试框架
+ *
+ * Minimal harness for bench_conv. Each benchmark is a function that runs
+ * state.iterations() operations; the harness doubles the iteration count
+ * until a run lasts at least the minimum time, then reports that run.
+ *
+ * Allocations are counted by a replacement global operator new, so the
+ * per-op figures are process wide: background threads (log writer, PCM
+ * writer) allocating during a timed region are included.
+ */
+class BenchState {
+ public:
+    explicit BenchState(uint64_t iterations);
+
+    uint64_t iterations() const { return iterations_; }
+
+    // Exclude setup / drain work from time and allocation counts.
+    void PauseTiming();
+    void ResumeTiming();
+
+    // Payload bytes handled per op, for the bytes/s column.
+    void SetBytesPerOp(uint64_t bytes) { bytes_per_op_ = bytes; }
+    // Mark the benchmark as not runnable here (missing input, no SDK, ...).
+    void SkipWithError(const std::string& reason) { error_ = reason; }
+
+ private:
+    friend class BenchRunner;
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t iterations_;
+    uint64_t bytes_per_op_;
+    std::string error_;
+    bool paused_;
+    Clock::time_point started_;
+    Clock::duration elapsed_;
+    uint64_t allocs_started_;
+    uint64_t alloc_bytes_started_;
+    uint64_t allocs_;
+    uint64_t alloc_bytes_;
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations = 0;
+    double ns_per_op = 0;
+    double bytes_per_second = 0;
+    double allocs_per_op = 0;
+    double alloc_bytes_per_op = 0;
+    std::string error;
+};
+
+class BenchRunner {
+ public:
+    typedef std::function<void(BenchState&)> Function;
+
+    void Register(const std::string& name, Function fn);
+
+    // Run every benchmark whose name contains `filter`.
+    std::vector<BenchResult> RunAll(const std::string& filter, double min_time_s);
+
+    static void PrintTable(const std::vector<BenchResult>& results);
+    static std::string ToJson(const std::vector<BenchResult>& results, const std::string& context);
+
+ private:
+    BenchResult Run(const std::string& name, const Function& fn, double min_time_s);
+
+    std::vector<std::pair<std::string, Function> > benchmarks_;
+};
+
+// Keep the optimizer from discarding a computed value.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Process-wide allocation counters maintained by the operator new override.
+uint64_t BenchAllocCount();
+uint64_t BenchAllocBytes();
@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "conv_constants.h"
+
+/**
+ * @brief 异步日志
+ *
+ * Log calls format into a ring buffer owned by the calling thread and return;
+ * a background thread drains all rings and writes them with batched write()
+ * calls (warnings and errors to stderr, the rest to stdout). Callers never
+ * take the iostream lock or wait on a terminal or pipe.
+ *
+ * The level check happens in the CONV_LOG macros before any argument is
+ * formatted. When a thread's ring is full the line is dropped and counted.
+ * A line longer than one slot is spread over up to kMaxLineParts slots and
+ * written out whole; only text beyond that is cut (and counted). Before
+ * Start() and after Stop() lines are written synchronously.
+ */
+class AsyncLog {
+ public:
+    static const std::size_t kLineBytes = 512;      // one ring slot
+    static const std::size_t kMaxLineParts = 16;    // slots one line may span
+    static const std::size_t kLinesPerThread = 1024;
+
+    struct Stats {
+        uint64_t written;
+        uint64_t dropped;
+        uint64_t truncated;
+    };
+
+    static AsyncLog& Instance();
+
+    // "verbose", "debug", "info", "warn", "error" (same strings as g_log_level).
+    static convsdk::ConvLogLevel ParseLevel(const std::string& name);
+
+    void SetLevel(convsdk::ConvLogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    bool Enabled(convsdk::ConvLogLevel level) const {
+        return level >= level_.load(std::memory_order_relaxed) && level < convsdk::kConvLogLevelNone;
+    }
+
+    void Start();
+    // Drain everything and stop the writer thread.
+    void Stop();
+    // Block until every line logged before the call has been written.
+    void Flush();
+
+    void Write(convsdk::ConvLogLevel level, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    Stats GetStats() const;
+
+    struct ThreadBuffer;
+
+ private:
+    AsyncLog();
+    ~AsyncLog();
+
+    ThreadBuffer* LocalBuffer();
+    void WriterMain();
+    // Returns the number of ring slots consumed.
+    std::size_t DrainOnce();
+
+    std::atomic<int> level_;
+    std::atomic<bool> running_;
+    std::thread writer_;
+
+    std::mutex buffers_lock_;
+    std::vector<ThreadBuffer*> buffers_;
+
+    std::atomic<uint64_t> written_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> truncated_;
+    std::atomic<uint64_t> sweeps_;
+
+    // Writer-side batches: [0] stdout, [1] stderr.
+    std::vector<char> batch_[2];
+};
+
+#define CONV_LOG(level, ...)                                  \
+    do {                                                      \
+        if (AsyncLog::Instance().Enabled(level)) {            \
+            AsyncLog::Instance().Write(level, __VA_ARGS__);   \
+        }                                                     \
+    } while (0)
+
+#define LOGV(...) CONV_LOG(convsdk::kConvLogLevelVerbose, __VA_ARGS__)
+#define LOGD(...) CONV_LOG(convsdk::kConvLogLevelDebug, __VA_ARGS__)
+#define LOGI(...) CONV_LOG(convsdk::kConvLogLevelInfo, __VA_ARGS__)
+#define LOGW(...) CONV_LOG(convsdk::kConvLogLevelWarning, __VA_ARGS__)
+#define LOGE(...) CONV_LOG(convsdk::kConvLogLevelError, __VA_ARGS__)
@@ -18,6 +18,7 @@
 #include <ctime>
 
 #include "conversation.h"
+#include "opus_frame_cache.h"
 
 extern convsdk::Conversation* conversation;
 
@@ -26,6 +27,20 @@ bool SendAudioFile(convsdk::Conversation* conversation,
 				   const std::string& audio_format,
 				   int sample_rate,
 				   std::size_t chunk_size,
-				   bool skip_wav_header=false);
+				   bool skip_wav_header=false,
+				   double speed=1.0);  // 1.0 = real time, 0 = no pacing
 
-void SaveBinaryEventToFile(convsdk::ConvEvent* event);
\ No newline at end of file
+// Stream pre-encoded packets with kEncoderOpu2, one per SendAudioData
+// call, paced at 20 ms per packet like the PCM it was encoded from.
+bool SendOpusFrames(convsdk::Conversation* conversation,
+                    const OpusFrameCache::Frames& frames,
+                    double speed=1.0);
+
+void SaveBinaryEventToFile(convsdk::ConvEvent* event);
+
+// Same as SaveBinaryEventToFile for a payload already copied out of the
+// callback; `data` is handed to the writer and comes back as a recycled buffer.
+void SaveBinaryToFile(const std::string& session_id, std::vector<unsigned char>& data);
+
+// Drain and close all per-session downlink writers (call before exit).
+void CloseSessionWriters();
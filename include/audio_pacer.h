@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+
+/**
+ * @brief 实时推流节拍器
+ *
+ * Paces a stream against absolute steady_clock deadlines. The caller passes
+ * the media position (in ns from the start of the stream) of the chunk it is
+ * about to send; the pacer sleeps until start + position / speed. Because the
+ * deadline is absolute, time spent in SendAudioData or oversleeping is not
+ * accumulated into the next chunk.
+ *
+ * speed: 1.0 = real time, 2.0 = twice real time, 0 = as fast as possible.
+ */
+class AudioPacer {
+ public:
+    struct Stats {
+        uint64_t chunks = 0;
+        uint64_t late_chunks = 0;     // woke more than kLateThresholdUs after the deadline
+        int64_t max_jitter_us = 0;    // worst wake-up lateness
+        int64_t total_jitter_us = 0;  // sum of wake-up lateness, for the mean
+        int64_t final_drift_us = 0;   // wall clock minus paced media time at Finish()
+        uint64_t media_us = 0;        // media time covered
+        uint64_t wall_us = 0;         // wall time spent
+    };
+
+    static const int64_t kLateThresholdUs = 1000;
+
+    explicit AudioPacer(double speed = 1.0);
+
+    // Reset statistics and anchor the stream start at now.
+    void Start();
+
+    // Block until the chunk starting at `media_pos_ns` is due.
+    void WaitUntil(uint64_t media_pos_ns);
+
+    // Wait for the stream end at `media_end_ns`, then compute the drift.
+    void Finish(uint64_t media_end_ns);
+
+    const Stats& stats() const { return stats_; }
+    double speed() const { return speed_; }
+
+    // Exact media duration of `bytes` of PCM, without per-chunk rounding.
+    static uint64_t BytesToNanos(uint64_t bytes, uint64_t bytes_per_second);
+
+ private:
+    std::chrono::steady_clock::time_point Deadline(uint64_t media_pos_ns) const;
+
+    double speed_;
+    std::chrono::steady_clock::time_point start_;
+    Stats stats_;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "audio_source.h"
+#include "conversation.h"
+#include "spsc_ring.h"
+
+/**
+ * @brief 录音->发送 两级流水线
+ *
+ * Implements the README's recording flow: a capture thread continuously reads
+ * 20 ms frames from an AudioSource into a lock-free SPSC ring, and a send
+ * thread drains the ring into SendAudioData while the "button" is held.
+ *
+ * All SDK calls (StartHumanSpeech / SendAudioData / StopHumanSpeech) are made
+ * from the send thread, so they are always ordered. Press() flushes the ring
+ * before sending starts so stale background audio is never sent as the first
+ * sentence; Release() sends the frames captured up to the release point and
+ * then stops. Presses and releases are counted rather than latched, so a
+ * quick press/release is not lost before the send thread sees it, and a
+ * press during the drain of the previous release starts the next sentence.
+ */
+class AudioPipeline {
+ public:
+    // 20 ms of 16 bit mono PCM at 16 kHz.
+    static const std::size_t kFrameBytes = 640;
+    static const std::size_t kRingFrames = 64;  // ~1.3 s of audio
+
+    struct Frame {
+        uint16_t size;
+        uint8_t data[kFrameBytes];
+    };
+
+    struct Stats {
+        uint64_t frames_captured;
+        uint64_t frames_sent;
+        uint64_t frames_flushed;  // dropped by the flush on press
+        uint64_t overruns;        // capture found the ring full while sending
+        uint64_t idle_drops;      // capture found the ring full while not sending
+        uint64_t underruns;       // sender waited longer than a frame for audio
+        uint64_t send_errors;
+    };
+
+    AudioPipeline(convsdk::Conversation* conversation, std::unique_ptr<AudioSource> source);
+    ~AudioPipeline();
+
+    AudioPipeline(const AudioPipeline&) = delete;
+    AudioPipeline& operator=(const AudioPipeline&) = delete;
+
+    bool Start();
+    void Stop();
+
+    // Button pressed / released. Return immediately; the send thread applies
+    // them in order. Called from one thread (the CLI).
+    void Press();
+    void Release();
+
+    bool sending() const { return sending_.load(); }
+    Stats GetStats() const;
+
+ private:
+    void CaptureThreadMain();
+    void SendThreadMain();
+
+    convsdk::Conversation* conversation_;
+    std::unique_ptr<AudioSource> source_;
+    SpscRing<Frame, kRingFrames> ring_;
+
+    std::atomic<bool> running_;
+    std::atomic<bool> sending_;
+    std::atomic<uint64_t> presses_;
+    std::atomic<uint64_t> releases_;
+    std::thread capture_thread_;
+    std::thread send_thread_;
+
+    std::atomic<uint64_t> frames_captured_;
+    std::atomic<uint64_t> frames_sent_;
+    std::atomic<uint64_t> frames_flushed_;
+    std::atomic<uint64_t> overruns_;
+    std::atomic<uint64_t> idle_drops_;
+    std::atomic<uint64_t> underruns_;
+    std::atomic<uint64_t> send_errors_;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "audio_pacer.h"
+#include "mapped_audio.h"
+
+/**
+ * @brief 音频采集源
+ *
+ * Produces 16 bit mono PCM in real time. Read() blocks until `size` bytes of
+ * audio are available, like a microphone driver would, and returns false when
+ * the source is exhausted or failed.
+ */
+class AudioSource {
+ public:
+    virtual ~AudioSource() {}
+    virtual bool Read(uint8_t* buf, std::size_t size) = 0;
+    virtual int sample_rate() const = 0;
+};
+
+/**
+ * @brief 用音频文件模拟麦克风
+ *
+ * Loops the samples of a (mapped) PCM or WAV file at real-time rate.
+ */
+class FileAudioSource : public AudioSource {
+ public:
+    FileAudioSource(std::shared_ptr<const MappedAudioFile> file, int sample_rate, bool loop = true);
+
+    bool Read(uint8_t* buf, std::size_t size) override;
+    int sample_rate() const override { return sample_rate_; }
+
+ private:
+    std::shared_ptr<const MappedAudioFile> file_;
+    int sample_rate_;
+    bool loop_;
+    std::size_t offset_;
+    uint64_t bytes_read_;
+    bool started_;
+    AudioPacer pacer_;
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 向量化base64编码（SSSE3/AVX2，运行时选择，标量兜底）
+ *
+ * Standard alphabet with '=' padding, written straight into a caller-owned
+ * buffer so a request can be assembled around the encoded bytes without an
+ * intermediate string. The vector paths follow Muła's method: shuffle each
+ * 3-byte group into a 32-bit lane, split it into four 6-bit indices with
+ * multiplies, then map indices to ASCII with a 16-entry pshufb table. SSSE3
+ * handles 12 input bytes per step, AVX2 24. The CPU is probed once; on
+ * non-x86 targets (the ARM cross build) only the scalar encoder is compiled.
+ */
+
+// Encoded length of `n` input bytes, padding included.
+inline std::size_t Base64EncodedSize(std::size_t n) { return (n + 2) / 3 * 4; }
+
+// Write Base64EncodedSize(n) bytes to `out`; no terminator is added.
+void Base64Encode(const uint8_t* in, std::size_t n, char* out);
+
+// Reference implementation, also used for the tails of the vector paths.
+void Base64EncodeScalar(const uint8_t* in, std::size_t n, char* out);
+
+// "avx2", "ssse3" or "scalar": the path Base64Encode uses on this CPU.
+const char* Base64Backend();
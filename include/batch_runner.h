@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "latency_histogram.h"
+
+/**
+ * @brief 批量压测运行器
+ *
+ * Runs the rounds listed in a JSON manifest back to back on the connected
+ * conversation, each one gated on the dialog returning to IDLE:
+ *
+ *   {
+ *     "concurrency": 1,
+ *     "round_timeout_ms": 60000,
+ *     "jobs": [
+ *       {"type": "audio", "path": "audio_16k.pcm", "repeat": 10},
+ *       {"type": "tts",   "text": "...",           "repeat": 5},
+ *       {"type": "vqa",   "image": "test_img.jpg", "repeat": 2}
+ *     ]
+ *   }
+ *
+ * Relative paths are resolved against the manifest's directory; audio files
+ * are mapped and checked on load. The SDK holds a single conversation per
+ * process, so concurrency above 1 is clamped (use --workers for parallel runs).
+ * A round that does not come back to IDLE within round_timeout_ms ends the
+ * batch, since the next IDLE gate could no longer be trusted.
+ *
+ * Rounds are claimed through an atomic counter; worker processes share one
+ * (see WorkerPool) so each round of the manifest runs exactly once.
+ */
+class BatchRunner {
+ public:
+    enum JobType { kJobAudio, kJobTts, kJobVqa, kNumJobTypes };
+
+    struct Job {
+        JobType type;
+        std::string arg;        // audio/image path or TTS text
+        int repeat;
+        uint64_t audio_us;      // media duration of one audio upload
+    };
+
+    // Plain data so workers can publish it in shared memory as-is.
+    struct Report {
+        uint64_t rounds;
+        uint64_t failed;            // request not accepted by the SDK
+        uint64_t local;             // rounds answered from the VQA cache
+        uint64_t timeouts;          // batches stopped by a round timeout
+        uint64_t wall_us;
+        uint64_t audio_us;          // audio uploaded in completed rounds
+        uint64_t downlink_bytes;
+        LatencyHistogram round_us[kNumJobTypes];  // request -> next IDLE
+
+        Report() { Reset(); }
+        void Reset();
+        // Add another worker's counts; wall_us keeps the longest run.
+        void Merge(const Report& other);
+    };
+
+    BatchRunner();
+
+    bool Load(const std::string& manifest_path, std::string* error);
+
+    // Claim rounds from a counter shared with other processes instead of
+    // the runner's own; every runner must have loaded the same manifest.
+    void ShareRoundCounter(std::atomic<uint64_t>* next_round) { next_round_ = next_round; }
+    uint64_t TotalRounds() const { return round_jobs_.size(); }
+    // Audio files and VQA images the manifest uses, each listed once.
+    void CollectAssets(std::vector<std::string>* audio, std::vector<std::string>* images) const;
+
+    // Run every job on the global conversation; blocks until done.
+    bool Run();
+
+    const Report& report() const { return report_; }
+    void PrintReport(std::ostream& os) const { PrintReport(os, report_); }
+    static void PrintReport(std::ostream& os, const Report& report);
+
+    static const char* JobTypeName(JobType type);
+
+ private:
+    // `done` is set when the call itself completed the round.
+    bool Issue(const Job& job, uint64_t idle_seq, bool* done);
+    // IDLE entry newer than `after_seq`, waiting out a reconnect if needed.
+    bool WaitForFreshIdle(uint64_t after_seq, uint64_t* seq);
+
+    std::vector<Job> jobs_;
+    std::vector<uint32_t> round_jobs_;  // job index of every round, in order
+    int round_timeout_ms_;
+    std::atomic<uint64_t> local_next_round_;
+    std::atomic<uint64_t>* next_round_;
+    Report report_;
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "conversation.h"
+#include "latency_histogram.h"
+
+/**
+ * @brief 连接管理：建连、断线重连与建连耗时统计
+ *
+ * Owns the global `conversation`. Connect() creates and connects it; when a
+ * handler reports kConnectionDisconnected or a terminating
+ * kConversationFailed, a reconnect thread disconnects and connects again
+ * with exponential backoff plus jitter (half fixed, half random, so workers
+ * that lost the same server do not retry in lockstep). The last dialog_id
+ * seen is passed back in the init params, so the service continues the same
+ * dialog instead of starting a new one.
+ *
+ * While a reconnect is in progress the dialog state is reset to unknown,
+ * so anything gated on IDLE waits for the new connection's IDLE.
+ *
+ * Every successful Connect() is timed into a histogram. A pre-connected
+ * standby Conversation is not possible: the SDK hands out a single
+ * Conversation per process.
+ */
+class ConnectionManager {
+ public:
+    struct Options {
+        int base_backoff_ms = 200;
+        int max_backoff_ms = 10000;
+        int max_attempts = 10;      // per outage; 0 = retry forever
+        bool resume_dialog = true;  // pass the last dialog_id on reconnect
+    };
+
+    struct Stats {
+        uint64_t connects = 0;          // successful Connect() calls
+        uint64_t connect_failures = 0;
+        uint64_t losses = 0;            // outages reported by handlers
+        uint64_t reconnects = 0;        // outages recovered
+        uint64_t gave_up = 0;           // outages not recovered
+        uint64_t max_outage_ms = 0;     // loss -> reconnected
+    };
+
+    ConnectionManager();
+    explicit ConnectionManager(const Options& options);
+    ~ConnectionManager();
+
+    ConnectionManager(const ConnectionManager&) = delete;
+    ConnectionManager& operator=(const ConnectionManager&) = delete;
+
+    // Create (first call) and connect the global conversation; blocks.
+    convsdk::ConvRetCode Connect();
+
+    // Stop reconnecting, then disconnect and destroy the conversation.
+    convsdk::ConvRetCode Shutdown();
+
+    // From the event handlers; never blocks.
+    void OnConnectionLost(const std::string& reason);
+    void NoteDialogId(const std::string& dialog_id);
+
+    bool reconnecting() const { return reconnecting_.load(); }
+    std::string dialog_id() const;
+    Stats GetStats() const;
+    LatencyHistogram ConnectLatency() const;
+    void PrintStats(std::ostream& os) const;
+
+ private:
+    convsdk::ConvRetCode ConnectOnce(const std::string& dialog_id);
+    void ReconnectMain();
+    bool Reconnect();
+    int BackoffMs(int attempt);
+
+    Options options_;
+    mutable std::mutex lock_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    bool stopping_;
+    bool lost_;
+    std::atomic<bool> reconnecting_;
+    std::string dialog_id_;
+    std::string loss_reason_;
+    std::mt19937 rng_;
+    Stats stats_;
+    LatencyHistogram connect_us_;
+};
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 内容哈希（XXH64）
+ *
+ * 64-bit xxHash: four independent multiply-rotate lanes over 32-byte
+ * stripes, so it runs at memory speed on large buffers. Used to key
+ * caches by content; it is not a cryptographic hash.
+ */
+uint64_t ContentHash64(const void* data, std::size_t size, uint64_t seed = 0);
@@ -1,29 +1,66 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <atomic>
 
 #include "conversation.h"
 #include "conversation_utils.h"
+#include "connection_manager.h"
+#include "dialog_state_monitor.h"
+#include "event_dispatcher.h"
+#include "event_log.h"
+#include "round_tracer.h"
+#include "transcript_store.h"
+#include "tts_queue.h"
+#include "vqa_cache.h"
 
 // These globals are owned by main.cpp today.
 extern std::string g_log_level;
 extern std::string g_mode;
+extern std::string g_url;
+extern std::string g_output_dir;  // downlink audio and SDK debug_path
+extern std::string g_workspace_dir;  // SDK resources (aec/kws/vad models)
 extern convsdk::Conversation* conversation;
-extern std::atomic<bool> can_send_audio;
+extern DialogStateMonitor g_dialog_state;
+extern EventDispatcher g_event_dispatcher;
+extern RoundTracer g_round_tracer;
+extern ConnectionManager g_connection;
+extern double g_send_speed;
+extern std::string g_uplink_format;   // upstream audio_format: "pcm" or "opus"
+extern std::string g_opus_cache_dir;  // OpusFrameCache entries for the opus uplink
+extern EventLogWriter* g_event_log;  // NULL unless --record
+extern VqaCache g_vqa_cache;
+extern TtsQueue g_tts_queue;
+extern TranscriptStore g_transcripts;  // fed by the detail events
 
 // Helpers implemented in main.cpp but used by callbacks.
 
 
 // Conversation SDK callbacks + init params builder.
 void onMessage(convsdk::ConvEvent* event, void* param);
+void HandleEventRecord(EventRecord& record);
 void onEtMessage(convsdk::ConvLogLevel level, const char* log, void* user_data);
-std::string gen_init_params();
+// A non-empty `dialog_id` asks the service to continue that dialog.
+std::string gen_init_params(const std::string& dialog_id = std::string());
+// Request bodies for SendResponseData (split out so they can be benchmarked).
+std::string gen_tts_request(const std::string& text);
+// gen_tts_request without the copy: the body is written into the calling
+// thread's JsonScratchBuffer() and valid until its next use.
+const std::string& tts_request_json(const std::string& text);
+std::string gen_vqa_request(const std::string& image_path);
+// Build the VQA request for `image_path` now and put it in g_vqa_cache;
+// `encoded_size` receives the request size.
+bool preload_vqa_image(const std::string& image_path, std::size_t* encoded_size = NULL);
 
 // Trigger a one-shot audio send from CLI.
 void trigger_audio_send_once(const std::string& audio_file_path);
+// One blocking push-to-talk round, to be called while the dialog is in the
+// IDLE period with entry sequence `idle_seq`. Returns false if nothing was sent.
+bool send_audio_round(const std::string& audio_file_path, uint64_t idle_seq);
 // text to speech function
-void text_to_speech_request(const std::string& text);
-void vqa_send_request(std::string image_path);
+bool text_to_speech_request(const std::string& text);
+// `answered_from_cache` is set when a cached answer replaced the round trip.
+bool vqa_send_request(std::string image_path, bool* answered_from_cache = NULL);
 std::string getExecutableDirectory();
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+
+#include "conv_constants.h"
+
+/**
+ * @brief 对话状态监视器
+ *
+ * Fed by kDialogStateChanged from onMessage. Threads can block until the
+ * dialog reaches a given ConvDialogState and are woken by a condition
+ * variable as soon as the event arrives, instead of polling a flag.
+ *
+ * Every state entry gets a sequence number, so a caller that already used
+ * one IDLE period can wait for the *next* one (pass its sequence as
+ * `after_seq`). The time spent in each state is recorded per transition.
+ */
+class DialogStateMonitor {
+ public:
+    static const int kStateUnknown = -1;
+    static const int kNumStates = convsdk::kDialogThinking + 1;
+
+    struct TransitionStats {
+        uint64_t count;
+        uint64_t total_us;  // time spent in `from` before moving to `to`
+        uint64_t max_us;
+    };
+
+    DialogStateMonitor();
+
+    // Called from the SDK callback path.
+    void OnStateChanged(int state);
+
+    int Current() const;
+    uint64_t Sequence() const;
+
+    // Block until the dialog is in `state` with an entry sequence greater
+    // than `after_seq`. timeout_ms < 0 waits forever. On success stores the
+    // entry sequence in `entry_seq` (if given) and returns true.
+    bool WaitFor(convsdk::ConvDialogState state, int timeout_ms,
+                 uint64_t after_seq = 0, uint64_t* entry_seq = nullptr);
+
+    TransitionStats GetTransition(int from, int to) const;
+    void PrintStats(std::ostream& os) const;
+
+    static const char* StateName(int state);
+
+ private:
+    mutable std::mutex lock_;
+    std::condition_variable cv_;
+    int state_;
+    uint64_t seq_;
+    std::chrono::steady_clock::time_point entered_at_;
+    TransitionStats transitions_[kNumStates][kNumStates];
+};
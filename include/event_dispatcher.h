@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "conv_event.h"
+#include "mpsc_queue.h"
+
+/**
+ * @brief onMessage 事件的轻量副本
+ *
+ * Everything the handlers need from a ConvEvent, copied on the SDK callback
+ * thread. Records are pooled: their strings and payload vector keep their
+ * capacity between uses, so steady-state posting does not allocate.
+ */
+struct EventRecord {
+    convsdk::ConvEvent::ConvEventType type;
+    int dialog_state;
+    int sound_level;
+    int status_code;
+    bool terminate;
+    std::string session_id;
+    std::string dialog_id;
+    std::string round_id;
+    std::string response;                // GetAllResponse(), empty for kBinary
+    std::vector<unsigned char> binary;   // kBinary payload
+    std::chrono::steady_clock::time_point received_at;
+
+    // Fill from `event`; the event only has to be valid during this call.
+    void CopyFrom(convsdk::ConvEvent* event);
+};
+
+/**
+ * @brief 回调事件分发器
+ *
+ * Moves handler work off the SDK's callback thread. onMessage copies the event
+ * into a pooled EventRecord and posts it to a lock-free queue; worker threads
+ * run the handler. kBinary audio and control events use separate lanes, each
+ * with its own worker, so audio never waits behind slow control handlers or
+ * logging. Ordering is preserved within a lane: when a lane is full the SDK
+ * callback waits briefly for room, and if none frees up the event is
+ * dropped and counted, never handled out of turn.
+ */
+class EventDispatcher {
+ public:
+    enum Lane { kLaneAudio, kLaneControl, kNumLanes };
+
+    typedef void (*Handler)(EventRecord& record);
+
+    struct LaneStats {
+        uint64_t posted;
+        uint64_t dispatched;
+        uint64_t rejected;       // not queued: queue or record pool exhausted
+        uint64_t max_depth;
+        uint64_t total_wait_us;  // receive -> handler start
+        uint64_t max_wait_us;
+    };
+
+    explicit EventDispatcher(Handler handler, std::size_t lane_capacity = 1024);
+    ~EventDispatcher();
+
+    EventDispatcher(const EventDispatcher&) = delete;
+    EventDispatcher& operator=(const EventDispatcher&) = delete;
+
+    bool Start();
+    // Dispatch everything already posted, then stop the workers.
+    void Stop();
+
+    // Copy `event` and queue it. Safe from any thread. If the lane is full,
+    // waits up to 100 ms for room. Returns false if the dispatcher is not
+    // running or stayed full (the event is not handled; counted as
+    // rejected unless the dispatcher was never started or has stopped).
+    bool Post(convsdk::ConvEvent* event);
+    // Same for a record that is already decoded (event log replay), without
+    // waiting: the caller retries. received_at is restamped, so wait
+    // statistics cover this dispatcher only.
+    bool Post(const EventRecord& record);
+    bool running() const { return state_.load() == kRunning; }
+    // Not started, or Stop() has returned: no worker runs a handler, so the
+    // caller may run it itself.
+    bool stopped() const { return state_.load() == kStopped; }
+
+    static Lane LaneOf(convsdk::ConvEvent::ConvEventType type);
+
+    // Wait until every record posted to `lane` so far has been handled,
+    // e.g. the last kBinary of a round after its IDLE (control lane) was
+    // seen. Returns false on timeout.
+    bool WaitDispatched(Lane lane, int timeout_ms) const;
+
+    std::size_t Depth(Lane lane) const;
+    LaneStats GetStats(Lane lane) const;
+    void PrintStats(std::ostream& os) const;
+
+ private:
+    struct LaneState {
+        explicit LaneState(std::size_t capacity);
+
+        MpscQueue<EventRecord*> queue;
+        std::thread worker;
+        std::mutex wake_lock;
+        std::condition_variable wake_cv;
+        std::atomic<bool> sleeping;
+
+        std::atomic<uint64_t> posted;
+        std::atomic<uint64_t> dispatched;
+        std::atomic<uint64_t> rejected;
+        std::atomic<uint64_t> max_depth;
+        std::atomic<uint64_t> total_wait_us;
+        std::atomic<uint64_t> max_wait_us;
+    };
+
+    enum State { kStopped, kRunning, kStopping };
+
+    bool BeginPost(LaneState& lane);
+    // Sleep a little unless `deadline` has passed; false means give up.
+    static bool WaitForRoom(std::chrono::steady_clock::time_point deadline);
+    bool Enqueue(LaneState& lane, EventRecord* record, std::chrono::steady_clock::time_point deadline);
+    bool DispatchOne(LaneState& lane);
+    void Drain(LaneState& lane);
+    void WorkerMain(Lane lane);
+    void Wake(LaneState& lane);
+    static void UpdateMax(std::atomic<uint64_t>& target, uint64_t value);
+
+    Handler handler_;
+    std::vector<EventRecord> records_;
+    MpscQueue<EventRecord*> free_records_;
+    LaneState* lanes_[kNumLanes];
+    std::atomic<int> state_;
+    std::atomic<int> posting_;  // Post() calls past the state check
+};
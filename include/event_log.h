@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "conv_event.h"
+#include "event_dispatcher.h"
+#include "pcm_writer.h"
+
+/**
+ * @brief onMessage 事件录制器
+ *
+ * Appends every ConvEvent reaching onMessage to a compact binary log:
+ *
+ *   header: "CONVEVT1" | u32 version | u32 reserved | u64 wall-clock start (unix ns)
+ *   record: u32 size | u64 t_ns | i32 type | i32 dialog_state | i32 sound_level
+ *           | i32 status_code | u8 terminate | u16+session | u16+dialog | u16+round
+ *           | u32+response | u32+binary
+ *
+ * All integers are little endian; t_ns is steady_clock time since Open().
+ * As in EventRecord, kBinary records carry the payload and an empty
+ * response: GetAllResponse() is not read for audio packets.
+ * Append() runs on the SDK callback thread, so it only serializes into a
+ * recycled buffer and hands it to a PcmSessionWriter (raw container), whose
+ * I/O thread does the batched writes.
+ */
+class EventLogWriter {
+ public:
+    explicit EventLogWriter(const std::string& path);
+    ~EventLogWriter();
+
+    EventLogWriter(const EventLogWriter&) = delete;
+    EventLogWriter& operator=(const EventLogWriter&) = delete;
+
+    bool Open();
+    // Serialize `event`; it only has to be valid during the call.
+    void Append(convsdk::ConvEvent* event);
+    void Close();
+
+    const std::string& path() const { return out_.path(); }
+    uint64_t records() const { return records_.load(std::memory_order_relaxed); }
+    PcmSessionWriter::Stats GetStats() const { return out_.GetStats(); }
+
+ private:
+    PcmSessionWriter out_;
+    std::chrono::steady_clock::time_point start_;
+    std::atomic<uint64_t> records_;
+};
+
+/**
+ * @brief 事件日志读取器
+ *
+ * Maps a log written by EventLogWriter and decodes it record by record into
+ * EventRecords (reusing their string/vector capacity). A truncated tail, as
+ * left by a crash while recording, ends the log with error() set.
+ */
+class EventLogReader {
+ public:
+    EventLogReader();
+    ~EventLogReader();
+
+    EventLogReader(const EventLogReader&) = delete;
+    EventLogReader& operator=(const EventLogReader&) = delete;
+
+    bool Open(const std::string& path, std::string* error);
+
+    // Decode the next record; `offset_ns` is its time since recording start.
+    bool Next(EventRecord* record, uint64_t* offset_ns);
+
+    const std::string& error() const { return error_; }
+    uint64_t wall_start_ns() const { return wall_start_ns_; }
+
+ private:
+    void Unmap();
+    bool Corrupt();
+
+    const unsigned char* data_;
+    std::size_t size_;
+    std::size_t pos_;
+    uint64_t wall_start_ns_;
+    std::string error_;
+};
+
+/**
+ * @brief 事件回放
+ *
+ * Feed a recorded log back through the dispatcher and handler chain.
+ * speed: 1.0 = original timing, N = N times faster, 0 = as fast as possible.
+ * Posting waits for room when the dispatcher is full, so nothing is handled
+ * inline and the measured rate is the handler chain's throughput.
+ */
+struct ReplayStats {
+    uint64_t events = 0;
+    uint64_t binary_bytes = 0;
+    uint64_t full_waits = 0;    // posts that had to wait for dispatcher room
+    uint64_t media_us = 0;      // recorded span
+    uint64_t wall_us = 0;       // until every event was handled
+    uint64_t late_events = 0;   // pacer woke late
+};
+
+bool ReplayEventLog(const std::string& path, double speed, EventDispatcher& dispatcher,
+                    ReplayStats* stats, std::string* error);
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * @brief 流式JSON写入器（请求构建用，不建立Json::Value树）
+ *
+ * Appends compact JSON to a caller-owned std::string. Strings are escaped
+ * byte for byte like jsoncpp 1.7 (quote, backslash, \b \f \n \r \t, other
+ * control characters as \u00XX, UTF-8 passed through), so the request
+ * bodies are identical to the ones the Json::Value path produced. Keys are
+ * written in the order given; callers that must match jsoncpp write them
+ * sorted.
+ *
+ * The writer only tracks commas. Nesting is the caller's job, up to
+ * kMaxDepth levels.
+ */
+class JsonWriter {
+ public:
+    static const int kMaxDepth = 32;
+
+    explicit JsonWriter(std::string* out) : out_(out), depth_(0), has_items_(0), after_key_(false) {}
+
+    void BeginObject() { Open('{'); }
+    void EndObject() { Close('}'); }
+    void BeginArray() { Open('['); }
+    void EndArray() { Close(']'); }
+
+    void Key(const char* key) { Key(key, std::strlen(key)); }
+    void Key(const char* key, std::size_t len);
+
+    void String(const char* value) { String(value, std::strlen(value)); }
+    void String(const std::string& value) { String(value.data(), value.size()); }
+    void String(const char* value, std::size_t len);
+    void Int(int64_t value);
+    void Bool(bool value);
+    // An already serialized value (e.g. a constant sub-object).
+    void Raw(const char* json, std::size_t len);
+
+ private:
+    void Separate();
+    void Open(char bracket);
+    void Close(char bracket);
+
+    std::string* out_;
+    int depth_;
+    uint32_t has_items_;  // bit n: level n already holds a value
+    bool after_key_;
+};
+
+// Append `value` as a quoted, escaped JSON string.
+void JsonAppendQuoted(std::string* out, const char* value, std::size_t len);
+
+// Per-thread scratch buffer, cleared, for request bodies that are handed to
+// the SDK and dropped. Its capacity is kept between calls (released above
+// kJsonScratchRetainBytes), so steady-state requests do not allocate. The
+// contents are valid until the next call on the same thread.
+const std::size_t kJsonScratchRetainBytes = 1u << 20;
+std::string& JsonScratchBuffer();
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief HDR风格的延迟直方图
+ *
+ * Log-linear buckets: values below 64 are exact, above that every power of
+ * two is split into 32 sub-buckets, so any recorded value is reported within
+ * ~3% of its true value. Values are unit-less (the tracer records
+ * microseconds) and clamp at 2^37-1.
+ *
+ * Plain data with a fixed-size counts array: it can be copied, merged and
+ * placed in shared memory as-is.
+ */
+class LatencyHistogram {
+ public:
+    static const int kSubBucketBits = 5;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kMaxShift = 31;
+    static const int kNumBuckets = (kMaxShift + 2) * kSubBuckets;
+
+    LatencyHistogram() { Reset(); }
+
+    void Reset();
+    void Record(uint64_t value);
+    void Merge(const LatencyHistogram& other);
+
+    uint64_t Count() const { return count_; }
+    uint64_t Min() const { return count_ ? min_ : 0; }
+    uint64_t Max() const { return max_; }
+    double Mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+    // Value at percentile `p` (0-100), reported as the bucket's upper bound
+    // and clamped to the observed max.
+    uint64_t Percentile(double p) const;
+
+ private:
+    static int BucketIndex(uint64_t value);
+    static uint64_t BucketUpperBound(int index);
+
+    uint64_t counts_[kNumBuckets];
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
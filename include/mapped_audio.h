@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @brief 内存映射的音频文件
+ *
+ * Maps an audio file read-only (MADV_SEQUENTIAL) and, for RIFF/WAVE files,
+ * walks the chunk list to locate `fmt ` and `data` instead of assuming a
+ * 44-byte header. Mappings are cached by path and reused across sends until
+ * the file's inode, size or mtime changes; at most kMaxCachedFiles are kept,
+ * least recently opened dropped first.
+ */
+class MappedAudioFile {
+ public:
+    static const int kFormatPcm = 0x0001;  // WAVE_FORMAT_PCM
+    static const std::size_t kMaxCachedFiles = 64;
+
+    ~MappedAudioFile();
+
+    MappedAudioFile(const MappedAudioFile&) = delete;
+    MappedAudioFile& operator=(const MappedAudioFile&) = delete;
+
+    // Return the cached mapping of `path`, (re)mapping it when needed.
+    // On failure returns nullptr and fills `error` if given.
+    static std::shared_ptr<const MappedAudioFile> Open(const std::string& path,
+                                                       std::string* error = nullptr);
+
+    // Drop every cached mapping (mappings still in use stay valid).
+    static void ClearCache();
+
+    const std::string& path() const { return path_; }
+
+    // Whole file.
+    const uint8_t* data() const { return base_; }
+    std::size_t size() const { return size_; }
+
+    // Audio samples: the `data` chunk for WAV, the whole file otherwise.
+    const uint8_t* payload() const { return base_ + payload_offset_; }
+    std::size_t payload_size() const { return payload_size_; }
+
+    bool is_wav() const { return is_wav_; }
+    // WAV format fields; 0 when the file is not a WAV.
+    int format_tag() const { return format_tag_; }
+    int channels() const { return channels_; }
+    int sample_rate() const { return sample_rate_; }
+    int bits_per_sample() const { return bits_per_sample_; }
+
+ private:
+    MappedAudioFile();
+    bool Map(const std::string& path, std::string* error);
+    bool ParseRiff(std::string* error);
+
+    std::string path_;
+    const uint8_t* base_;
+    std::size_t size_;
+    std::size_t payload_offset_;
+    std::size_t payload_size_;
+    bool is_wav_;
+    int format_tag_;
+    int channels_;
+    int sample_rate_;
+    int bits_per_sample_;
+
+    // Identity used to invalidate the cache entry.
+    dev_t dev_;
+    ino_t ino_;
+    off_t file_size_;
+    int64_t mtime_ns_;
+};
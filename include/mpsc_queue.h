@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief 有界无锁多生产者队列
+ *
+ * Dmitry Vyukov's bounded queue: every cell carries a sequence number, so
+ * producers claim cells with a single CAS on the tail and never block each
+ * other. Capacity is rounded up to a power of two. The algorithm is also safe
+ * with several consumers, which the event record free list relies on.
+ */
+template <typename T>
+class MpscQueue {
+ public:
+    explicit MpscQueue(std::size_t capacity)
+        : cells_(RoundUp(capacity)), mask_(cells_.size() - 1), enqueue_pos_(0), dequeue_pos_(0) {
+        for (std::size_t i = 0; i < cells_.size(); ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    std::size_t capacity() const { return cells_.size(); }
+
+    bool TryPush(const T& value) {
+        Cell* cell;
+        std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& out) {
+        Cell* cell;
+        std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        out = cell->value;
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate number of queued elements.
+    std::size_t SizeApprox() const {
+        std::size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+        std::size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+        return tail >= head ? tail - head : 0;
+    }
+
+ private:
+    static const std::size_t kCacheLine = 64;
+
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    static std::size_t RoundUp(std::size_t n) {
+        std::size_t cap = 2;
+        while (cap < n) cap <<= 1;
+        return cap;
+    }
+
+    std::vector<Cell> cells_;
+    const std::size_t mask_;
+    char pad0_[kCacheLine];
+    std::atomic<std::size_t> enqueue_pos_;
+    char pad1_[kCacheLine - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> dequeue_pos_;
+    char pad2_[kCacheLine - sizeof(std::atomic<std::size_t>)];
+};
+
+template <typename T>
+const std::size_t MpscQueue<T>::kCacheLine;
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "mapped_audio.h"
+
+/**
+ * @brief 上行opus帧缓存（语料只编码一次，落盘复用）
+ *
+ * In opus uplink mode a corpus file is encoded once with ConversationUtils
+ * (640-byte, 20 ms frames of 16 kHz mono s16le; a short last frame is
+ * zero-padded) and the packets are written to
+ * <cache_dir>/<file name>.<content hash>.opu2 in kEncoderOpu2 framing: each
+ * packet preceded by its size as a 2-byte big-endian integer. Later sends,
+ * in this run or the next, map that file and hand the framed packets to
+ * SendAudioData(..., kEncoderOpu2) without touching the encoder.
+ *
+ * The file name carries XXH64 of the PCM payload, so an edited corpus file
+ * gets a new cache entry; a 32-byte header repeats the hash and the frame
+ * parameters and is checked on load. Entries are written to a temporary
+ * name and renamed, so concurrent workers never see a partial file.
+ */
+class OpusFrameCache {
+ public:
+    static const int kSampleRate = 16000;
+    static const std::size_t kFrameBytes = 640;  // PCM per packet (20 ms)
+    static const uint64_t kFrameNs = 20000000ULL;
+
+    struct Frames {
+        std::shared_ptr<const MappedAudioFile> file;  // keeps the mapping alive
+        const uint8_t* data = nullptr;  // framed packets, after the header
+        std::size_t size = 0;
+        uint32_t count = 0;
+        uint64_t pcm_bytes = 0;
+        std::string path;
+        bool encoded = false;    // cache miss: encoded by this call
+        uint64_t encode_us = 0;
+    };
+
+    // Framed packets for the PCM (raw or 16 kHz mono WAV) at `pcm_path`,
+    // loaded from `cache_dir` or encoded and stored there.
+    static bool Load(const std::string& pcm_path, const std::string& cache_dir, Frames* frames,
+                     std::string* error);
+
+    // Size of the framed packet starting at `data` (length prefix included),
+    // or 0 if it does not fit in `available` bytes.
+    static std::size_t FramedSize(const uint8_t* data, std::size_t available);
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * @brief 会话级下行音频写入器
+ *
+ * One instance per SDK session. The file descriptor is opened once and kept
+ * for the whole session; producers (the SDK callback thread) only copy the
+ * chunk into a bounded queue, and a dedicated I/O thread drains the queue
+ * with batched writev() calls.
+ *
+ * With kContainerWav the file is a streaming WAV: a 44-byte header is written
+ * on Open() and its RIFF/data sizes are patched in place after every batch,
+ * so each chunk is consumed exactly once and the file is always playable.
+ *
+ * Queued chunks live in recycled buffers: once written, a buffer goes back
+ * to the writer's free list and is reused by the next Push(), so steady-state
+ * traffic performs one memcpy per packet and no heap allocation.
+ */
+class PcmSessionWriter {
+ public:
+    struct Stats {
+        uint64_t chunks_written = 0;
+        uint64_t bytes_written = 0;
+        uint64_t batches = 0;
+        uint64_t dropped_chunks = 0;
+        uint64_t write_errors = 0;
+        uint64_t bytes_copied = 0;          // bytes copied out of SDK callbacks
+        uint64_t buffer_allocations = 0;    // pushes that had to allocate
+        uint64_t allocations_avoided = 0;   // pushes served by a recycled buffer
+    };
+
+    enum Container {
+        kContainerRaw,  // headerless s16le PCM
+        kContainerWav,  // RIFF/WAVE, PCM 16 bit
+    };
+
+    explicit PcmSessionWriter(const std::string& path,
+                              Container container = kContainerRaw,
+                              int sample_rate = 24000,
+                              int channels = 1,
+                              std::size_t max_queued_chunks = 256);
+    ~PcmSessionWriter();
+
+    PcmSessionWriter(const PcmSessionWriter&) = delete;
+    PcmSessionWriter& operator=(const PcmSessionWriter&) = delete;
+
+    // Open (truncate) the output file and start the I/O thread.
+    bool Open();
+
+    // Queue a copy of `data` in a pooled buffer. `data` only has to stay
+    // valid for the duration of the call. Never blocks on the filesystem;
+    // returns false when the writer is closed or the queue is full.
+    bool Push(const unsigned char* data, std::size_t size);
+
+    // Queue `buf` without copying: its contents are moved into the queue and
+    // `buf` receives a recycled (empty) buffer in exchange. For callers that
+    // already copied the payload out of the callback into a pooled buffer.
+    bool Push(std::vector<unsigned char>& buf);
+
+    // Drain everything queued so far, then stop the I/O thread and close.
+    void Close();
+
+    const std::string& path() const { return path_; }
+    Stats GetStats() const;
+
+ private:
+    void IoThreadMain();
+    bool WriteBatch(std::deque<std::vector<unsigned char> >& batch);
+    void RecycleBuffers(std::deque<std::vector<unsigned char> >& batch);
+    bool WriteWavHeader();
+    bool PatchWavSizes();
+
+    std::string path_;
+    Container container_;
+    int sample_rate_;
+    int channels_;
+    uint64_t data_bytes_;
+    std::size_t max_queued_chunks_;
+    int fd_;
+
+    mutable std::mutex lock_;
+    std::condition_variable cv_;
+    std::deque<std::vector<unsigned char> > queue_;
+    std::vector<std::vector<unsigned char> > free_buffers_;
+    bool running_;
+    std::thread io_thread_;
+    Stats stats_;
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief 从详情事件中按需提取文本字段（单遍扫描，不建DOM）
+ *
+ * kRespondingDetail and kHumanSpeakingDetail carry the whole service frame,
+ * {"header":{...},"payload":{"output":{...}}}, and arrive for every partial
+ * result. Only four members of payload.output matter to the app: text,
+ * finished, round_id and content_type. ExtractResponseFields() walks the
+ * frame once, skips everything else without decoding it (including the
+ * header and any nested objects under output), and stops as soon as the
+ * four fields are found or output is closed.
+ *
+ * Strings are unescaped into the caller's ResponseFields, whose members keep
+ * their capacity between calls; a handler that reuses one instance does not
+ * allocate in steady state.
+ */
+struct ResponseFields {
+    std::string text;          // the text so far of this round
+    std::string round_id;
+    std::string content_type;  // empty when the service did not send one
+    bool has_text;
+    bool finished;
+
+    ResponseFields() : has_text(false), finished(false) {}
+    void Clear();
+};
+
+// False if `json` is not a well-formed object up to the point where the
+// scan stopped; `fields` then holds whatever was found before the error.
+bool ExtractResponseFields(const char* json, std::size_t len, ResponseFields* fields);
+
+inline bool ExtractResponseFields(const std::string& json, ResponseFields* fields) {
+    return ExtractResponseFields(json.data(), json.size(), fields);
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "latency_histogram.h"
+
+/**
+ * @brief 每轮对话的延迟时间线
+ *
+ * Collects one timestamp per TracePoint for each dialog round and, when the
+ * round is over, folds the derived latencies into histograms:
+ *
+ *   upload            speech start      -> last audio sent
+ *   eos_to_sentence   last audio sent   -> kSentenceEnd      (server endpointing)
+ *   eos_to_thinking   last audio sent   -> THINKING
+ *   eos_to_response   last audio sent   -> kDataOutputStarted
+ *   time_to_audio     last audio sent   -> first kBinary     (or request -> first kBinary for TTS/VQA)
+ *   output_duration   first kBinary     -> kDataOutputCompleted
+ *   round_total       first mark        -> IDLE
+ *   tts_throughput    downlink bytes/s between first kBinary and completion
+ *
+ * Marks are attached to the round named by GetRoundId()/GetDialogId() when
+ * the event carries one; client-side marks (speech start, last audio sent)
+ * open the round before the server has assigned an id. A round is finalized
+ * when the next one starts, so late kBinary records from the audio lane still
+ * count towards the round they belong to. IDLE only closes a round that is
+ * in flight; it never opens one.
+ */
+class RoundTracer {
+ public:
+    enum TracePoint {
+        kTraceRequestSent,     // StartHumanSpeech / SendResponseData
+        kTraceLastAudioSent,
+        kTraceSentenceEnd,
+        kTraceThinking,
+        kTraceOutputStarted,
+        kTraceFirstBinary,
+        kTraceOutputCompleted,
+        kTraceIdle,
+        kNumTracePoints
+    };
+
+    enum Metric {
+        kMetricUpload,
+        kMetricEosToSentenceEnd,
+        kMetricEosToThinking,
+        kMetricEosToResponse,
+        kMetricTimeToAudio,
+        kMetricOutputDuration,
+        kMetricRoundTotal,
+        kMetricTtsThroughput,  // bytes per second, not microseconds
+        kNumMetrics
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    RoundTracer();
+
+    // Record `point` at `when`. `round_id` / `dialog_id` may be empty.
+    void Mark(TracePoint point, const std::string& round_id = std::string(),
+              const std::string& dialog_id = std::string(), Clock::time_point when = Clock::now());
+
+    // Account downlink audio; the first call of a round also marks kTraceFirstBinary.
+    void AddDownlink(std::size_t bytes, const std::string& round_id, const std::string& dialog_id,
+                     Clock::time_point when);
+
+    uint64_t RoundsCompleted() const;
+    // Downlink audio bytes accounted so far, across all rounds.
+    uint64_t DownlinkBytes() const;
+    LatencyHistogram Histogram(Metric metric) const;
+
+    // Finalize a finished round (if any) and print percentiles of every metric.
+    void Dump(std::ostream& os);
+
+    // Finalize a finished round (if any) and copy out every histogram, e.g.
+    // for a worker process to publish its metrics to the supervisor.
+    uint64_t Snapshot(LatencyHistogram out[kNumMetrics]);
+    static void PrintHistograms(std::ostream& os, const LatencyHistogram hist[kNumMetrics],
+                                uint64_t rounds);
+
+    static const char* MetricName(Metric metric);
+
+ private:
+    struct Timeline {
+        std::string round_id;
+        std::string dialog_id;
+        bool has[kNumTracePoints];
+        Clock::time_point at[kNumTracePoints];
+        uint64_t downlink_bytes;
+        bool active;
+
+        void Clear();
+    };
+
+    // Both called with lock_ held. RoundFor() returns NULL for an IDLE
+    // that has no round to close.
+    Timeline* RoundFor(TracePoint point, const std::string& round_id, const std::string& dialog_id);
+    void Finalize();
+    void RecordSpan(Metric metric, TracePoint from, TracePoint to);
+
+    mutable std::mutex lock_;
+    Timeline current_;
+    uint64_t rounds_;
+    uint64_t downlink_total_;
+    LatencyHistogram histograms_[kNumMetrics];
+};
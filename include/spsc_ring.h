@@ -0,0 +1,111 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief 单生产者/单消费者无锁环形缓冲
+ *
+ * Fixed capacity ring (N must be a power of two). Exactly one thread may call
+ * the producer methods and exactly one other thread the consumer methods.
+ * Head and tail live on separate cache lines, and each side keeps a private
+ * copy of the other side's index so the shared line is only touched when the
+ * ring looks full (producer) or empty (consumer).
+ *
+ * Slots are accessed in place: the producer fills ProducerSlot() and then
+ * calls Publish(); the consumer reads ConsumerSlot() and then calls Release().
+ */
+template <typename T, std::size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+ public:
+    static const std::size_t kCacheLine = 64;
+
+    SpscRing() : head_(0), cached_tail_(0), tail_(0), cached_head_(0) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    static std::size_t capacity() { return N; }
+
+    // ---- producer side ----
+
+    // Next free slot, or nullptr when the ring is full.
+    T* ProducerSlot() {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ >= N) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ >= N) return nullptr;
+        }
+        return &slots_[tail & (N - 1)];
+    }
+
+    // Make the slot returned by ProducerSlot() visible to the consumer.
+    void Publish() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool TryPush(const T& value) {
+        T* slot = ProducerSlot();
+        if (!slot) return false;
+        *slot = value;
+        Publish();
+        return true;
+    }
+
+    // ---- consumer side ----
+
+    // Oldest published slot, or nullptr when the ring is empty.
+    const T* ConsumerSlot() {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) return nullptr;
+        }
+        return &slots_[head & (N - 1)];
+    }
+
+    // Hand the slot returned by ConsumerSlot() back to the producer.
+    void Release() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool TryPop(T& out) {
+        const T* slot = ConsumerSlot();
+        if (!slot) return false;
+        out = *slot;
+        Release();
+        return true;
+    }
+
+    // Drop everything published so far; returns the number of slots dropped.
+    std::size_t Flush() {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        std::size_t tail = tail_.load(std::memory_order_acquire);
+        cached_tail_ = tail;
+        head_.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    // Monotonic counts of slots consumed / published. Readable from either side.
+    std::size_t ConsumerPosition() const { return head_.load(std::memory_order_acquire); }
+    std::size_t ProducerPosition() const { return tail_.load(std::memory_order_acquire); }
+
+    std::size_t SizeApprox() const { return ProducerPosition() - ConsumerPosition(); }
+
+ private:
+    // Consumer-owned line.
+    std::atomic<std::size_t> head_;
+    std::size_t cached_tail_;
+    char pad0_[kCacheLine - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+
+    // Producer-owned line.
+    std::atomic<std::size_t> tail_;
+    std::size_t cached_head_;
+    char pad1_[kCacheLine - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+
+    T slots_[N];
+};
+
+template <typename T, std::size_t N>
+const std::size_t SpscRing<T, N>::kCacheLine;
@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 启动预加载：与建连并行准备素材，并打印启动各阶段耗时
+ *
+ * Connect() blocks for a whole handshake, while the assets the first
+ * command needs used to be touched only when that command ran: the audio
+ * file was mapped on the first send, the VQA request base64-encoded
+ * per request, the output directory created by the first downlink packet.
+ * RunSession starts the connect thread and calls Run() on the main thread
+ * meanwhile, so that work is hidden under the handshake:
+ *
+ *   audio corpus   map, validate (16 kHz mono for WAV) and prefault
+ *   opus frames    load or build the opus cache entries (opus uplink only)
+ *   vqa image      build the base64 request body (preload_vqa_image)
+ *   output dirs    create g_output_dir before the first downlink packet
+ *   sdk workspace  read ahead the SDK resource files, if the dir exists
+ *
+ * Every step, and the connect itself through Record(), is kept as a phase
+ * with its offset from Begin(). PrintBreakdown() lists them together with
+ * the time to first interaction and the serial sum they replace.
+ */
+class StartupPreloader {
+ public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Phase {
+        std::string name;
+        uint64_t start_us;   // offset from Begin()
+        uint64_t us;
+        bool ok;
+        std::string detail;
+    };
+
+    StartupPreloader();
+
+    // Duplicates are ignored; an empty path is skipped.
+    void AddAudio(const std::string& path);
+    void AddImage(const std::string& path);
+    void AddDirectory(const std::string& path);
+    void SetWorkspace(const std::string& path);
+    // Opus uplink: prepare the audio's OpusFrameCache entries in `dir`.
+    void SetOpusCache(const std::string& dir);
+
+    // Origin of the timeline.
+    void Begin();
+
+    // Run every step on the calling thread. Failures are logged and kept
+    // in the breakdown; the commands that need the asset will report them
+    // again. Returns false if any step failed.
+    bool Run();
+
+    // Phase measured elsewhere (the connect thread); thread safe.
+    void Record(const std::string& name, Clock::time_point start, Clock::time_point end,
+                bool ok, const std::string& detail = std::string());
+
+    std::vector<Phase> phases() const;
+    void PrintBreakdown(std::ostream& os) const;
+
+ private:
+    void RunPhase(const std::string& name, bool (StartupPreloader::*step)(std::string*));
+    bool LoadAudio(std::string* detail);
+    bool LoadOpusFrames(std::string* detail);
+    bool EncodeImages(std::string* detail);
+    bool MakeDirectories(std::string* detail);
+    bool ReadAheadWorkspace(std::string* detail);
+
+    static void AddUnique(std::vector<std::string>* list, const std::string& path);
+
+    std::vector<std::string> audio_;
+    std::vector<std::string> images_;
+    std::vector<std::string> dirs_;
+    std::string workspace_;
+    std::string opus_cache_;
+
+    Clock::time_point begin_;
+    mutable std::mutex lock_;
+    std::vector<Phase> phases_;
+};
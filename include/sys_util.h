@@ -0,0 +1,16 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief 公共小工具（计时、建目录）
+ */
+
+// Microseconds from `since` to `now`; 0 if `now` is earlier.
+uint64_t ElapsedUs(std::chrono::steady_clock::time_point since,
+                   std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+// mkdir -p with mode 0755. On failure fills `error` (if given) with the
+// component that could not be created.
+bool MakeDirs(const std::string& path, std::string* error);
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 对话转写存储（按dialog/round索引，arena分段追加，内存上限淘汰）
+ *
+ * Fed with the text so far of every kHumanSpeakingDetail (user, ASR) and
+ * kRespondingDetail (assistant, LLM), keyed by dialog id and round id.
+ * Update() compares the new text with what the round already holds and
+ * returns only the change: the length still valid and the suffix after it.
+ * Usually that is a pure append; when the service revises a partial
+ * hypothesis the kept prefix is shorter, cut back to a UTF-8 boundary.
+ *
+ * Text lives in an append-only arena of kBlockBytes blocks; a round side is
+ * a list of segments into it, so an append copies only the new bytes and
+ * a revision only trims the segment list. Revised-away bytes stay in their
+ * block until it is released; a side with more than kMaxSegments segments
+ * is rewritten as one. Blocks are counted against the budget and freed
+ * once no segment refers to them. Above the budget the oldest rounds are
+ * evicted; the round being updated is always kept, so a budget of 0 keeps
+ * just the current round.
+ *
+ * Thread safe. Update() is meant for one feeder (the control lane); the
+ * suffix it returns is valid until that feeder's next Update().
+ */
+class TranscriptStore {
+ public:
+    static const std::size_t kDefaultBudgetBytes = 4u << 20;
+    static const std::size_t kBlockBytes = 64u << 10;
+    static const std::size_t kMaxSegments = 16;
+
+    enum Speaker { kSpeakerUser, kSpeakerAssistant, kNumSpeakers };
+
+    struct Change {
+        bool new_round;       // first text stored for this dialog/round
+        bool finished;
+        std::size_t kept;     // bytes of the previous text still valid
+        std::size_t dropped;  // bytes of the previous text revised away
+        const char* data;     // the changed suffix
+        std::size_t size;
+
+        bool empty() const { return size == 0 && dropped == 0; }
+    };
+
+    struct RoundText {
+        std::string dialog_id;
+        std::string round_id;
+        std::string text[kNumSpeakers];
+        bool finished[kNumSpeakers];
+    };
+
+    struct Stats {
+        uint64_t updates = 0;
+        uint64_t revisions = 0;      // updates that dropped stored text
+        uint64_t compactions = 0;
+        uint64_t evicted_rounds = 0;
+        uint64_t rounds = 0;
+        uint64_t blocks = 0;
+        uint64_t text_bytes = 0;     // current text of the stored rounds
+        uint64_t memory_bytes = 0;   // blocks plus per-round bookkeeping
+    };
+
+    TranscriptStore();
+
+    TranscriptStore(const TranscriptStore&) = delete;
+    TranscriptStore& operator=(const TranscriptStore&) = delete;
+
+    void Configure(std::size_t budget_bytes);
+
+    // An empty round_id continues the dialog's latest round unless that
+    // side already finished.
+    Change Update(Speaker speaker, const std::string& dialog_id, const std::string& round_id,
+                  const std::string& text, bool finished);
+
+    bool Get(const std::string& dialog_id, const std::string& round_id, RoundText* out) const;
+    // Up to `count` most recent rounds, oldest first.
+    std::vector<RoundText> Recent(std::size_t count) const;
+
+    Stats GetStats() const;
+    void PrintStats(std::ostream& os) const;
+    void PrintRecent(std::ostream& os, std::size_t count) const;
+
+ private:
+    struct Segment {
+        uint64_t block;   // absolute block number
+        uint32_t offset;
+        uint32_t size;
+    };
+    struct Side {
+        std::vector<Segment> segments;
+        std::size_t size = 0;
+        bool finished = false;
+    };
+    struct Round {
+        std::string dialog_id;
+        std::string round_id;
+        Side sides[kNumSpeakers];
+    };
+    struct Block {
+        std::unique_ptr<char[]> data;
+        std::size_t capacity;
+        std::size_t used;
+        std::size_t refs;  // segments pointing into this block
+    };
+
+    Round* FindOrAddLocked(Speaker speaker, const std::string& dialog_id, const std::string& round_id,
+                           bool* added);
+    std::size_t CommonPrefixLocked(const Side& side, const std::string& text) const;
+    void TruncateLocked(Side* side, std::size_t size);
+    const char* AppendLocked(Side* side, const char* data, std::size_t len);
+    void CompactLocked(Side* side);
+    void ReleaseLocked(const Segment& segment);
+    void EvictLocked(const Round* keep);
+    void CopyTextLocked(const Side& side, std::string* out) const;
+    void CopyRoundLocked(const Round& round, RoundText* out) const;
+    static std::size_t RoundOverhead(const Round& round);
+
+    mutable std::mutex lock_;
+    std::size_t budget_;
+    std::deque<Round> rounds_;  // oldest first
+    uint64_t first_round_;      // number of rounds_.front()
+    std::unordered_map<std::string, uint64_t> index_;  // dialog_id '\x1f' round_id -> round number
+    std::string key_;           // lookup scratch
+    std::deque<Block> blocks_;
+    uint64_t first_block_;      // number of blocks_.front()
+    std::size_t block_bytes_;   // capacity of the allocated blocks
+    std::size_t overhead_bytes_;
+    std::size_t text_bytes_;
+    Stats stats_;
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event_dispatcher.h"
+#include "latency_histogram.h"
+#include "pcm_writer.h"
+
+/**
+ * @brief 分句TTS队列
+ *
+ * A long announcement sent as one transcript is synthesized as one round,
+ * so nothing plays until the whole text has gone through. Submit() instead
+ * splits the text at sentence boundaries and a worker thread sends the
+ * segments as consecutive transcript rounds: the first, short sentence
+ * starts playing after one sentence of synthesis.
+ *
+ * The service takes one request per IDLE period, so this is a sequential
+ * queue: one segment is in flight at a time and the next goes out as soon
+ * as the previous round returns to IDLE. What it saves is the wait for the
+ * first audio, not total synthesis time.
+ *
+ * While a job runs, kBinary audio is routed to OnAudio() and written to one
+ * WAV per job (<g_output_dir>/tts_job_<id>.wav). A segment is closed only
+ * after the audio lane has handled everything posted before its IDLE, so the
+ * segments are appended in order. Each job reports characters per second
+ * and time to first audio.
+ */
+class TtsQueue {
+ public:
+    struct Options {
+        std::size_t max_segment_chars = 80; // code points; longer sentences are cut
+        int round_timeout_ms = 60000;
+    };
+
+    struct JobStats {
+        uint64_t id = 0;
+        bool ok = false;
+        std::size_t chars = 0;          // code points
+        std::size_t segments = 0;
+        std::size_t segments_done = 0;
+        uint64_t audio_bytes = 0;
+        uint64_t first_audio_us = 0;    // submit -> first kBinary
+        uint64_t total_us = 0;          // submit -> last segment back to IDLE
+        std::string path;
+    };
+
+    TtsQueue();
+    ~TtsQueue();
+
+    TtsQueue(const TtsQueue&) = delete;
+    TtsQueue& operator=(const TtsQueue&) = delete;
+
+    void Configure(const Options& options);
+
+    // Queue `text`; returns the job id, or 0 if the queue is stopped or the
+    // text has nothing to say. Never blocks.
+    uint64_t Submit(const std::string& text);
+    // Block until job `id` has finished; false if it failed.
+    bool Wait(uint64_t id, JobStats* stats);
+
+    // kBinary handler hook; true if the payload belonged to a running job.
+    bool OnAudio(EventRecord& record);
+
+    // Finish the running job, drop queued ones and join the worker.
+    void Stop();
+
+    void PrintStats(std::ostream& os) const;
+
+    // Sentence split on 。！？；!?; and newlines (and '.' before a space);
+    // closing quotes stay with their sentence, fragments shorter than a few
+    // characters are merged into the next one, and sentences longer than
+    // `max_chars` are cut at the last comma or space, else hard.
+    static std::vector<std::string> SplitSentences(const std::string& text, std::size_t max_chars);
+    static std::size_t CountChars(const std::string& text);
+
+ private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Job {
+        JobStats stats;
+        std::string text;
+        Clock::time_point submitted;
+        bool first_audio;
+        std::unique_ptr<PcmSessionWriter> writer;
+    };
+
+    void WorkerMain();
+    void RunJob(Job* job);
+    bool SendSegment(const std::string& request, int timeout_ms, uint64_t* idle_seq);
+
+    Options options_;
+    mutable std::mutex lock_;
+    std::condition_variable cv_;
+    std::thread worker_;
+    bool stopping_;
+    uint64_t next_id_;
+    std::deque<std::shared_ptr<Job> > pending_;
+    std::vector<std::shared_ptr<Job> > finished_;  // most recent kMaxFinishedJobs
+    uint64_t running_id_;  // popped from pending_, not finished yet
+    Job* active_;          // receives OnAudio while set
+
+    LatencyHistogram first_audio_us_;
+    uint64_t total_chars_;
+    uint64_t total_us_;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief VQA请求内容缓存（按图片内容哈希，LRU内存上限）
+ *
+ * Camera feeds resend identical frames under new file names, so entries are
+ * keyed by ContentHash64 of the image bytes seeded with the prompt, not by
+ * path. An entry holds the ready-to-send request body and, once a round for
+ * it has completed, the answer text of that round (the text of its last
+ * kRespondingDetail).
+ *
+ * A hit skips the base64 encode. With serve_answers enabled, a hit that has
+ * an answer skips the round trip too: the caller reports the cached answer
+ * instead of sending. Entries are evicted least recently used first once
+ * the bodies and answers exceed the byte budget; a budget of 0 disables
+ * the cache.
+ *
+ * Answers are attached through BeginRound / OnResponseDetail / EndRound,
+ * called from the request path and the event handlers respectively; one VQA
+ * round is in flight at a time (the dialog is gated on IDLE).
+ */
+class VqaCache {
+ public:
+    static const std::size_t kDefaultBudgetBytes = 64u << 20;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t answered = 0;     // hits served without a round trip
+        uint64_t evictions = 0;
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+    };
+
+    VqaCache();
+
+    VqaCache(const VqaCache&) = delete;
+    VqaCache& operator=(const VqaCache&) = delete;
+
+    void Configure(std::size_t budget_bytes, bool serve_answers);
+    bool enabled() const;
+
+    // Request body cached under `key`, or null on a miss. When answers are
+    // served and one is cached, it is copied to `answer`.
+    std::shared_ptr<const std::string> Lookup(uint64_t key, std::string* answer);
+    void Insert(uint64_t key, const std::shared_ptr<const std::string>& body);
+
+    // Collect the response of the round started for `key`.
+    void BeginRound(uint64_t key);
+    void AbortRound();
+    // `text`: payload.output.text of a kRespondingDetail.
+    void OnResponseDetail(const std::string& text);
+    void EndRound();
+
+    Stats GetStats() const;
+    void PrintStats(std::ostream& os) const;
+
+ private:
+    struct Entry {
+        uint64_t key;
+        std::shared_ptr<const std::string> body;
+        std::string answer;
+    };
+    typedef std::list<Entry> LruList;
+
+    static std::size_t EntryBytes(const Entry& entry);
+    void EvictLocked();
+
+    mutable std::mutex lock_;
+    std::size_t budget_;
+    bool serve_answers_;
+    LruList lru_;  // most recently used first
+    std::unordered_map<uint64_t, LruList::iterator> index_;
+    std::size_t bytes_;
+    bool pending_;
+    uint64_t pending_key_;
+    std::string pending_answer_;
+    Stats stats_;
+};
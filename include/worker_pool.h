@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+
+#include "batch_runner.h"
+#include "latency_histogram.h"
+#include "round_tracer.h"
+
+/**
+ * @brief 多进程批量工作池
+ *
+ * The SDK allows one conversation per process, so parallel load runs in
+ * forked worker processes, each with its own Conversation. Before forking,
+ * the supervisor maps an anonymous shared region holding
+ *
+ *   - the round counter every worker's BatchRunner claims rounds from, so
+ *     the manifest is spread over the workers and each round runs once;
+ *   - one Slot per worker, where the worker publishes its batch report and
+ *     RoundTracer histograms (plain data) before it exits.
+ *
+ * Start() must be called before the supervisor starts any thread.
+ */
+class WorkerPool {
+ public:
+    struct Slot {
+        pid_t pid;
+        int32_t published;  // worker filled in the fields below
+        BatchRunner::Report batch;
+        uint64_t traced_rounds;
+        LatencyHistogram tracer[RoundTracer::kNumMetrics];
+    };
+
+    // Body of a worker process; its return value becomes the exit status.
+    typedef int (*WorkerMain)(int index, Slot* slot, std::atomic<uint64_t>* next_round);
+
+    explicit WorkerPool(int workers);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Map the shared region and fork the workers. Returns in the supervisor
+    // only; workers run `fn` and exit.
+    bool Start(WorkerMain fn, std::string* error);
+
+    // Reap every worker; returns how many failed (non-zero exit, signal,
+    // or no published results).
+    int Wait();
+
+    // Merged results of all workers that published, plus a per-worker line.
+    void PrintReport(std::ostream& os) const;
+
+ private:
+    struct Shared {
+        std::atomic<uint64_t> next_round;
+    };
+
+    Slot* SlotAt(int index) const;
+
+    int workers_;
+    void* region_;
+    std::size_t region_size_;
+    Shared* shared_;
+    int* exit_status_;
+    uint64_t wall_us_;
+};
@@ -0,0 +1,295 @@
+// Loopback stand-in for the DashScope duplex endpoint.
+//
+// Point gen_init_params' url at ws://127.0.0.1:<port>/ (conv_demo --url ...)
+// and the real libconversation talks to this process instead of the cloud.
+// Each connection replays the scenario (stub/scenarios/*.json) from the same
+// seed, so runs are comparable; per-connection traffic is printed on close.
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json/json.h"
+#include "scripted_dialog.h"
+#include "stub_scenario.h"
+#include "websocket.h"
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+struct ServerOptions {
+    int port = 18080;
+    int max_sessions = 0;  // 0 = serve forever
+    std::string scenario_path;
+};
+
+std::string TaskEvent(const char* event, const std::string& task_id) {
+    Json::Value root;
+    root["header"]["event"] = event;
+    root["header"]["task_id"] = task_id;
+    root["payload"] = Json::Value(Json::objectValue);
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    return Json::writeString(writer, root);
+}
+
+/**
+ * @brief 单条WebSocket连接上的对话会话
+ *
+ * Maps the client's run-task / continue-task / finish-task messages and
+ * binary uplink frames onto a ScriptedDialog, whose replies go straight
+ * back out as text and binary frames.
+ */
+class LoopbackSession {
+ public:
+    LoopbackSession(int fd, uint64_t id, const StubScenario& scenario)
+        : ws_(fd), id_(id), scenario_(scenario), audio_frames_(0), rejected_frames_(0) {}
+
+    void Run() {
+        Clock::time_point accepted = Clock::now();
+        std::string path;
+        if (!ws_.Handshake(&path)) {
+            std::fprintf(stderr, "[loopback #%llu] bad handshake\n", static_cast<unsigned long long>(id_));
+            return;
+        }
+        double handshake_us =
+            std::chrono::duration<double, std::micro>(Clock::now() - accepted).count();
+        std::printf("[loopback #%llu] connected %s (handshake %.0f us)\n",
+                    static_cast<unsigned long long>(id_), path.c_str(), handshake_us);
+
+        WebSocketConnection::Message message;
+        while (ws_.ReadMessage(&message)) {
+            if (message.opcode == WebSocketConnection::kOpBinary) {
+                audio_frames_++;
+                if (!dialog_ || !dialog_->OnAudio(message.payload.size())) rejected_frames_++;
+                continue;
+            }
+            if (!OnText(std::string(message.payload.begin(), message.payload.end()))) break;
+        }
+        Finish();
+    }
+
+ private:
+    // Returns false once the task is finished and the connection should close.
+    bool OnText(const std::string& text) {
+        Json::CharReaderBuilder builder;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        Json::Value root;
+        std::string errs;
+        if (!reader->parse(text.data(), text.data() + text.size(), &root, &errs) || !root.isObject()) {
+            std::fprintf(stderr, "[loopback #%llu] invalid message: %s\n",
+                         static_cast<unsigned long long>(id_), errs.c_str());
+            return true;
+        }
+
+        const std::string action = root["header"]["action"].asString();
+        const Json::Value& input = root["payload"]["input"];
+        if (action == "run-task") {
+            return StartTask(root["header"]["task_id"].asString());
+        }
+        if (action == "finish-task") {
+            return false;
+        }
+        if (action != "continue-task" || !dialog_) {
+            std::fprintf(stderr, "[loopback #%llu] unexpected action '%s'\n",
+                         static_cast<unsigned long long>(id_), action.c_str());
+            return true;
+        }
+
+        const std::string directive = input["directive"].asString();
+        bool accepted = true;
+        if (directive == "SendSpeech") {
+            accepted = dialog_->StartSpeech();
+        } else if (directive == "StopSpeech") {
+            accepted = dialog_->StopSpeech();
+        } else if (directive == "RequestToRespond") {
+            accepted = dialog_->Request(input["text"].asString(), input["type"].asString() != "transcript");
+        } else if (directive == "LocalRespondingEnded") {
+            accepted = dialog_->PlayerStopped();
+        } else if (directive == "Interrupt" || directive == "RequestToSpeak") {
+            accepted = dialog_->Interrupt();
+        } else if (directive == "Stop") {
+            return false;
+        }
+        // LocalRespondingStarted, UpdateInfo and friends need no reply.
+        if (!accepted) {
+            std::fprintf(stderr, "[loopback #%llu] directive %s rejected in state %d\n",
+                         static_cast<unsigned long long>(id_), directive.c_str(), dialog_->dialog_state());
+        }
+        return true;
+    }
+
+    bool StartTask(const std::string& task_id) {
+        if (dialog_) {
+            ws_.SendText(TaskEvent("task-failed", task_id));
+            return false;
+        }
+        task_id_ = task_id;
+        std::ostringstream dialog_id;
+        dialog_id << "loopback-dialog-" << id_;
+
+        WebSocketConnection* ws = &ws_;
+        dialog_.reset(new ScriptedDialog(
+            scenario_,
+            [ws](const std::string& json) { ws->SendText(json); },
+            [ws](std::vector<unsigned char>& pcm, const std::string&) { ws->SendBinary(pcm.data(), pcm.size()); }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(dialog_->Jittered(scenario_.connect_ms)));
+        ws_.SendText(TaskEvent("task-started", task_id_));
+        dialog_->Start(task_id_, dialog_id.str());
+        return true;
+    }
+
+    void Finish() {
+        uint64_t uplink = 0;
+        uint64_t rounds = 0;
+        if (dialog_) {
+            dialog_->Stop();
+            ws_.SendText(dialog_->RenderOutput("Stopped", Json::Value()));
+            ws_.SendText(TaskEvent("task-finished", task_id_));
+            uplink = dialog_->uplink_bytes();
+            rounds = dialog_->rounds();
+        }
+        ws_.SendClose(1000);
+
+        WebSocketConnection::Stats stats = ws_.GetStats();
+        std::printf("[loopback #%llu] closed: %llu rounds, in %llu msgs / %llu bytes (%llu audio frames, "
+                    "%llu rejected, %llu audio bytes), out %llu msgs / %llu bytes\n",
+                    static_cast<unsigned long long>(id_),
+                    static_cast<unsigned long long>(rounds),
+                    static_cast<unsigned long long>(stats.messages_in),
+                    static_cast<unsigned long long>(stats.bytes_in),
+                    static_cast<unsigned long long>(audio_frames_),
+                    static_cast<unsigned long long>(rejected_frames_),
+                    static_cast<unsigned long long>(uplink),
+                    static_cast<unsigned long long>(stats.messages_out),
+                    static_cast<unsigned long long>(stats.bytes_out));
+        std::fflush(stdout);
+    }
+
+    WebSocketConnection ws_;
+    uint64_t id_;
+    StubScenario scenario_;
+    std::unique_ptr<ScriptedDialog> dialog_;
+    std::string task_id_;
+    uint64_t audio_frames_;
+    uint64_t rejected_frames_;
+};
+
+void PrintUsage(const char* prog) {
+    std::printf("usage: %s [--port N] [--scenario file.json] [--max-sessions N]\n", prog);
+}
+
+bool ParseArgs(int argc, char* argv[], ServerOptions* options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            options->port = std::atoi(argv[++i]);
+        } else if (arg == "--scenario" && i + 1 < argc) {
+            options->scenario_path = argv[++i];
+        } else if (arg == "--max-sessions" && i + 1 < argc) {
+            options->max_sessions = std::atoi(argv[++i]);
+        } else {
+            PrintUsage(argv[0]);
+            return false;
+        }
+    }
+    return options->port > 0 && options->port < 65536;
+}
+}
+
+int main(int argc, char* argv[]) {
+    ServerOptions options;
+    if (!ParseArgs(argc, argv, &options)) return 1;
+
+    StubScenario scenario = StubScenario::FromEnv();
+    if (!options.scenario_path.empty()) {
+        std::string error;
+        if (!scenario.LoadFile(options.scenario_path, &error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        std::perror("socket");
+        return 1;
+    }
+    int one = 1;
+    ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (::bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listen_fd, 16) < 0) {
+        std::perror("bind/listen");
+        ::close(listen_fd);
+        return 1;
+    }
+
+    std::printf("loopback server on ws://127.0.0.1:%d/ (tts %d Hz, packet %d bytes, burst x%.2f, jitter %d ms, seed %u)\n",
+                options.port, scenario.tts_sample_rate, scenario.packet_bytes, scenario.burst_speed,
+                scenario.jitter_ms, scenario.seed);
+    std::fflush(stdout);
+
+    // Finished sessions are joined before each new one starts, so a server
+    // left running does not accumulate one thread per past connection.
+    struct SessionThread {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool> > done;
+    };
+    std::vector<SessionThread> sessions;
+    for (uint64_t id = 1; options.max_sessions <= 0 || id <= static_cast<uint64_t>(options.max_sessions); ++id) {
+        int fd = ::accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                --id;
+                continue;
+            }
+            std::perror("accept");
+            break;
+        }
+        // Downlink packets are small and latency matters more than throughput.
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        for (std::size_t i = 0; i < sessions.size();) {
+            if (sessions[i].done->load()) {
+                sessions[i].thread.join();
+                sessions[i] = std::move(sessions.back());
+                sessions.pop_back();
+            } else {
+                ++i;
+            }
+        }
+        SessionThread entry;
+        entry.done = std::make_shared<std::atomic<bool> >(false);
+        std::shared_ptr<std::atomic<bool> > done = entry.done;
+        entry.thread = std::thread([fd, id, scenario, done]() {
+            {
+                LoopbackSession session(fd, id, scenario);
+                session.Run();
+            }
+            done->store(true);
+        });
+        sessions.push_back(std::move(entry));
+    }
+
+    for (std::size_t i = 0; i < sessions.size(); ++i) sessions[i].thread.join();
+    ::close(listen_fd);
+    return 0;
+}
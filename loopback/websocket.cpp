@@ -0,0 +1,317 @@
+#include "websocket.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+const char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+const std::size_t kMaxHandshakeBytes = 16 * 1024;
+// Largest message we accept from a client; uplink frames are a few KB.
+const uint64_t kMaxMessageBytes = 16 * 1024 * 1024;
+
+uint32_t Rol(uint32_t v, int bits) {
+    return (v << bits) | (v >> (32 - bits));
+}
+
+void Sha1(const std::string& input, unsigned char digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+    std::string msg = input;
+    uint64_t bit_len = static_cast<uint64_t>(input.size()) * 8;
+    msg.push_back(static_cast<char>(0x80));
+    while (msg.size() % 64 != 56) msg.push_back('\0');
+    for (int i = 7; i >= 0; --i) msg.push_back(static_cast<char>((bit_len >> (i * 8)) & 0xff));
+
+    for (std::size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(msg.data()) + chunk + i * 4;
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = Rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            uint32_t t = Rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = Rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 5; ++i) {
+        digest[i * 4] = static_cast<unsigned char>(h[i] >> 24);
+        digest[i * 4 + 1] = static_cast<unsigned char>(h[i] >> 16);
+        digest[i * 4 + 2] = static_cast<unsigned char>(h[i] >> 8);
+        digest[i * 4 + 3] = static_cast<unsigned char>(h[i]);
+    }
+}
+
+std::string Base64(const unsigned char* data, std::size_t size) {
+    static const char kChars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (std::size_t i = 0; i < size; i += 3) {
+        uint32_t v = uint32_t(data[i]) << 16;
+        if (i + 1 < size) v |= uint32_t(data[i + 1]) << 8;
+        if (i + 2 < size) v |= data[i + 2];
+        out.push_back(kChars[(v >> 18) & 0x3f]);
+        out.push_back(kChars[(v >> 12) & 0x3f]);
+        out.push_back(i + 1 < size ? kChars[(v >> 6) & 0x3f] : '=');
+        out.push_back(i + 2 < size ? kChars[v & 0x3f] : '=');
+    }
+    return out;
+}
+
+// Case-insensitive lookup of an HTTP header value.
+std::string HeaderValue(const std::string& request, const std::string& name) {
+    std::size_t pos = 0;
+    while ((pos = request.find("\r\n", pos)) != std::string::npos) {
+        pos += 2;
+        if (request.size() - pos < name.size() + 1) break;
+        if (strncasecmp(request.c_str() + pos, name.c_str(), name.size()) == 0 &&
+            request[pos + name.size()] == ':') {
+            std::size_t begin = request.find_first_not_of(" \t", pos + name.size() + 1);
+            std::size_t end = request.find("\r\n", pos);
+            if (begin == std::string::npos || begin > end) return std::string();
+            std::size_t last = request.find_last_not_of(" \t", end - 1);
+            return request.substr(begin, last + 1 - begin);
+        }
+    }
+    return std::string();
+}
+}
+
+std::string WebSocketAcceptKey(const std::string& client_key) {
+    unsigned char digest[20];
+    Sha1(client_key + kWebSocketGuid, digest);
+    return Base64(digest, sizeof(digest));
+}
+
+WebSocketConnection::WebSocketConnection(int fd) : fd_(fd), closed_(false) {}
+
+WebSocketConnection::~WebSocketConnection() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool WebSocketConnection::Handshake(std::string* path) {
+    std::string request;
+    char buf[2048];
+    std::size_t header_end = std::string::npos;
+    while (header_end == std::string::npos) {
+        if (request.size() > kMaxHandshakeBytes) return false;
+        ssize_t n = ::recv(fd_, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        request.append(buf, static_cast<std::size_t>(n));
+        header_end = request.find("\r\n\r\n");
+    }
+    pending_.assign(request.begin() + header_end + 4, request.end());
+    request.resize(header_end + 2);
+
+    std::string key = HeaderValue(request, "Sec-WebSocket-Key");
+    std::size_t sp1 = request.find(' ');
+    std::size_t sp2 = sp1 == std::string::npos ? sp1 : request.find(' ', sp1 + 1);
+    if (request.compare(0, 4, "GET ") != 0 || key.empty() || sp2 == std::string::npos) {
+        const char kBad[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+        ::send(fd_, kBad, sizeof(kBad) - 1, MSG_NOSIGNAL);
+        return false;
+    }
+    if (path) *path = request.substr(sp1 + 1, sp2 - sp1 - 1);
+
+    std::string response =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: " + WebSocketAcceptKey(key) + "\r\n\r\n";
+    return ::send(fd_, response.data(), response.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(response.size());
+}
+
+bool WebSocketConnection::ReadExact(unsigned char* data, std::size_t size) {
+    std::size_t from_pending = std::min(size, pending_.size());
+    if (from_pending > 0) {
+        std::memcpy(data, pending_.data(), from_pending);
+        pending_.erase(pending_.begin(), pending_.begin() + from_pending);
+        data += from_pending;
+        size -= from_pending;
+    }
+    while (size > 0) {
+        ssize_t n = ::recv(fd_, data, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool WebSocketConnection::ReadMessage(Message* message) {
+    message->payload.clear();
+    bool in_fragment = false;
+
+    for (;;) {
+        unsigned char head[2];
+        if (!ReadExact(head, 2)) return false;
+        bool fin = (head[0] & 0x80) != 0;
+        Opcode opcode = static_cast<Opcode>(head[0] & 0x0f);
+        bool masked = (head[1] & 0x80) != 0;
+        uint64_t len = head[1] & 0x7f;
+        if (len == 126) {
+            unsigned char ext[2];
+            if (!ReadExact(ext, 2)) return false;
+            len = (uint64_t(ext[0]) << 8) | ext[1];
+        } else if (len == 127) {
+            unsigned char ext[8];
+            if (!ReadExact(ext, 8)) return false;
+            len = 0;
+            for (int i = 0; i < 8; ++i) len = (len << 8) | ext[i];
+        }
+        if (len > kMaxMessageBytes || message->payload.size() + len > kMaxMessageBytes) {
+            SendClose(1009);
+            return false;
+        }
+        unsigned char mask[4] = {0, 0, 0, 0};
+        if (masked && !ReadExact(mask, 4)) return false;
+
+        std::vector<unsigned char> frame(static_cast<std::size_t>(len));
+        if (len > 0 && !ReadExact(frame.data(), frame.size())) return false;
+        if (masked) {
+            for (std::size_t i = 0; i < frame.size(); ++i) frame[i] ^= mask[i & 3];
+        }
+
+        switch (opcode) {
+        case kOpPing:
+            SendFrame(kOpPong, frame.data(), frame.size());
+            continue;
+        case kOpPong:
+            continue;
+        case kOpClose:
+            SendClose(1000);
+            return false;
+        case kOpContinuation:
+            if (!in_fragment) return false;
+            break;
+        case kOpText:
+        case kOpBinary:
+            if (in_fragment) return false;
+            message->opcode = opcode;
+            in_fragment = true;
+            break;
+        default:
+            SendClose(1002);
+            return false;
+        }
+
+        message->payload.insert(message->payload.end(), frame.begin(), frame.end());
+        if (fin) {
+            std::lock_guard<std::mutex> guard(send_lock_);
+            stats_.messages_in++;
+            stats_.bytes_in += message->payload.size();
+            return true;
+        }
+    }
+}
+
+bool WebSocketConnection::SendText(const std::string& text) {
+    return SendFrame(kOpText, reinterpret_cast<const unsigned char*>(text.data()), text.size());
+}
+
+bool WebSocketConnection::SendBinary(const unsigned char* data, std::size_t size) {
+    return SendFrame(kOpBinary, data, size);
+}
+
+void WebSocketConnection::SendClose(uint16_t code) {
+    unsigned char payload[2] = {static_cast<unsigned char>(code >> 8), static_cast<unsigned char>(code & 0xff)};
+    SendFrame(kOpClose, payload, sizeof(payload));
+    std::lock_guard<std::mutex> guard(send_lock_);
+    closed_ = true;
+}
+
+WebSocketConnection::Stats WebSocketConnection::GetStats() const {
+    std::lock_guard<std::mutex> guard(send_lock_);
+    return stats_;
+}
+
+bool WebSocketConnection::SendFrame(Opcode opcode, const unsigned char* data, std::size_t size) {
+    // Server frames are never masked.
+    unsigned char head[10];
+    std::size_t head_len = 2;
+    head[0] = static_cast<unsigned char>(0x80 | opcode);
+    if (size < 126) {
+        head[1] = static_cast<unsigned char>(size);
+    } else if (size <= 0xffff) {
+        head[1] = 126;
+        head[2] = static_cast<unsigned char>(size >> 8);
+        head[3] = static_cast<unsigned char>(size & 0xff);
+        head_len = 4;
+    } else {
+        head[1] = 127;
+        for (int i = 0; i < 8; ++i) head[2 + i] = static_cast<unsigned char>((uint64_t(size) >> ((7 - i) * 8)) & 0xff);
+        head_len = 10;
+    }
+
+    std::lock_guard<std::mutex> guard(send_lock_);
+    if (closed_) return false;
+
+    struct iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = head_len;
+    iov[1].iov_base = const_cast<unsigned char*>(data);
+    iov[1].iov_len = size;
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = size > 0 ? 2 : 1;
+
+    // sendmsg() may write partially; advance through the iovecs until done.
+    std::size_t left = head_len + size;
+    while (left > 0) {
+        ssize_t n = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            closed_ = true;
+            return false;
+        }
+        left -= static_cast<std::size_t>(n);
+        while (n > 0 && msg.msg_iovlen > 0) {
+            if (static_cast<std::size_t>(n) >= msg.msg_iov->iov_len) {
+                n -= static_cast<ssize_t>(msg.msg_iov->iov_len);
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            } else {
+                msg.msg_iov->iov_base = static_cast<char*>(msg.msg_iov->iov_base) + n;
+                msg.msg_iov->iov_len -= static_cast<std::size_t>(n);
+                n = 0;
+            }
+        }
+    }
+    if (opcode == kOpText || opcode == kOpBinary) {
+        stats_.messages_out++;
+        stats_.bytes_out += size;
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 最小化的WebSocket服务端连接（RFC 6455）
+ *
+ * Just enough of the protocol for the loopback server: the HTTP upgrade
+ * handshake, masked client frames (fragmented or not), ping/pong and close.
+ * No extensions, no TLS. Reads happen on one thread; sends may come from
+ * several threads and are serialized internally, each message going out in
+ * a single sendmsg() of header + payload.
+ */
+class WebSocketConnection {
+ public:
+    enum Opcode {
+        kOpContinuation = 0x0,
+        kOpText = 0x1,
+        kOpBinary = 0x2,
+        kOpClose = 0x8,
+        kOpPing = 0x9,
+        kOpPong = 0xa,
+    };
+
+    struct Message {
+        Opcode opcode = kOpText;
+        std::vector<unsigned char> payload;
+    };
+
+    struct Stats {
+        uint64_t messages_in = 0;
+        uint64_t bytes_in = 0;
+        uint64_t messages_out = 0;
+        uint64_t bytes_out = 0;
+    };
+
+    // Takes ownership of a connected socket.
+    explicit WebSocketConnection(int fd);
+    ~WebSocketConnection();
+
+    WebSocketConnection(const WebSocketConnection&) = delete;
+    WebSocketConnection& operator=(const WebSocketConnection&) = delete;
+
+    // Read the HTTP upgrade request and answer it. `path` receives the
+    // request target. Returns false (after replying 400) on a bad request.
+    bool Handshake(std::string* path);
+
+    // Block until the next complete text or binary message. Control frames
+    // are handled internally. Returns false on close or error.
+    bool ReadMessage(Message* message);
+
+    bool SendText(const std::string& text);
+    bool SendBinary(const unsigned char* data, std::size_t size);
+    void SendClose(uint16_t code = 1000);
+
+    Stats GetStats() const;
+
+ private:
+    bool SendFrame(Opcode opcode, const unsigned char* data, std::size_t size);
+    bool ReadExact(unsigned char* data, std::size_t size);
+
+    int fd_;
+    bool closed_;
+    // Bytes read past the end of the HTTP request.
+    std::vector<unsigned char> pending_;
+    mutable std::mutex send_lock_;
+    Stats stats_;
+};
+
+// SHA-1 + base64 of key + RFC 6455 GUID, for the Sec-WebSocket-Accept header.
+std::string WebSocketAcceptKey(const std::string& client_key);
@@ -0,0 +1,295 @@
+#include "async_log.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include "spsc_ring.h"
+
+using namespace convsdk;
+
+const std::size_t AsyncLog::kLineBytes;
+const std::size_t AsyncLog::kMaxLineParts;
+const std::size_t AsyncLog::kLinesPerThread;
+
+namespace {
+
+// Idle sleep of the writer thread between sweeps.
+const std::chrono::milliseconds kWriterIdle(2);
+// Size of the per-fd batch handed to write().
+const std::size_t kBatchBytes = 64 * 1024;
+
+// Text per slot; the last slot of a line also holds its '\n'.
+const std::size_t kChunkBytes = AsyncLog::kLineBytes - 1;
+// Longest line kept; the rest is cut and counted as truncated.
+const std::size_t kMaxLineBytes = AsyncLog::kMaxLineParts * kChunkBytes;
+
+struct LogLine {
+    uint8_t level;
+    uint16_t len;
+    uint16_t remaining;  // slots of this line from here on, this one included
+    char text[AsyncLog::kLineBytes];
+};
+
+// Whole text of a line too long for one slot, formatted by its thread.
+thread_local std::vector<char> t_long_line;
+
+void WriteAll(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+}
+
+int FdFor(int level) {
+    return level >= kConvLogLevelWarning ? STDERR_FILENO : STDOUT_FILENO;
+}
+
+// Format into `line` and append '\n'. Returns the length of the full text;
+// if it is more than kChunkBytes, `line` is incomplete and the caller
+// formats the line again with FormatLong().
+std::size_t FormatLine(LogLine& line, int level, const char* fmt, va_list ap) {
+    int n = vsnprintf(line.text, sizeof(line.text), fmt, ap);
+    if (n < 0) n = 0;
+    line.level = static_cast<uint8_t>(level);
+    line.remaining = 1;
+    if (static_cast<std::size_t>(n) <= kChunkBytes) {
+        line.text[n] = '\n';
+        line.len = static_cast<uint16_t>(n + 1);
+    }
+    return static_cast<std::size_t>(n);
+}
+
+// Format a line of `full` bytes into t_long_line, cut at kMaxLineBytes.
+// Returns the length kept.
+std::size_t FormatLong(const char* fmt, va_list ap, std::size_t full) {
+    std::size_t size = full < kMaxLineBytes ? full : kMaxLineBytes;
+    t_long_line.resize(size + 1);
+    vsnprintf(&t_long_line[0], size + 1, fmt, ap);
+    return size;
+}
+
+}  // namespace
+
+struct AsyncLog::ThreadBuffer {
+    SpscRing<LogLine, AsyncLog::kLinesPerThread> ring;
+    std::atomic<bool> retired;
+
+    ThreadBuffer() : retired(false) {}
+};
+
+namespace {
+// Marks the calling thread's buffer retired when the thread exits; the
+// writer frees it once drained.
+struct ThreadBufferHolder {
+    AsyncLog::ThreadBuffer* buffer;
+    ThreadBufferHolder() : buffer(nullptr) {}
+    ~ThreadBufferHolder() {
+        if (buffer) buffer->retired.store(true);
+    }
+};
+thread_local ThreadBufferHolder t_holder;
+}  // namespace
+
+AsyncLog& AsyncLog::Instance() {
+    // Intentionally leaked so logging from static destructors stays valid.
+    static AsyncLog* instance = new AsyncLog();
+    return *instance;
+}
+
+AsyncLog::AsyncLog()
+    : level_(kConvLogLevelVerbose),
+      running_(false),
+      written_(0),
+      dropped_(0),
+      truncated_(0),
+      sweeps_(0) {
+    for (int i = 0; i < 2; ++i) batch_[i].reserve(kBatchBytes + kLineBytes);
+}
+
+AsyncLog::~AsyncLog() {
+    Stop();
+}
+
+ConvLogLevel AsyncLog::ParseLevel(const std::string& name) {
+    if (name == "verbose") return kConvLogLevelVerbose;
+    if (name == "debug") return kConvLogLevelDebug;
+    if (name == "info") return kConvLogLevelInfo;
+    if (name == "warn" || name == "warning") return kConvLogLevelWarning;
+    if (name == "error") return kConvLogLevelError;
+    if (name == "none") return kConvLogLevelNone;
+    return kConvLogLevelInfo;
+}
+
+void AsyncLog::Start() {
+    bool expected = false;
+    if (!running_.compare_exchange_strong(expected, true)) return;
+    writer_ = std::thread(&AsyncLog::WriterMain, this);
+}
+
+void AsyncLog::Stop() {
+    bool expected = true;
+    if (!running_.compare_exchange_strong(expected, false)) return;
+    if (writer_.joinable()) writer_.join();
+    DrainOnce();
+}
+
+void AsyncLog::Flush() {
+    if (!running_.load()) {
+        DrainOnce();
+        return;
+    }
+    // The second sweep to finish after this point started after the call, so
+    // it has drained everything published before it.
+    uint64_t target = sweeps_.load() + 2;
+    while (running_.load() && sweeps_.load() < target) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+AsyncLog::ThreadBuffer* AsyncLog::LocalBuffer() {
+    if (!t_holder.buffer) {
+        ThreadBuffer* buffer = new ThreadBuffer();
+        std::lock_guard<std::mutex> guard(buffers_lock_);
+        buffers_.push_back(buffer);
+        t_holder.buffer = buffer;
+    }
+    return t_holder.buffer;
+}
+
+void AsyncLog::Write(ConvLogLevel level, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    va_list again;
+    va_copy(again, ap);
+    if (!running_.load(std::memory_order_relaxed)) {
+        LogLine line;
+        std::size_t full = FormatLine(line, level, fmt, ap);
+        if (full <= kChunkBytes) {
+            WriteAll(FdFor(level), line.text, line.len);
+        } else {
+            std::size_t size = FormatLong(fmt, again, full);
+            if (size < full) truncated_++;
+            t_long_line[size] = '\n';
+            WriteAll(FdFor(level), t_long_line.data(), size + 1);
+        }
+        va_end(again);
+        va_end(ap);
+        written_++;
+        return;
+    }
+
+    ThreadBuffer* buffer = LocalBuffer();
+    LogLine* slot = buffer->ring.ProducerSlot();
+    if (!slot) {
+        va_end(again);
+        va_end(ap);
+        dropped_++;
+        return;
+    }
+    std::size_t full = FormatLine(*slot, level, fmt, ap);
+    va_end(ap);
+    if (full <= kChunkBytes) {
+        va_end(again);
+        buffer->ring.Publish();
+        return;
+    }
+
+    // Too long for one slot: spread the line over consecutive slots. The
+    // writer takes them only once all are published, so the line is never
+    // interleaved with other threads' output.
+    std::size_t size = FormatLong(fmt, again, full);
+    va_end(again);
+    const std::size_t parts = (size + kChunkBytes - 1) / kChunkBytes;
+    if (buffer->ring.capacity() - buffer->ring.SizeApprox() < parts) {
+        dropped_++;
+        return;
+    }
+    if (size < full) truncated_++;
+    for (std::size_t i = 0; i < parts; ++i) {
+        // Room was checked above and only this thread fills the ring.
+        LogLine* part = buffer->ring.ProducerSlot();
+        const std::size_t off = i * kChunkBytes;
+        const std::size_t n = size - off < kChunkBytes ? size - off : kChunkBytes;
+        std::memcpy(part->text, &t_long_line[off], n);
+        part->len = static_cast<uint16_t>(n);
+        if (i + 1 == parts) part->text[part->len++] = '\n';
+        part->level = static_cast<uint8_t>(level);
+        part->remaining = static_cast<uint16_t>(parts - i);
+        buffer->ring.Publish();
+    }
+}
+
+AsyncLog::Stats AsyncLog::GetStats() const {
+    Stats st;
+    st.written = written_.load();
+    st.dropped = dropped_.load();
+    st.truncated = truncated_.load();
+    return st;
+}
+
+std::size_t AsyncLog::DrainOnce() {
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> guard(buffers_lock_);
+        buffers = buffers_;
+    }
+
+    std::vector<char>* out = batch_;
+
+    std::size_t slots = 0;
+    std::size_t lines = 0;
+    for (std::size_t i = 0; i < buffers.size(); ++i) {
+        const LogLine* line;
+        while ((line = buffers[i]->ring.ConsumerSlot()) != nullptr) {
+            // Wait for the rest of a split line before taking any of it.
+            if (buffers[i]->ring.SizeApprox() < line->remaining) break;
+            std::vector<char>& batch = out[FdFor(line->level) == STDERR_FILENO ? 1 : 0];
+            batch.insert(batch.end(), line->text, line->text + line->len);
+            // A split line counts once, on its last slot.
+            if (line->remaining == 1) lines++;
+            buffers[i]->ring.Release();
+            slots++;
+            if (batch.size() >= kBatchBytes) {
+                WriteAll(&batch == &out[1] ? STDERR_FILENO : STDOUT_FILENO, batch.data(), batch.size());
+                batch.clear();
+            }
+        }
+    }
+    if (!out[0].empty()) WriteAll(STDOUT_FILENO, out[0].data(), out[0].size());
+    if (!out[1].empty()) WriteAll(STDERR_FILENO, out[1].data(), out[1].size());
+    out[0].clear();
+    out[1].clear();
+    written_ += lines;
+
+    // Free buffers of exited threads once they are empty.
+    std::lock_guard<std::mutex> guard(buffers_lock_);
+    for (std::size_t i = 0; i < buffers_.size();) {
+        ThreadBuffer* b = buffers_[i];
+        if (b->retired.load() && b->ring.SizeApprox() == 0) {
+            buffers_[i] = buffers_.back();
+            buffers_.pop_back();
+            delete b;
+        } else {
+            ++i;
+        }
+    }
+    sweeps_++;
+    return slots;
+}
+
+void AsyncLog::WriterMain() {
+    while (running_.load()) {
+        if (DrainOnce() == 0) {
+            std::this_thread::sleep_for(kWriterIdle);
+        }
+    }
+}
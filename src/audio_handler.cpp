@@ -1,143 +1,224 @@
 #include "audio_handler.h"
 #include "conversation_handler.h"
 
-#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <memory>
+
+#include "async_log.h"
+#include "audio_pacer.h"
+#include "mapped_audio.h"
+#include "pcm_writer.h"
 
 
 using namespace convsdk;
 
-// Save incoming binary payload to local files for inspection/playback.
-// Writes both a per-chunk file and appends to a session-total file under `tmp/`.
+namespace {
+
+// Must match downstream.sample_rate in gen_init_params().
+const int kDownlinkSampleRate = 24000;
+
+std::mutex g_writers_lock;
+std::map<std::string, std::unique_ptr<PcmSessionWriter> > g_writers;
+
+void EnsureOutDir() {
+    static std::once_flag once;
+    std::call_once(once, []() {
+        struct stat st = {0};
+        if (stat(g_output_dir.c_str(), &st) == -1) {
+            mkdir(g_output_dir.c_str(), 0755);
+        }
+    });
+}
+
+// Look up (or lazily open) the writer owning `session_id`.
+PcmSessionWriter* GetSessionWriter(const std::string& session_id) {
+    std::lock_guard<std::mutex> guard(g_writers_lock);
+    auto it = g_writers.find(session_id);
+    if (it != g_writers.end()) {
+        return it->second.get();
+    }
+
+    EnsureOutDir();
+    std::ostringstream oss;
+    oss << g_output_dir << "/binary_" << session_id << "_total.wav";
+    std::unique_ptr<PcmSessionWriter> writer(
+        new PcmSessionWriter(oss.str(), PcmSessionWriter::kContainerWav, kDownlinkSampleRate, 1));
+    if (!writer->Open()) {
+        return nullptr;
+    }
+    LOGI("Saving downlink audio to %s", writer->path().c_str());
+
+    PcmSessionWriter* raw = writer.get();
+    g_writers[session_id] = std::move(writer);
+    return raw;
+}
+
+}  // namespace
+
+// Save incoming binary payload to the session-total file under g_output_dir.
+// Reads the event's buffer in place (GetBinaryData() would return a copy by
+// value); the only copy is into the writer's pooled queue buffer.
 void SaveBinaryEventToFile(ConvEvent* event) {
     if (!event) return;
     int size = event->GetBinaryDataSize();
     if (size <= 0) return;
 
-    std::vector<unsigned char> data = event->GetBinaryData();
+    const unsigned char* data = event->GetBinaryDataInChar();
+    if (!data) return;
 
-    // Ensure output dir exists
-    const char* out_dir = "tmp";
-    struct stat st = {0};
-    if (stat(out_dir, &st) == -1) {
-        mkdir(out_dir, 0755);
-    }
+    const char* session_id = event->GetSessionId();
+    PcmSessionWriter* writer = GetSessionWriter(session_id ? session_id : "");
+    if (!writer) return;
 
-    // Build filenames: per-chunk and total
-    static std::atomic<int> chunk_counter{0};
-    std::time_t t = std::time(nullptr);
-    std::ostringstream oss;
-    oss << out_dir << "/binary_" << event->GetSessionId() << "_" << t << "_" << chunk_counter++ << ".pcm";
-    std::string chunk_path = oss.str();
-
-    std::ofstream ofs(chunk_path, std::ios::binary | std::ios::out);
-    if (ofs.is_open()) {
-        ofs.write(reinterpret_cast<const char*>(data.data()), data.size());
-        ofs.close();
-        std::cout << "Saved binary chunk to " << chunk_path << " (" << data.size() << " bytes)" << std::endl;
-    } else {
-        std::cerr << "Failed to open " << chunk_path << " for writing" << std::endl;
+    if (!writer->Push(data, static_cast<size_t>(size))) {
+        LOGW("Downlink writer queue full, dropped %d bytes for %s", size, writer->path().c_str());
     }
+}
 
-    // Append to session total file
-    std::ostringstream totaloss;
-    totaloss << out_dir << "/binary_" << event->GetSessionId() << "_total.pcm";
-    std::string total_path = totaloss.str();
-    std::ofstream tofs(total_path, std::ios::binary | std::ios::app);
-    if (tofs.is_open()) {
-        tofs.write(reinterpret_cast<const char*>(data.data()), data.size());
-        tofs.close();
-
-        // Also convert the accumulated PCM to MP3 for quick inspection.
-        std::string mp3_path = total_path;
-        if (mp3_path.size() >= 4 && mp3_path.substr(mp3_path.size() - 4) == ".pcm") {
-            mp3_path.replace(mp3_path.size() - 4, 4, ".mp3");
-        } else {
-            mp3_path += ".mp3";
-        }
+void SaveBinaryToFile(const std::string& session_id, std::vector<unsigned char>& data) {
+    if (data.empty()) return;
+    PcmSessionWriter* writer = GetSessionWriter(session_id);
+    if (!writer) return;
 
-        static std::atomic<bool> mp3_busy{false};
-        bool expected = false;
-        if (mp3_busy.compare_exchange_strong(expected, true)) {
-            std::thread([total_path, mp3_path]() {
-                std::ostringstream cmd;
-                cmd << "ffmpeg -y -f s16le -ar 24000 -ac 1 -i "
-                    << total_path
-                    << " -codec:a libmp3lame -b:a 128k "
-                    << mp3_path
-                    << " > /dev/null 2>&1";
-                int rc = std::system(cmd.str().c_str());
-                if (rc != 0) {
-                    std::cerr << "FFmpeg convert failed (rc=" << rc << ") for " << total_path << std::endl;
-                }
-                mp3_busy.store(false);
-            }).detach();
-        }
-        
-    } else {
-        std::cerr << "Failed to open " << total_path << " for appending" << std::endl;
+    size_t size = data.size();
+    if (!writer->Push(data)) {
+        LOGW("Downlink writer queue full, dropped %zu bytes for %s", size, writer->path().c_str());
     }
 }
 
+void CloseSessionWriters() {
+    std::map<std::string, std::unique_ptr<PcmSessionWriter> > writers;
+    {
+        std::lock_guard<std::mutex> guard(g_writers_lock);
+        writers.swap(g_writers);
+    }
+    for (auto& kv : writers) {
+        kv.second->Close();
+        PcmSessionWriter::Stats st = kv.second->GetStats();
+        LOGI("Closed %s: %llu bytes, %llu chunks in %llu batches, %llu dropped; copied %llu bytes, "
+             "%llu buffer allocations, %llu allocations avoided",
+             kv.second->path().c_str(), (unsigned long long)st.bytes_written,
+             (unsigned long long)st.chunks_written, (unsigned long long)st.batches,
+             (unsigned long long)st.dropped_chunks, (unsigned long long)st.bytes_copied,
+             (unsigned long long)st.buffer_allocations, (unsigned long long)st.allocations_avoided);
+    }
+}
+
+static void LogPacerStats(const char* what, const AudioPacer& pacer) {
+    const AudioPacer::Stats& ps = pacer.stats();
+    LOGI("%s: %llu chunks, media %llu ms in %llu ms (speed %.2f), jitter mean %lld us / max %lld us, "
+         "late chunks %llu, final drift %lld us", what,
+         (unsigned long long)ps.chunks, (unsigned long long)(ps.media_us / 1000),
+         (unsigned long long)(ps.wall_us / 1000), pacer.speed(),
+         (long long)(ps.chunks ? ps.total_jitter_us / static_cast<int64_t>(ps.chunks) : 0),
+         (long long)ps.max_jitter_us, (unsigned long long)ps.late_chunks, (long long)ps.final_drift_us);
+}
+
 bool SendAudioFile(Conversation* conversation,
                    const std::string& file_path,
                    const std::string& audio_format,
                    int sample_rate,
                    size_t chunk_size,
-                   bool skip_wav_header) {
+                   bool skip_wav_header,
+                   double speed) {
     if (!conversation) return false;
-    // Open the audio file
-    std::ifstream fs(file_path, std::ios::binary);
-    if (!fs.is_open()) {
-        std::cerr << "SendAudioFile: failed to open " << file_path << std::endl;
+
+    // Map the audio file (cached across repeated sends of the same path).
+    std::string error;
+    std::shared_ptr<const MappedAudioFile> file = MappedAudioFile::Open(file_path, &error);
+    if (!file) {
+        LOGE("SendAudioFile: failed to open %s: %s", file_path.c_str(), error.c_str());
         return false;
     }
 
-    // If PCM and file is WAV, optionally skip RIFF header (44 bytes typical)
-    if (skip_wav_header && audio_format == "pcm") {
-        // Peek first 12 bytes to detect RIFF/WAVE
-        char header[12] = {0};
-        fs.read(header, 12);
-        if (fs.gcount() == 12 &&
-            header[0] == 'R' && header[1] == 'I' && header[2] == 'F' && header[3] == 'F' &&
-            header[8] == 'W' && header[9] == 'A' && header[10] == 'V' && header[11] == 'E') {
-            // typical WAV header length is 44 bytes; move to 44
-            fs.seekg(44, std::ios::beg);
-        } else {
-            // not a WAV header -> rewind to file start
-            fs.clear();
-            fs.seekg(0, std::ios::beg);
+    // If PCM and file is WAV, optionally skip the RIFF header by sending only
+    // the `data` chunk, after checking its format against the call parameters.
+    const uint8_t* audio = file->data();
+    size_t audio_size = file->size();
+    if (skip_wav_header && audio_format == "pcm" && file->is_wav()) {
+        if (file->format_tag() != MappedAudioFile::kFormatPcm || file->bits_per_sample() != 16 ||
+            file->channels() != 1 || file->sample_rate() != sample_rate) {
+            LOGE("SendAudioFile: %s is format %d, %d ch, %d Hz, %d bit; expected 16 bit mono PCM at %d Hz",
+                 file_path.c_str(), file->format_tag(), file->channels(), file->sample_rate(),
+                 file->bits_per_sample(), sample_rate);
+            return false;
         }
+        audio = file->payload();
+        audio_size = file->payload_size();
     }
-
-    std::vector<uint8_t> buf(chunk_size);
-    while (!fs.eof()) {
-        fs.read(reinterpret_cast<char*>(buf.data()), buf.size());
-        std::streamsize n = fs.gcount();
-        if (n <= 0) break;
-
-        // Send actual read length (do not always send fixed chunk_size)
-        int ret_send = conversation->SendAudioData(buf.data(), static_cast<size_t>(n));
+    if (chunk_size == 0) chunk_size = audio_size;
+
+    // PCM: bytes per second = sample_rate * channels(1) * bytes_per_sample(2).
+    // Encoded formats (e.g. opus) have no byte/time relation; pace them at a
+    // nominal 20 ms per chunk.
+    const bool is_pcm = (audio_format == "pcm");
+    const uint64_t bytes_per_second = is_pcm && sample_rate > 0 ? static_cast<uint64_t>(sample_rate) * 1 * 2 : 0;
+    const uint64_t kEncodedChunkNs = 20000000ULL;
+
+    AudioPacer pacer(speed);
+    pacer.Start();
+    uint64_t bytes_sent = 0;
+    uint64_t chunks_sent = 0;
+
+    // Chunks point straight into the mapping; no bounce buffer.
+    for (size_t off = 0; off < audio_size; off += chunk_size) {
+        size_t n = std::min(chunk_size, audio_size - off);
+
+        // Sleep until this chunk's absolute position in the stream is due.
+        uint64_t pos_ns = bytes_per_second ? AudioPacer::BytesToNanos(bytes_sent, bytes_per_second)
+                                           : chunks_sent * kEncodedChunkNs;
+        pacer.WaitUntil(pos_ns);
+
+        // Send actual remaining length for the last chunk (do not pad to chunk_size)
+        int ret_send = conversation->SendAudioData(audio + off, n);
         if (ret_send != kSuccess) {
-            std::cerr << "SendAudioFile: SendAudioData returned " << ret_send << " for " << n << " bytes" << std::endl;
+            LOGE("SendAudioFile: SendAudioData returned %d for %zu bytes", ret_send, n);
         }
+        bytes_sent += n;
+        chunks_sent++;
+    }
+    if (chunks_sent > 0) {
+        g_round_tracer.Mark(RoundTracer::kTraceLastAudioSent);
+    }
+
+    pacer.Finish(bytes_per_second ? AudioPacer::BytesToNanos(bytes_sent, bytes_per_second)
+                                  : chunks_sent * kEncodedChunkNs);
+    LogPacerStats("SendAudioFile", pacer);
+
+    return true;
+}
 
-        // Sleep to simulate real-time streaming.
-        if (audio_format == "pcm") {
-            // PCM: bytes per second = sample_rate * channels(1) * bytes_per_sample(2)
-            int bytes_per_second = sample_rate * 1 * 2;
-            if (bytes_per_second > 0) {
-                int duration_ms = static_cast<int>(n * 1000LL / bytes_per_second);
-                if (duration_ms < 5) duration_ms = 5;
-                std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
-            } else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            }
-        } else {
-            // For encoded formats (e.g. opus) use a small fixed sleep
-            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+bool SendOpusFrames(Conversation* conversation,
+                    const OpusFrameCache::Frames& frames,
+                    double speed) {
+    if (!conversation || !frames.data) return false;
+
+    AudioPacer pacer(speed);
+    pacer.Start();
+    uint64_t packets_sent = 0;
+    bool ok = true;
+    // Packets point straight into the cache file's mapping.
+    for (size_t off = 0; off < frames.size;) {
+        size_t n = OpusFrameCache::FramedSize(frames.data + off, frames.size - off);
+        if (n == 0) {
+            LOGE("SendOpusFrames: %s: bad packet at offset %zu", frames.path.c_str(), off);
+            ok = false;
+            break;
         }
+        pacer.WaitUntil(packets_sent * OpusFrameCache::kFrameNs);
+        int ret_send = conversation->SendAudioData(frames.data + off, n, kEncoderOpu2);
+        if (ret_send != kSuccess) {
+            LOGE("SendOpusFrames: SendAudioData returned %d for %zu bytes", ret_send, n);
+        }
+        off += n;
+        packets_sent++;
+    }
+    if (packets_sent > 0) {
+        g_round_tracer.Mark(RoundTracer::kTraceLastAudioSent);
     }
 
-    fs.close();
-    return true;
+    pacer.Finish(packets_sent * OpusFrameCache::kFrameNs);
+    LogPacerStats("SendOpusFrames", pacer);
+    return ok;
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "audio_pacer.h"
+
+#include <thread>
+
+const int64_t AudioPacer::kLateThresholdUs;
+
+AudioPacer::AudioPacer(double speed)
+    : speed_(speed > 0.0 ? speed : 0.0),
+      start_(std::chrono::steady_clock::now()) {}
+
+void AudioPacer::Start() {
+    stats_ = Stats();
+    start_ = std::chrono::steady_clock::now();
+}
+
+uint64_t AudioPacer::BytesToNanos(uint64_t bytes, uint64_t bytes_per_second) {
+    if (bytes_per_second == 0) return 0;
+    // Split to keep bytes * 1e9 from overflowing on very long streams.
+    uint64_t whole = bytes / bytes_per_second;
+    uint64_t rest = bytes % bytes_per_second;
+    return whole * 1000000000ULL + rest * 1000000000ULL / bytes_per_second;
+}
+
+std::chrono::steady_clock::time_point AudioPacer::Deadline(uint64_t media_pos_ns) const {
+    uint64_t scaled = static_cast<uint64_t>(static_cast<double>(media_pos_ns) / speed_);
+    return start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::nanoseconds(scaled));
+}
+
+void AudioPacer::WaitUntil(uint64_t media_pos_ns) {
+    stats_.chunks++;
+    if (speed_ <= 0.0) return;
+
+    std::chrono::steady_clock::time_point deadline = Deadline(media_pos_ns);
+    std::this_thread::sleep_until(deadline);
+
+    int64_t late_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - deadline).count();
+    if (late_us < 0) late_us = 0;
+    stats_.total_jitter_us += late_us;
+    if (late_us > stats_.max_jitter_us) stats_.max_jitter_us = late_us;
+    if (late_us > kLateThresholdUs) stats_.late_chunks++;
+}
+
+void AudioPacer::Finish(uint64_t media_end_ns) {
+    // Let the last chunk play out before the caller stops the stream.
+    if (speed_ > 0.0) {
+        std::this_thread::sleep_until(Deadline(media_end_ns));
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    stats_.media_us = media_end_ns / 1000;
+    stats_.wall_us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(now - start_).count());
+    if (speed_ > 0.0) {
+        stats_.final_drift_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                    now - Deadline(media_end_ns)).count();
+    }
+}
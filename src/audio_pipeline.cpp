@@ -0,0 +1,175 @@
+#include "audio_pipeline.h"
+
+#include <chrono>
+
+#include "async_log.h"
+#include "conversation_handler.h"
+
+using namespace convsdk;
+
+const std::size_t AudioPipeline::kFrameBytes;
+const std::size_t AudioPipeline::kRingFrames;
+
+namespace {
+// Poll interval of the send thread when the ring is empty (frames are 20 ms).
+const std::chrono::milliseconds kIdlePoll(2);
+// A gap longer than this while sending counts as an underrun.
+const std::chrono::milliseconds kUnderrunGap(30);
+}
+
+AudioPipeline::AudioPipeline(Conversation* conversation, std::unique_ptr<AudioSource> source)
+    : conversation_(conversation),
+      source_(std::move(source)),
+      running_(false),
+      sending_(false),
+      presses_(0),
+      releases_(0),
+      frames_captured_(0),
+      frames_sent_(0),
+      frames_flushed_(0),
+      overruns_(0),
+      idle_drops_(0),
+      underruns_(0),
+      send_errors_(0) {}
+
+AudioPipeline::~AudioPipeline() {
+    Stop();
+}
+
+bool AudioPipeline::Start() {
+    if (!conversation_ || !source_) return false;
+    bool expected = false;
+    if (!running_.compare_exchange_strong(expected, true)) return true;
+    capture_thread_ = std::thread(&AudioPipeline::CaptureThreadMain, this);
+    send_thread_ = std::thread(&AudioPipeline::SendThreadMain, this);
+    return true;
+}
+
+void AudioPipeline::Stop() {
+    running_.store(false);
+    if (capture_thread_.joinable()) capture_thread_.join();
+    if (send_thread_.joinable()) send_thread_.join();
+}
+
+void AudioPipeline::Press() {
+    // Already held: a second press without a release is ignored.
+    if (presses_.load() == releases_.load()) presses_++;
+}
+
+void AudioPipeline::Release() {
+    // A release without an outstanding press is ignored.
+    if (releases_.load() < presses_.load()) releases_++;
+}
+
+AudioPipeline::Stats AudioPipeline::GetStats() const {
+    Stats st;
+    st.frames_captured = frames_captured_.load();
+    st.frames_sent = frames_sent_.load();
+    st.frames_flushed = frames_flushed_.load();
+    st.overruns = overruns_.load();
+    st.idle_drops = idle_drops_.load();
+    st.underruns = underruns_.load();
+    st.send_errors = send_errors_.load();
+    return st;
+}
+
+void AudioPipeline::CaptureThreadMain() {
+    Frame scratch;
+    while (running_.load()) {
+        Frame* slot = ring_.ProducerSlot();
+        Frame* target = slot ? slot : &scratch;
+        // Keep reading even when the ring is full so the source stays real time.
+        if (!source_->Read(target->data, kFrameBytes)) {
+            LOGW("AudioPipeline: audio source ended");
+            break;
+        }
+        target->size = static_cast<uint16_t>(kFrameBytes);
+        frames_captured_++;
+        if (slot) {
+            ring_.Publish();
+        } else if (sending_.load()) {
+            overruns_++;
+        } else {
+            idle_drops_++;
+        }
+    }
+}
+
+void AudioPipeline::SendThreadMain() {
+    // Presses and releases handled so far; the n-th release belongs to the
+    // n-th press.
+    uint64_t pressed = 0;
+    uint64_t released = 0;
+    std::size_t release_target = 0;
+    bool releasing = false;
+    std::chrono::steady_clock::time_point last_frame = std::chrono::steady_clock::now();
+    bool gap_counted = false;
+
+    while (running_.load()) {
+        if (!sending_.load() && released < pressed && releases_.load() > released) {
+            // Release of a press whose StartHumanSpeech failed.
+            released++;
+        } else if (!sending_.load() && released == pressed && presses_.load() > pressed) {
+            // Next press; one arriving while a release drains waits here.
+            pressed++;
+            // Drop whatever was captured before the press.
+            frames_flushed_ += ring_.Flush();
+            ConvRetCode ret = conversation_->SetAction(kStartHumanSpeech);
+            LOGI("SetAction StartHumanSpeech ret=%d", ret);
+            if (ret == kSuccess) {
+                g_round_tracer.Mark(RoundTracer::kTraceRequestSent);
+                sending_.store(true);
+                releasing = false;
+                last_frame = std::chrono::steady_clock::now();
+                gap_counted = false;
+            }
+        } else if (sending_.load() && !releasing && releases_.load() > released) {
+            released++;
+            // Send everything captured up to now, then stop.
+            release_target = ring_.ProducerPosition();
+            releasing = true;
+        }
+
+        if (!sending_.load()) {
+            // Not talking: keep only fresh audio in the ring.
+            if (ring_.SizeApprox() > kRingFrames / 2) {
+                ring_.Flush();
+            }
+            std::this_thread::sleep_for(kIdlePoll);
+            continue;
+        }
+
+        if (releasing && ring_.ConsumerPosition() >= release_target) {
+            g_round_tracer.Mark(RoundTracer::kTraceLastAudioSent);
+            ConvRetCode ret = conversation_->SetAction(kStopHumanSpeech);
+            LOGI("SetAction StopHumanSpeech ret=%d", ret);
+            sending_.store(false);
+            releasing = false;
+            continue;
+        }
+
+        const Frame* frame = ring_.ConsumerSlot();
+        if (!frame) {
+            if (!gap_counted && std::chrono::steady_clock::now() - last_frame > kUnderrunGap) {
+                underruns_++;
+                gap_counted = true;
+            }
+            std::this_thread::sleep_for(kIdlePoll);
+            continue;
+        }
+
+        ConvRetCode ret = conversation_->SendAudioData(frame->data, frame->size);
+        ring_.Release();
+        if (ret != kSuccess) {
+            send_errors_++;
+        }
+        frames_sent_++;
+        last_frame = std::chrono::steady_clock::now();
+        gap_counted = false;
+    }
+
+    if (sending_.load()) {
+        conversation_->SetAction(kStopHumanSpeech);
+        sending_.store(false);
+    }
+}
@@ -0,0 +1,41 @@
+#include "audio_source.h"
+
+#include <algorithm>
+#include <cstring>
+
+FileAudioSource::FileAudioSource(std::shared_ptr<const MappedAudioFile> file,
+                                 int sample_rate, bool loop)
+    : file_(file),
+      sample_rate_(sample_rate),
+      loop_(loop),
+      offset_(0),
+      bytes_read_(0),
+      started_(false),
+      pacer_(1.0) {}
+
+bool FileAudioSource::Read(uint8_t* buf, std::size_t size) {
+    if (!file_ || file_->payload_size() == 0 || sample_rate_ <= 0) return false;
+
+    const uint8_t* audio = file_->payload();
+    const std::size_t audio_size = file_->payload_size();
+    std::size_t filled = 0;
+    while (filled < size) {
+        if (offset_ >= audio_size) {
+            if (!loop_) return false;
+            offset_ = 0;
+        }
+        std::size_t n = std::min(size - filled, audio_size - offset_);
+        std::memcpy(buf + filled, audio + offset_, n);
+        filled += n;
+        offset_ += n;
+    }
+
+    // Deliver the frame once its last sample would have been captured.
+    if (!started_) {
+        pacer_.Start();
+        started_ = true;
+    }
+    bytes_read_ += size;
+    pacer_.WaitUntil(AudioPacer::BytesToNanos(bytes_read_, static_cast<uint64_t>(sample_rate_) * 2));
+    return true;
+}
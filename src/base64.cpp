@@ -0,0 +1,137 @@
+#include "base64.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CONV_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#ifdef CONV_BASE64_X86
+
+// 12 input bytes (at 0..11) -> 16 indices; bytes of each 3-byte group are
+// laid out as [b1 b0 b2 b1] in a 32-bit lane.
+__attribute__((target("ssse3")))
+inline __m128i Reshuffle(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+// 6-bit indices -> ASCII: pick the offset for each index range with pshufb.
+__attribute__((target("ssse3")))
+inline __m128i Translate(__m128i indices) {
+    const __m128i shift_lut = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, range), indices);
+}
+
+__attribute__((target("ssse3")))
+void EncodeSsse3(const uint8_t* in, std::size_t n, char* out) {
+    std::size_t i = 0;
+    // Each step loads 16 bytes and consumes 12.
+    for (; i + 16 <= n; i += 12, out += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), Translate(Reshuffle(v)));
+    }
+    Base64EncodeScalar(in + i, n - i, out);
+}
+
+__attribute__((target("avx2")))
+inline __m256i Reshuffle256(__m256i in) {
+    in = _mm256_shuffle_epi8(in, _mm256_set_epi8(
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(t1, t3);
+}
+
+__attribute__((target("avx2")))
+inline __m256i Translate256(__m256i indices) {
+    const __m256i shift_lut = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, range), indices);
+}
+
+__attribute__((target("avx2")))
+void EncodeAvx2(const uint8_t* in, std::size_t n, char* out) {
+    std::size_t i = 0;
+    // Two 16-byte loads, 12 bytes used from each lane (reads up to i + 28).
+    for (; i + 28 <= n; i += 24, out += 32) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), Translate256(Reshuffle256(v)));
+    }
+    EncodeSsse3(in + i, n - i, out);
+}
+
+#endif  // CONV_BASE64_X86
+
+typedef void (*EncodeFn)(const uint8_t*, std::size_t, char*);
+
+struct Backend {
+    EncodeFn fn;
+    const char* name;
+};
+
+Backend Detect() {
+#ifdef CONV_BASE64_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Backend{&EncodeAvx2, "avx2"};
+    if (__builtin_cpu_supports("ssse3")) return Backend{&EncodeSsse3, "ssse3"};
+#endif
+    return Backend{&Base64EncodeScalar, "scalar"};
+}
+
+const Backend& Selected() {
+    static const Backend backend = Detect();
+    return backend;
+}
+
+}  // namespace
+
+void Base64EncodeScalar(const uint8_t* in, std::size_t n, char* out) {
+    std::size_t i = 0;
+    for (; i + 3 <= n; i += 3, out += 4) {
+        uint32_t v = (uint32_t(in[i]) << 16) | (uint32_t(in[i + 1]) << 8) | in[i + 2];
+        out[0] = kAlphabet[(v >> 18) & 0x3f];
+        out[1] = kAlphabet[(v >> 12) & 0x3f];
+        out[2] = kAlphabet[(v >> 6) & 0x3f];
+        out[3] = kAlphabet[v & 0x3f];
+    }
+    if (i < n) {
+        uint32_t v = uint32_t(in[i]) << 16;
+        if (i + 1 < n) v |= uint32_t(in[i + 1]) << 8;
+        out[0] = kAlphabet[(v >> 18) & 0x3f];
+        out[1] = kAlphabet[(v >> 12) & 0x3f];
+        out[2] = i + 1 < n ? kAlphabet[(v >> 6) & 0x3f] : '=';
+        out[3] = '=';
+    }
+}
+
+void Base64Encode(const uint8_t* in, std::size_t n, char* out) {
+    Selected().fn(in, n, out);
+}
+
+const char* Base64Backend() {
+    return Selected().name;
+}
@@ -0,0 +1,278 @@
+#include "batch_runner.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "async_log.h"
+#include "audio_pacer.h"
+#include "conversation_handler.h"
+#include "mapped_audio.h"
+#include "sys_util.h"
+#include "json/json.h"
+
+using namespace convsdk;
+
+namespace {
+
+const int kDefaultRoundTimeoutMs = 60000;
+// A refused request is retried if a fresh IDLE (e.g. after a reconnect)
+// shows up within this time.
+const int kRefusedRetryMs = 500;
+const int kMaxRoundRetries = 2;
+// Uplink format used by send_audio_round.
+const int kUplinkSampleRate = 16000;
+
+std::string DirName(const std::string& path) {
+    std::string::size_type slash = path.rfind('/');
+    return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+}
+
+std::string Resolve(const std::string& base_dir, const std::string& path) {
+    if (path.empty() || path[0] == '/') return path;
+    return base_dir + "/" + path;
+}
+
+}  // namespace
+
+void BatchRunner::Report::Reset() {
+    rounds = 0;
+    failed = 0;
+    local = 0;
+    timeouts = 0;
+    wall_us = 0;
+    audio_us = 0;
+    downlink_bytes = 0;
+    for (int i = 0; i < kNumJobTypes; ++i) round_us[i].Reset();
+}
+
+void BatchRunner::Report::Merge(const Report& other) {
+    rounds += other.rounds;
+    failed += other.failed;
+    local += other.local;
+    timeouts += other.timeouts;
+    if (other.wall_us > wall_us) wall_us = other.wall_us;
+    audio_us += other.audio_us;
+    downlink_bytes += other.downlink_bytes;
+    for (int i = 0; i < kNumJobTypes; ++i) round_us[i].Merge(other.round_us[i]);
+}
+
+BatchRunner::BatchRunner()
+    : round_timeout_ms_(kDefaultRoundTimeoutMs),
+      local_next_round_(0),
+      next_round_(&local_next_round_) {}
+
+const char* BatchRunner::JobTypeName(JobType type) {
+    static const char* kNames[kNumJobTypes] = {"audio", "tts", "vqa"};
+    return type >= 0 && type < kNumJobTypes ? kNames[type] : "unknown";
+}
+
+bool BatchRunner::Load(const std::string& manifest_path, std::string* error) {
+    std::ifstream in(manifest_path.c_str());
+    if (!in) {
+        if (error) *error = "cannot open " + manifest_path;
+        return false;
+    }
+    Json::CharReaderBuilder builder;
+    Json::Value root;
+    std::string errs;
+    if (!Json::parseFromStream(builder, in, &root, &errs) || !root.isObject()) {
+        if (error) *error = "invalid manifest " + manifest_path + ": " + errs;
+        return false;
+    }
+
+    if (root.isMember("concurrency") && root["concurrency"].isInt() && root["concurrency"].asInt() > 1) {
+        std::cout << "batch: concurrency " << root["concurrency"].asInt()
+                  << " clamped to 1 per process (one conversation each; use --workers)" << std::endl;
+    }
+    if (root.isMember("round_timeout_ms") && root["round_timeout_ms"].isInt()) {
+        round_timeout_ms_ = root["round_timeout_ms"].asInt();
+        if (round_timeout_ms_ <= 0) round_timeout_ms_ = kDefaultRoundTimeoutMs;
+    }
+
+    const Json::Value& jobs = root["jobs"];
+    if (!jobs.isArray() || jobs.empty()) {
+        if (error) *error = manifest_path + ": \"jobs\" must be a non-empty array";
+        return false;
+    }
+    const std::string base_dir = DirName(manifest_path);
+    jobs_.clear();
+    round_jobs_.clear();
+    for (Json::ArrayIndex i = 0; i < jobs.size(); ++i) {
+        const Json::Value& item = jobs[i];
+        const std::string where = manifest_path + ": job " + std::to_string(i);
+        Job job;
+        job.repeat = item.isMember("repeat") && item["repeat"].isInt() ? item["repeat"].asInt() : 1;
+        job.audio_us = 0;
+        if (job.repeat < 0) job.repeat = 0;
+
+        std::string type = item["type"].asString();
+        if (type == "audio") {
+            job.type = kJobAudio;
+            job.arg = Resolve(base_dir, item["path"].asString());
+            std::shared_ptr<const MappedAudioFile> file = MappedAudioFile::Open(job.arg, error);
+            if (!file) return false;
+            if (file->is_wav() && (file->sample_rate() != kUplinkSampleRate || file->channels() != 1)) {
+                if (error) *error = where + ": " + job.arg + " must be 16 kHz mono";
+                return false;
+            }
+            job.audio_us = AudioPacer::BytesToNanos(file->payload_size(), kUplinkSampleRate * 2) / 1000;
+        } else if (type == "tts") {
+            job.type = kJobTts;
+            job.arg = item["text"].asString();
+            if (job.arg.empty()) {
+                if (error) *error = where + ": tts job needs \"text\"";
+                return false;
+            }
+        } else if (type == "vqa") {
+            job.type = kJobVqa;
+            job.arg = Resolve(base_dir, item["image"].asString());
+            std::ifstream image(job.arg.c_str());
+            if (!image) {
+                if (error) *error = where + ": cannot open " + job.arg;
+                return false;
+            }
+        } else {
+            if (error) *error = where + ": unknown type \"" + type + "\"";
+            return false;
+        }
+        jobs_.push_back(job);
+        round_jobs_.insert(round_jobs_.end(), job.repeat, static_cast<uint32_t>(jobs_.size() - 1));
+    }
+    return true;
+}
+
+void BatchRunner::CollectAssets(std::vector<std::string>* audio, std::vector<std::string>* images) const {
+    for (std::size_t i = 0; i < jobs_.size(); ++i) {
+        if (jobs_[i].repeat == 0) continue;
+        std::vector<std::string>* list = jobs_[i].type == kJobAudio ? audio : jobs_[i].type == kJobVqa ? images : NULL;
+        if (list && std::find(list->begin(), list->end(), jobs_[i].arg) == list->end()) {
+            list->push_back(jobs_[i].arg);
+        }
+    }
+}
+
+bool BatchRunner::Issue(const Job& job, uint64_t idle_seq, bool* done) {
+    *done = false;
+    switch (job.type) {
+    case kJobAudio:
+        return send_audio_round(job.arg, idle_seq);
+    case kJobTts: {
+        // Sentence-split job; it returns once every segment is back to IDLE.
+        uint64_t id = g_tts_queue.Submit(job.arg);
+        if (!id) return false;
+        *done = g_tts_queue.Wait(id, NULL);
+        return *done;
+    }
+    case kJobVqa:
+        return vqa_send_request(job.arg, done);
+    default:
+        return false;
+    }
+}
+
+bool BatchRunner::Run() {
+    report_.Reset();
+    if (!conversation) return false;
+
+    uint64_t idle_seq = 0;
+    if (!g_dialog_state.WaitFor(kDialogIdle, round_timeout_ms_, 0, &idle_seq)) {
+        LOGE("batch: dialog never reached IDLE");
+        report_.timeouts++;
+        return false;
+    }
+
+    const uint64_t downlink_start = g_round_tracer.DownlinkBytes();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (;;) {
+        uint64_t round = next_round_->fetch_add(1);
+        if (round >= round_jobs_.size()) break;
+        const Job& job = jobs_[round_jobs_[round]];
+
+        std::chrono::steady_clock::time_point round_start;
+        bool issued = false;
+        bool done = false;
+        for (int attempt = 0;; ++attempt) {
+            round_start = std::chrono::steady_clock::now();
+            issued = Issue(job, idle_seq, &done);
+            if (issued || attempt >= kMaxRoundRetries) break;
+            uint64_t fresh_seq = 0;
+            if (!WaitForFreshIdle(idle_seq, &fresh_seq)) break;
+            idle_seq = fresh_seq;
+        }
+        if (done) {
+            // Completed by the call itself (TTS queue, or a VQA answer from
+            // the cache); continue from the IDLE period the dialog is in now.
+            report_.round_us[job.type].Record(ElapsedUs(round_start));
+            report_.rounds++;
+            report_.audio_us += job.audio_us;
+            if (job.type == kJobVqa) report_.local++;
+            if (!g_dialog_state.WaitFor(kDialogIdle, round_timeout_ms_, 0, &idle_seq)) {
+                report_.timeouts++;
+                break;
+            }
+            continue;
+        }
+        // A refused request may leave the dialog in the same IDLE period,
+        // so the gate then accepts the current entry again.
+        uint64_t after = issued ? idle_seq : idle_seq - 1;
+        if (!g_dialog_state.WaitFor(kDialogIdle, round_timeout_ms_, after, &idle_seq)) {
+            LOGE("batch: %s round %llu did not return to IDLE within %d ms",
+                 JobTypeName(job.type), (unsigned long long)round, round_timeout_ms_);
+            report_.timeouts++;
+            break;
+        }
+        if (!issued) {
+            report_.failed++;
+            continue;
+        }
+        report_.round_us[job.type].Record(ElapsedUs(round_start));
+        report_.rounds++;
+        report_.audio_us += job.audio_us;
+    }
+    report_.wall_us = ElapsedUs(start);
+    report_.downlink_bytes = g_round_tracer.DownlinkBytes() - downlink_start;
+    return report_.timeouts == 0;
+}
+
+bool BatchRunner::WaitForFreshIdle(uint64_t after_seq, uint64_t* seq) {
+    if (g_dialog_state.WaitFor(kDialogIdle, kRefusedRetryMs, after_seq, seq)) return true;
+    // Keep waiting while the connection manager is still reconnecting.
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(round_timeout_ms_);
+    while (g_connection.reconnecting() && std::chrono::steady_clock::now() < deadline) {
+        if (g_dialog_state.WaitFor(kDialogIdle, kRefusedRetryMs, after_seq, seq)) return true;
+    }
+    return false;
+}
+
+void BatchRunner::PrintReport(std::ostream& os, const Report& r) {
+    double wall_s = r.wall_us / 1e6;
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(2);
+    os << "batch: " << r.rounds << " rounds";
+    if (r.local) os << " (" << r.local << " answered from cache)";
+    os << ", " << r.failed << " failed"
+       << (r.timeouts ? ", stopped on timeout" : "") << ", " << wall_s << " s" << std::endl;
+    if (wall_s > 0) {
+        os << "  rounds/s " << r.rounds / wall_s
+           << ", audio uploaded " << r.audio_us / 1e6 / wall_s << " s per wall s"
+           << ", downlink " << static_cast<uint64_t>(r.downlink_bytes / wall_s) << " bytes/s" << std::endl;
+    }
+    os << std::setprecision(1);
+    for (int i = 0; i < kNumJobTypes; ++i) {
+        const LatencyHistogram& h = r.round_us[i];
+        if (h.Count() == 0) continue;
+        os << "  round " << std::left << std::setw(6) << JobTypeName(static_cast<JobType>(i)) << std::right
+           << " n=" << h.Count()
+           << " p50=" << h.Percentile(50) / 1000.0
+           << " p90=" << h.Percentile(90) / 1000.0
+           << " p99=" << h.Percentile(99) / 1000.0
+           << " max=" << h.Max() / 1000.0 << " ms" << std::endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
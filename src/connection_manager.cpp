@@ -0,0 +1,209 @@
+#include "connection_manager.h"
+
+#include <chrono>
+#include <iomanip>
+
+#include "async_log.h"
+#include "conversation_handler.h"
+#include "sys_util.h"
+
+using namespace convsdk;
+
+namespace {
+
+// Keeps base << (attempt - 1) well inside an int.
+const int kMaxBackoffShift = 16;
+
+}  // namespace
+
+ConnectionManager::ConnectionManager() : ConnectionManager(Options()) {}
+
+ConnectionManager::ConnectionManager(const Options& options)
+    : options_(options),
+      stopping_(false),
+      lost_(false),
+      reconnecting_(false),
+      rng_(std::random_device()()) {}
+
+ConnectionManager::~ConnectionManager() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+ConvRetCode ConnectionManager::Connect() {
+    if (!conversation) {
+        conversation = Conversation::CreateConversation(onMessage, onEtMessage, NULL);
+        if (!conversation) return kNotCreateConversation;
+    }
+    ConvRetCode ret = ConnectOnce(options_.resume_dialog ? dialog_id() : std::string());
+    if (ret != kSuccess) {
+        conversation->DestroyConversation();
+        conversation = NULL;
+        return ret;
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!thread_.joinable() && !stopping_) {
+        thread_ = std::thread(&ConnectionManager::ReconnectMain, this);
+    }
+    return ret;
+}
+
+ConvRetCode ConnectionManager::ConnectOnce(const std::string& dialog_id) {
+    std::string params = gen_init_params(dialog_id);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ConvRetCode ret = conversation->Connect(params.c_str());
+    uint64_t us = ElapsedUs(start);
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (ret == kSuccess) {
+        stats_.connects++;
+        connect_us_.Record(us);
+    } else {
+        stats_.connect_failures++;
+    }
+    return ret;
+}
+
+ConvRetCode ConnectionManager::Shutdown() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+
+    if (!conversation) return kNotConnected;
+    ConvRetCode ret = conversation->Disconnect();
+    conversation->DestroyConversation();
+    conversation = NULL;
+    return ret;
+}
+
+void ConnectionManager::OnConnectionLost(const std::string& reason) {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        // Not managed yet (startup, replay) or already handling this outage.
+        if (stopping_ || !thread_.joinable() || lost_ || reconnecting_.load()) return;
+        lost_ = true;
+        reconnecting_.store(true);
+        loss_reason_ = reason;
+        stats_.losses++;
+    }
+    // IDLE-gated callers must wait for the new connection.
+    g_dialog_state.OnStateChanged(DialogStateMonitor::kStateUnknown);
+    cv_.notify_all();
+}
+
+void ConnectionManager::NoteDialogId(const std::string& dialog_id) {
+    if (dialog_id.empty()) return;
+    std::lock_guard<std::mutex> guard(lock_);
+    if (dialog_id_ != dialog_id) dialog_id_ = dialog_id;
+}
+
+std::string ConnectionManager::dialog_id() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return dialog_id_;
+}
+
+void ConnectionManager::ReconnectMain() {
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;) {
+        cv_.wait(guard, [this]() { return stopping_ || lost_; });
+        if (stopping_) return;
+        guard.unlock();
+        Reconnect();
+        guard.lock();
+        lost_ = false;
+        reconnecting_.store(false);
+    }
+}
+
+bool ConnectionManager::Reconnect() {
+    std::chrono::steady_clock::time_point lost_at = std::chrono::steady_clock::now();
+    std::string reason;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        reason = loss_reason_;
+    }
+    LOGW("connection lost (%s), reconnecting", reason.c_str());
+
+    for (int attempt = 1; options_.max_attempts == 0 || attempt <= options_.max_attempts; ++attempt) {
+        int delay_ms = BackoffMs(attempt);
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            if (cv_.wait_for(guard, std::chrono::milliseconds(delay_ms), [this]() { return stopping_; })) {
+                return false;
+            }
+        }
+
+        conversation->Disconnect();
+        std::string resume_id = options_.resume_dialog ? dialog_id() : std::string();
+        ConvRetCode ret = ConnectOnce(resume_id);
+        if (ret == kSuccess) {
+            uint64_t outage_ms = ElapsedUs(lost_at) / 1000;
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                stats_.reconnects++;
+                if (outage_ms > stats_.max_outage_ms) stats_.max_outage_ms = outage_ms;
+            }
+            LOGI("reconnected after %d attempt(s), %llu ms without connection, dialog %s",
+                 attempt, (unsigned long long)outage_ms,
+                 resume_id.empty() ? "(new)" : resume_id.c_str());
+            return true;
+        }
+        LOGW("reconnect attempt %d failed (ret=%d, waited %d ms)", attempt, ret, delay_ms);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stats_.gave_up++;
+    }
+    LOGE("giving up reconnecting after %d attempts", options_.max_attempts);
+    return false;
+}
+
+int ConnectionManager::BackoffMs(int attempt) {
+    int shift = attempt - 1;
+    if (shift > kMaxBackoffShift) shift = kMaxBackoffShift;
+    long long backoff = static_cast<long long>(options_.base_backoff_ms) << shift;
+    if (backoff > options_.max_backoff_ms) backoff = options_.max_backoff_ms;
+    int half = static_cast<int>(backoff / 2);
+
+    std::lock_guard<std::mutex> guard(lock_);
+    std::uniform_int_distribution<int> dist(0, half > 0 ? half : 0);
+    return half + dist(rng_);
+}
+
+ConnectionManager::Stats ConnectionManager::GetStats() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return stats_;
+}
+
+LatencyHistogram ConnectionManager::ConnectLatency() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return connect_us_;
+}
+
+void ConnectionManager::PrintStats(std::ostream& os) const {
+    Stats st = GetStats();
+    LatencyHistogram h = ConnectLatency();
+    os << "connection: " << st.connects << " connects, " << st.connect_failures << " failed, "
+       << st.losses << " lost, " << st.reconnects << " reconnected, " << st.gave_up
+       << " gave up, max outage " << st.max_outage_ms << " ms" << std::endl;
+    if (h.Count() == 0) return;
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+    os << "  connect latency      n=" << h.Count()
+       << " p50=" << h.Percentile(50) / 1000.0
+       << " p90=" << h.Percentile(90) / 1000.0
+       << " p99=" << h.Percentile(99) / 1000.0
+       << " max=" << h.Max() / 1000.0 << " ms" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
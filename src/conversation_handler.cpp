@@ -1,101 +1,299 @@
 #include "conversation_handler.h"
 #include "audio_handler.h"
+#include "async_log.h"
 
+#include <cerrno>
 #include <chrono>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <thread>
+#include <unistd.h>
 
-#include "json/json.h"
+#include "base64.h"
+#include "content_hash.h"
+#include "json_writer.h"
+#include "response_fields.h"
 
 using namespace convsdk;
 
+namespace {
+// Upper bound for the LISTENING wait after StartHumanSpeech.
+const int kListeningWaitMs = 300;
+
+// Request templates. Keys are in the order jsoncpp wrote them (sorted), so
+// the bodies are byte-identical to the former Json::Value output; only the
+// strings in between are escaped per request.
+const char kTranscriptRequestHead[] = "{\"text\":";
+const char kTranscriptRequestTail[] = ",\"type\":\"transcript\"}";
+
+// Prompt request with one inline image: the base64 goes between head and
+// tail. The base64 alphabet needs no escaping.
+const char kPromptRequestHead[] =
+    "{\"parameters\":{\"biz_params\":{\"user_defined_params\":{}},"
+    "\"images\":[{\"type\":\"base64\",\"value\":\"";
+const char kVqaPrompt[] = "你帮我看看图片里面是啥呗";
+
+std::string BuildPromptRequestTail(const char* prompt) {
+    std::string tail = "\"}]},\"text\":";
+    JsonAppendQuoted(&tail, prompt, std::strlen(prompt));
+    tail += ",\"type\":\"prompt\"}";
+    return tail;
+}
+
+const std::string& VqaRequestTail() {
+    static const std::string tail = BuildPromptRequestTail(kVqaPrompt);
+    return tail;
+}
+
+// Detail events are handled on the control lane only, so this is reused
+// without locking.
+ResponseFields detail_fields;
+
+// Store the text of a detail event and log only what it changed. Returns
+// the extracted fields, or NULL if the response is malformed.
+const ResponseFields* RecordTranscriptDetail(TranscriptStore::Speaker speaker, const char* who,
+                                             const EventRecord& record) {
+    if (!ExtractResponseFields(record.response, &detail_fields)) {
+        LOGW("%s detail: malformed response: %s", who, record.response.c_str());
+        return NULL;
+    }
+    if (!detail_fields.has_text) return &detail_fields;
+    const std::string& round_id = detail_fields.round_id.empty() ? record.round_id : detail_fields.round_id;
+    TranscriptStore::Change change =
+        g_transcripts.Update(speaker, record.dialog_id, round_id, detail_fields.text, detail_fields.finished);
+    if (change.empty() && !change.finished) return &detail_fields;
+    const char* mark = change.finished ? " [finished]" : "";
+    if (change.kept == 0 && change.dropped == 0) {
+        // First text of the round (earlier details may have been empty).
+        LOGI("%s [%s]: %.*s%s", who, round_id.c_str(), static_cast<int>(change.size), change.data, mark);
+    } else if (change.dropped > 0) {
+        LOGI("%s revised at %zu: %.*s%s", who, change.kept, static_cast<int>(change.size), change.data, mark);
+    } else {
+        LOGI("%s +%.*s%s", who, static_cast<int>(change.size), change.data, mark);
+    }
+    return &detail_fields;
+}
+
+// Read-only mapping of a VQA image.
+class ImageMapping {
+ public:
+    ImageMapping() : data_(NULL), size_(0) {}
+    ~ImageMapping() {
+        if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    ImageMapping(const ImageMapping&) = delete;
+    ImageMapping& operator=(const ImageMapping&) = delete;
+
+    bool Open(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            LOGE("VQA image %s: %s", path.c_str(), strerror(errno));
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            LOGE("VQA image %s is not a regular file", path.c_str());
+            close(fd);
+            return false;
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ > 0) {
+            void* addr = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                LOGE("VQA image %s: mmap: %s", path.c_str(), strerror(errno));
+                close(fd);
+                return false;
+            }
+            madvise(addr, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const uint8_t*>(addr);
+        }
+        close(fd);
+        return true;
+    }
+
+    const uint8_t* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+ private:
+    const uint8_t* data_;
+    std::size_t size_;
+};
+
+// Encode the image straight into the request body: the image bytes are
+// read once from the page cache and written once, as base64.
+std::shared_ptr<const std::string> BuildVqaRequest(const ImageMapping& image) {
+    const std::string& tail = VqaRequestTail();
+    const std::size_t head = sizeof(kPromptRequestHead) - 1;
+    const std::size_t encoded = Base64EncodedSize(image.size());
+    std::shared_ptr<std::string> body = std::make_shared<std::string>();
+    body->resize(head + encoded + tail.size());
+    char* out = &(*body)[0];
+    std::memcpy(out, kPromptRequestHead, head);
+    if (image.size() > 0) Base64Encode(image.data(), image.size(), out + head);
+    std::memcpy(out + head + encoded, tail.data(), tail.size());
+    return body;
+}
+
+// Cache key: the image content, seeded with the rest of the request (the
+// prompt), so the same frame asked a different question is a new entry.
+uint64_t VqaCacheKey(const ImageMapping& image) {
+    static const uint64_t seed = ContentHash64(VqaRequestTail().data(), VqaRequestTail().size());
+    return ContentHash64(image.data(), image.size(), seed);
+}
+
+// Request body for `image_path`, from g_vqa_cache when the same content was
+// sent (or preloaded) before. Fills `key` when the cache is enabled and
+// `answer` when a cached answer may be served instead of a round trip.
+std::shared_ptr<const std::string> VqaRequestFor(const std::string& image_path, bool* cached,
+                                                 uint64_t* key, std::string* answer) {
+    ImageMapping image;
+    if (!image.Open(image_path)) return std::shared_ptr<const std::string>();
+    *cached = g_vqa_cache.enabled();
+    if (!*cached) return BuildVqaRequest(image);
+
+    *key = VqaCacheKey(image);
+    std::shared_ptr<const std::string> body = g_vqa_cache.Lookup(*key, answer);
+    if (body) return body;
+    body = BuildVqaRequest(image);
+    g_vqa_cache.Insert(*key, body);
+    return body;
+}
+}
+
 /**
  * @brief 语音对话初始化回调函数
+ * 运行在SDK内部回调线程上：只复制事件并投递给分发线程，不做任何I/O。
  */
 void onMessage(ConvEvent *event, void *param)
 {
-    ConvEvent::ConvEventType event_type = event->GetMsgType();
-    //Conversation* conversation = static_cast<Conversation *>(param);
-    int dialog_state = event->GetDialogStateChanged();
+    if (!event) return;
+    if (g_event_log) g_event_log->Append(event);
+    if (g_event_dispatcher.Post(event)) return;
+
+    // Full, or stopping while workers drain: drop rather than run ahead of
+    // queued events (counted in the dispatcher's rejected stats).
+    if (!g_event_dispatcher.stopped()) {
+        LOGW("onMessage: dispatcher full, dropped event type %d", event->GetMsgType());
+        return;
+    }
+    // Dispatcher not started yet or already stopped: no worker is running
+    // handlers, so handle inline.
+    EventRecord record;
+    record.CopyFrom(event);
+    HandleEventRecord(record);
+}
+
+/**
+ * @brief 事件处理函数，在EventDispatcher的工作线程上执行
+ */
+void HandleEventRecord(EventRecord& record)
+{
+    ConvEvent::ConvEventType event_type = record.type;
 
     // if (event_type != ConvEvent::kSoundLevel &&
     //     event_type != ConvEvent::kBinary)
     // {
     //     std::cout << "trigger onMessage -->>\n"
-    //               << "  session id: " << event->GetSessionId() << "\n"
-    //               << "  messge type: " << event->GetMsgTypeString() << "\n"
-    //               << "  dialog state: " << dialog_state << "\n"
-    //               << "  response: " << event->GetAllResponse() << std::endl;
+    //               << "  session id: " << record.session_id << "\n"
+    //               << "  messge type: " << event_type << "\n"
+    //               << "  dialog state: " << record.dialog_state << "\n"
+    //               << "  response: " << record.response << std::endl;
     // }
 
     switch (event_type)
     {
     case ConvEvent::kConversationFailed:
-        // 对话发生错误
+        // 对话发生错误; terminate 表示连接已不可用，需要重连
+        LOGE("对话发生错误: status=%d, terminate=%d, %s", record.status_code, record.terminate ? 1 : 0,
+             record.response.c_str());
+        if (record.terminate) {
+            g_vqa_cache.AbortRound();
+            g_connection.OnConnectionLost("conversation failed");
+        }
+        break;
+    case ConvEvent::kConnectionDisconnected:
+        // 连接断开，交给连接管理器重连；未完成的回答不进缓存
+        g_vqa_cache.AbortRound();
+        g_connection.OnConnectionLost("connection disconnected");
         break;
     case ConvEvent::kConversationStarted:{
-        // 对话建连成功
-        std::cout<<"对话已开始!!!!!!!!!!!!!!!!!!!!!" << std::endl;
+        // 对话建连成功, 记录dialog_id以便重连后继续该对话
+        g_connection.NoteDialogId(record.dialog_id);
+        LOGI("对话已开始!!!!!!!!!!!!!!!!!!!!!");
         break;
     }
     case ConvEvent::kConversationCompleted:
         // 对话完成
-        std::cout<<"对话已完成!!!!!!!!!!!!!!!!!!!!!" << std::endl;
+        LOGI("对话已完成!!!!!!!!!!!!!!!!!!!!!");
         break;
     case ConvEvent::kSentenceBegin:{
         // 检测到用户开始说话, 这里可以启动录音采集音频
-        std::cout<<"收到SentenceBegin事件，用户开始说话。" << std::endl;
+        LOGI("收到SentenceBegin事件，用户开始说话。");
         break;
 
     }
     case ConvEvent::kSentenceEnd:
         // 检测到用户说话结束, 这里可以停止录音采集音频
-        std::cout<<"收到SentenceEnd事件，用户结束说话。" << std::endl;
-        //can_send_audio = true;
+        LOGI("收到SentenceEnd事件，用户结束说话。");
+        g_round_tracer.Mark(RoundTracer::kTraceSentenceEnd, record.round_id, record.dialog_id, record.received_at);
         break;
     case ConvEvent::kDataOutputStarted:
         // 后续将接收语音合成数据, 这里可启动播放器。
         // 播放器启动后需要通知SDK
-        std::cout<<"收到DataOutputStarted事件，通知SDK播放器已启动播放。" << std::endl;
-        conversation -> SetAction(kPlayerStarted);
+        LOGI("收到DataOutputStarted事件，通知SDK播放器已启动播放。");
+        g_round_tracer.Mark(RoundTracer::kTraceOutputStarted, record.round_id, record.dialog_id, record.received_at);
+        if (conversation) conversation -> SetAction(kPlayerStarted);
         break;
     case ConvEvent::kDataOutputCompleted:
         // 接收语音合成数据完成, 这里需要通知播放器已经送完数据。
         // 注意, 这里只是接收完语音合成数据, 而非播放完成, 缓存或播放器中还有大量数据待播放。
         // 完全播放完后必须通知SDK
-        std::cout<<"收到DataOutputCompleted事件，通知SDK播放器已完成播放。" << std::endl;
-        conversation -> SetAction(kPlayerStopped);
+        LOGI("收到DataOutputCompleted事件，通知SDK播放器已完成播放。");
+        g_round_tracer.Mark(RoundTracer::kTraceOutputCompleted, record.round_id, record.dialog_id, record.received_at);
+        if (conversation) conversation -> SetAction(kPlayerStopped);
         break;
     case ConvEvent::kBinary:{
-        int n = event->GetBinaryDataSize();
-        std::cout << "RECEIVE RESPONSE trigger onMessage -->> kBinary, session: " << event->GetSessionId()
-                    << ", bytes=" << n << std::endl;
-        // 保存下发的二进制音频（例如 TTS 音频）到本地，便于播放/调试
-        SaveBinaryEventToFile(event);
+        LOGD("RECEIVE RESPONSE trigger onMessage -->> kBinary, session: %s, bytes=%zu",
+             record.session_id.c_str(), record.binary.size());
+        g_round_tracer.AddDownlink(record.binary.size(), record.round_id, record.dialog_id, record.received_at);
+        // 保存下发的二进制音频（例如 TTS 音频）到本地，便于播放/调试；
+        // TTS队列任务的音频按分句顺序写入该任务自己的文件
+        if (!g_tts_queue.OnAudio(record)) SaveBinaryToFile(record.session_id, record.binary);
         break;
     }
     case ConvEvent::kSoundLevel:
         break;
     case ConvEvent::kDialogStateChanged:{
         // 可通过对话状态进行相关业务逻辑操作
-        int state = event->GetDialogStateChanged();
-        std::cout << "Dialog state changed to :::: " << state << std::endl;
+        int state = record.dialog_state;
+        // 本轮结束：先把回答记入VQA缓存、记下IDLE时间点，再唤醒可能立即发起下一轮的线程
+        if (state == kDialogIdle) {
+            g_vqa_cache.EndRound();
+            g_round_tracer.Mark(RoundTracer::kTraceIdle, record.round_id, record.dialog_id, record.received_at);
+        }
+        // 唤醒等待该状态的线程（如 trigger_audio_send_once）
+        g_dialog_state.OnStateChanged(state);
+        LOGI("Dialog state changed to :::: %d", state);
         switch (state)
         {
         case 0:
             /* code */
-            std::cout << "Dialog State: IDLE" << std::endl;
-            // allow sending audio now
-            can_send_audio.store(true);
+            LOGI("Dialog State: IDLE");
             break;
         case 1:
-            std::cout << "Dialog State: LISTENING" << std::endl;
+            LOGI("Dialog State: LISTENING");
             break;
         case 2:
-            std::cout << "Dialog State: RESPONDING" << std::endl;
+            LOGI("Dialog State: RESPONDING");
             break;
         case 3:
-            std::cout << "Dialog State: THINKING" << std::endl;
+            LOGI("Dialog State: THINKING");
+            g_round_tracer.Mark(RoundTracer::kTraceThinking, record.round_id, record.dialog_id, record.received_at);
             break;
         default:
             break;
@@ -113,18 +311,24 @@ void onMessage(ConvEvent *event, void *param)
     case ConvEvent::kVoiceInterruptDenied:
         break;
     case ConvEvent::kHumanSpeakingDetail:
+        LOGD("Human Speaking Detail: %s", record.response.c_str());
+        RecordTranscriptDetail(TranscriptStore::kSpeakerUser, "User", record);
         break;
-    case ConvEvent::kRespondingDetail:
-        std::cout << "Responding Detail: " << event->GetAllResponse() << std::endl;
+    case ConvEvent::kRespondingDetail:{
+        LOGD("Responding Detail: %s", record.response.c_str());
+        const ResponseFields* fields =
+            RecordTranscriptDetail(TranscriptStore::kSpeakerAssistant, "Responding", record);
+        if (fields && fields->has_text) g_vqa_cache.OnResponseDetail(fields->text);
         break;
     }
+    }
 }
 /**
  * @brief SDK日志回调函数
  */
 void onEtMessage(ConvLogLevel level, const char *log, void *user_data)
 {
-    std::cout << " ==>> [" << level << "] " << log << std::endl;
+    CONV_LOG(level, " ==>> [%d] %s", level, log ? log : "");
 }
 
 /**
@@ -137,178 +341,265 @@ void onEtMessage(ConvLogLevel level, const char *log, void *user_data)
 void trigger_audio_send_once(const std::string& audio_file_path)
 {
     if (!conversation) {
-        std::cerr << "Conversation not ready, cannot send audio." << std::endl;
+        LOGE("Conversation not ready, cannot send audio.");
         return;
     }
 
     static std::atomic<bool> is_sending{false};
     bool expected = false;
     if (!is_sending.compare_exchange_strong(expected, true)) {
-        std::cout << "Audio send already in progress." << std::endl;
+        LOGI("Audio send already in progress.");
         return;
     }
 
     std::thread audioSendThread([audio_file_path]() {
-        // 等待 DialogStateChanged -> IDLE 的许可
-        while (!can_send_audio.load()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
-
-        // Prevent overlapping sends until next IDLE.
-        can_send_audio.store(false);
-
-        ConvRetCode start_ret = conversation->SetAction(kStartHumanSpeech);
-        std::cout << "SetAction StartHumanSpeech ret=" << start_ret << std::endl;
-        if (start_ret != kSuccess) {
-            std::cerr << "StartHumanSpeech failed (ret=" << start_ret << "), skip sending audio." << std::endl;
-            is_sending.store(false);
-            return;
-        }
-
-        // Give the SDK a brief moment to switch state before pushing audio.
-        std::this_thread::sleep_for(std::chrono::milliseconds(300));
-
-        bool success = SendAudioFile(
-            conversation,
-            audio_file_path,
-            "pcm",
-            16000,
-            640,
-            false
-        );
-        ConvRetCode stop_ret = conversation->SetAction(kStopHumanSpeech);
-        std::cout << "SetAction StopHumanSpeech ret=" << stop_ret << std::endl;
-
-        if (success) {
-            std::cout << "✅ 音频流发送线程完成" << std::endl;
-        } else {
-            std::cerr << "❌ 音频流发送失败" << std::endl;
-        }
-
+        // 等待 DialogStateChanged -> IDLE 的许可。
+        // Each IDLE period is used for one round only: wait for an IDLE entry
+        // newer than the one the previous send consumed.
+        static uint64_t consumed_idle_seq = 0;
+        uint64_t idle_seq = 0;
+        g_dialog_state.WaitFor(kDialogIdle, -1, consumed_idle_seq, &idle_seq);
+        consumed_idle_seq = idle_seq;
+
+        send_audio_round(audio_file_path, idle_seq);
         is_sending.store(false);
     });
 
     audioSendThread.detach();
 }
+
 /**
- * @brief 自动化测试TTS功能
+ * @brief 在当前IDLE期内完成一轮录音文件上传（阻塞调用线程）
  */
-void text_to_speech_request(const std::string& text){
-    Json::Value root;
-    root["text"] = text;
-    root["type"] = "transcript";
+bool send_audio_round(const std::string& audio_file_path, uint64_t idle_seq)
+{
+    // Opus uplink: packets come from the on-disk cache, encoded on first use
+    // (normally already during startup), before the round starts.
+    const bool opus = g_uplink_format == "opus";
+    OpusFrameCache::Frames frames;
+    if (opus) {
+        std::string error;
+        if (!OpusFrameCache::Load(audio_file_path, g_opus_cache_dir, &frames, &error)) {
+            LOGE("opus uplink: %s", error.c_str());
+            return false;
+        }
+        if (frames.encoded) {
+            LOGI("opus uplink: encoded %s into %u packets (%zu bytes) in %llu ms", audio_file_path.c_str(),
+                 frames.count, frames.size, (unsigned long long)(frames.encode_us / 1000));
+        }
+    }
 
-    Json::StreamWriterBuilder writer;
-    writer["indentation"] = ""; // No whitespace
+    ConvRetCode start_ret = conversation->SetAction(kStartHumanSpeech);
+    LOGI("SetAction StartHumanSpeech ret=%d", start_ret);
+    if (start_ret != kSuccess) {
+        LOGE("StartHumanSpeech failed (ret=%d), skip sending audio.", start_ret);
+        return false;
+    }
+    g_round_tracer.Mark(RoundTracer::kTraceRequestSent);
 
-    ConvRetCode ret = conversation -> SendResponseData(Json::writeString(writer, root).c_str());
-    if (ret != kSuccess){
-        std::cerr << "SendResponseData failed with code: " << ret << std::endl;
+    // Push audio as soon as the SDK reports LISTENING; the old fixed 300 ms
+    // pause is kept only as the upper bound.
+    if (!g_dialog_state.WaitFor(kDialogListening, kListeningWaitMs, idle_seq)) {
+        LOGW("No LISTENING state within %d ms, sending anyway.", kListeningWaitMs);
+    }
+
+    bool success = opus ? SendOpusFrames(conversation, frames, g_send_speed) : SendAudioFile(
+        conversation,
+        audio_file_path,
+        "pcm",
+        16000,
+        640,
+        true,   // WAV inputs (batch manifests) are sent without their header
+        g_send_speed
+    );
+    ConvRetCode stop_ret = conversation->SetAction(kStopHumanSpeech);
+    LOGI("SetAction StopHumanSpeech ret=%d", stop_ret);
+
+    if (success) {
+        LOGI("✅ 音频流发送线程完成");
     } else {
-        std::cout << "SendResponseData succeeded." << std::endl;
+        LOGE("❌ 音频流发送失败");
     }
+    return success;
 }
-
 /**
- * @brief 自动化测试VQA功能
+ * @brief 生成TTS请求（type=transcript）的JSON，写入线程局部缓冲区
  */
-void vqa_send_request(std::string image_path){
-    Json::Value root;
-    root["text"] = "你帮我看看图片里面是啥呗"; 
-    root["type"] = "prompt";
+const std::string& tts_request_json(const std::string& text){
+    std::string& out = JsonScratchBuffer();
+    out.reserve(sizeof(kTranscriptRequestHead) + sizeof(kTranscriptRequestTail) + text.size() + 16);
+    out.append(kTranscriptRequestHead, sizeof(kTranscriptRequestHead) - 1);
+    JsonAppendQuoted(&out, text.data(), text.size());
+    out.append(kTranscriptRequestTail, sizeof(kTranscriptRequestTail) - 1);
+    return out;
+}
 
-    Json::Value parameters;
-    Json::Value biz_params;
+std::string gen_tts_request(const std::string& text){
+    return tts_request_json(text);
+}
 
-    biz_params["user_defined_params"] = Json::Value(Json::objectValue);
+/**
+ * @brief 自动化测试TTS功能
+ */
+bool text_to_speech_request(const std::string& text){
+    const std::string& request = tts_request_json(text);
 
-    Json::Value images(Json::arrayValue);
-    {
-        Json::Value image;
+    g_round_tracer.Mark(RoundTracer::kTraceRequestSent);
+    ConvRetCode ret = conversation -> SendResponseData(request.c_str());
+    if (ret != kSuccess){
+        LOGE("SendResponseData failed with code: %d", ret);
+        return false;
+    }
+    LOGI("SendResponseData succeeded.");
+    return true;
+}
+
+/**
+ * @brief 生成VQA请求（type=prompt，图片以base64内联）的JSON
+ */
+std::string gen_vqa_request(const std::string& image_path){
+    ImageMapping image;
+    if (!image.Open(image_path)) return std::string();
+    return *BuildVqaRequest(image);
+}
 
-        ConversationUtils utils;
-        image["type"] = "base64";
-        image["value"] = utils.Base64EncodeFromFilePath(image_path);
-        
-        images.append(image);
+/**
+ * @brief 自动化测试VQA功能
+ */
+bool vqa_send_request(std::string image_path, bool* answered_from_cache){
+    if (answered_from_cache) *answered_from_cache = false;
+    bool cached = false;
+    uint64_t key = 0;
+    std::string answer;
+    std::shared_ptr<const std::string> request = VqaRequestFor(image_path, &cached, &key, &answer);
+    if (!request) return false;
+    if (!answer.empty()) {
+        // Same image and prompt answered before: no round trip.
+        LOGI("VQA answered from cache: %s", answer.c_str());
+        if (answered_from_cache) *answered_from_cache = true;
+        return true;
     }
-    parameters["images"] = images;
-    parameters["biz_params"] = biz_params;
-    root["parameters"] = parameters;
 
-    Json::StreamWriterBuilder writer;
-    writer["indentation"] = ""; // No whitespace
-    ConvRetCode ret = conversation -> SendResponseData(Json::writeString(writer, root).c_str());
+    // Collect this round's answer for the cache entry.
+    if (cached) g_vqa_cache.BeginRound(key);
+    g_round_tracer.Mark(RoundTracer::kTraceRequestSent);
+    ConvRetCode ret = conversation -> SendResponseData(request->c_str());
     if (ret != kSuccess){
-        std::cerr << "VQA SendResponseData failed with code: " << ret << std::endl;
-    } else {
-        std::cout << "VQA SendResponseData succeeded." << std::endl;
+        if (cached) g_vqa_cache.AbortRound();
+        LOGE("VQA SendResponseData failed with code: %d", ret);
+        return false;
     }
+    LOGI("VQA SendResponseData succeeded.");
+    return true;
 }
 
-std::string gen_init_params()
+/**
+ * @brief 预先生成VQA请求并放入缓存（启动阶段与建连并行执行）
+ */
+bool preload_vqa_image(const std::string& image_path, std::size_t* encoded_size)
 {
-    Json::FastWriter writer;
-    Json::Value root;
-    Json::Value agent_chat;
-    root["mode"] = g_mode;
-    root["chain_mode"] = "ws";
-    root["ws_version"] = 3;
-
-    root["debug_mode"] = "normal";
-    root["workspace"] = "/home/zijian/linux_cpp_multimodal/Linux_Multimodal_App/resources_aec_kws_vad_android";
-    root["save_log"] = true;
-    root["save_wav"] = true;
-    root["log_level"] = g_log_level;
+    ImageMapping image;
+    if (!image.Open(image_path)) return false;
+    std::shared_ptr<const std::string> body = BuildVqaRequest(image);
+    if (encoded_size) *encoded_size = body->size();
+    if (g_vqa_cache.enabled()) g_vqa_cache.Insert(VqaCacheKey(image), body);
+    return true;
+}
+
+/**
+ * @brief 生成建连参数JSON
+ * 键按字母序写出（与原Json::FastWriter输出逐字节一致），常量子对象整段拼接。
+ */
+std::string gen_init_params(const std::string& dialog_id)
+{
+    std::string& out = JsonScratchBuffer();
+    JsonWriter json(&out);
+    json.BeginObject();
+    static const char kAec[] = "{\"enable_external_aec_module\":false}";
+    json.Key("acoustic_echo_cancelling_attributes");
+    json.Raw(kAec, sizeof(kAec) - 1);
     // 必填参数:模型信息
-    root["url"] = "wss://dashscope.aliyuncs.com/api-ws/v1/inference";
-    root["apikey"] = "sk-cebc306c1a7d44579af8d99c199789a2";
-    root["app_id"] = "mm_62600140f1b743d7bad25d552b78";
-    root["workspace_id"] = "llm-2d2jbauuwkp1250n";
-    root["debug_path"] = "tmp/";
-
-    Json::Value upstream;
-    upstream["type"] = "AudioOnly";
+    json.Key("apikey");
+    json.String("sk-cebc306c1a7d44579af8d99c199789a2");
+    json.Key("app_id");
+    json.String("mm_62600140f1b743d7bad25d552b78");
+    json.Key("chain_mode");
+    json.String("ws");
+    static const char kClientInfo[] = "{\"user_id\":\"bin23439207\"}"; /* 额外扩充的用户信息 */
+    json.Key("client_info");
+    json.Raw(kClientInfo, sizeof(kClientInfo) - 1);
+    json.Key("debug_mode");
+    json.String("normal");
+    json.Key("debug_path");
+    json.String(g_output_dir + "/");
+
+    json.Key("dialog_attributes");
+    json.BeginObject();
+    if (!dialog_id.empty()) {
+        // 传入上次的dialog_id，重连后继续同一对话上下文
+        json.Key("dialog_id");
+        json.String(dialog_id);
+    }
+    json.Key("prompt");
+    json.String("你是个有用的助手。");
+    json.EndObject();
+
+    json.Key("downstream");
+    json.BeginObject();
+    json.Key("audio_format");
+    json.String("pcm"); // 下发的音频编码格式，支持opu,pcm
+    json.Key("debug");
+    json.Bool(true);
+    json.Key("intermediate_text");
+    json.String("transcript,dialog");
+    json.Key("sample_rate");
+    json.Int(24000);  // default tts sample_rate is 24000
+    json.Key("type");
+    json.String("Audio");
+    json.Key("voice");
+    json.String("longanhuan");
+    json.EndObject();
+
+    static const char kKws[] =
+        "{\"enable_external_kws_module\":false,\"independent_kws_mode\":false}";
+    json.Key("key_words_spotting_attributes");
+    json.Raw(kKws, sizeof(kKws) - 1);
+    json.Key("log_level");
+    json.String(g_log_level);
+    json.Key("mode");
+    json.String(g_mode);
+    json.Key("save_log");
+    json.Bool(true);
+    json.Key("save_wav");
+    json.Bool(true);
+
+    json.Key("upstream");
+    json.BeginObject();
     // 对齐官方 demo：上行设置为 opus（SDK 内部会对 SendAudioData 的 PCM 做编码），避免服务端认为 payload 无效。
-    upstream["audio_format"] = "pcm"; // asr格式，支持pcm,opus,raw-opus
-    upstream["sample_rate"] = 16000;
-    root["upstream"] = upstream;
-
-    Json::Value downstream;
-    downstream["type"] = "Audio";
-    downstream["voice"] = "longanhuan";
-    downstream["sample_rate"] = 24000;  // default tts sample_rate is 24000
-    downstream["audio_format"] = "pcm"; // 下发的音频编码格式，支持opu,pcm
-    downstream["intermediate_text"] = "transcript,dialog";
-    downstream["debug"] = true;
-    root["downstream"] = downstream;
-
-    Json::Value client_info; /* 额外扩充的用户信息 */
-    client_info["user_id"] = "bin23439207";
-    root["client_info"] = client_info;
-
-    Json::Value dialog_attributes;
-    dialog_attributes["prompt"] = "你是个有用的助手。";
-    root["dialog_attributes"] = dialog_attributes;
-
-    Json::Value acoustic_echo_cancelling_attributes;
-    acoustic_echo_cancelling_attributes["enable_external_aec_module"] = false;
-    root["acoustic_echo_cancelling_attributes"] =
-        acoustic_echo_cancelling_attributes;
-
-    Json::Value voice_activity_detection_attributes;
-    voice_activity_detection_attributes["enable_external_vad_module"] = false;
-    root["voice_activity_detection_attributes"] =
-        voice_activity_detection_attributes;
-
-    Json::Value key_words_spotting_attributes;
-    key_words_spotting_attributes["enable_external_kws_module"] = false;
-    key_words_spotting_attributes["independent_kws_mode"] = false;
-    root["key_words_spotting_attributes"] = key_words_spotting_attributes;
-
-    std::string result = writer.write(root);
-    std::cout << "init params: " << result.c_str() << std::endl;
-    return result;
+    json.Key("audio_format");
+    json.String(g_uplink_format); // asr格式，支持pcm,opus,raw-opus
+    json.Key("sample_rate");
+    json.Int(16000);
+    json.Key("type");
+    json.String("AudioOnly");
+    json.EndObject();
+
+    json.Key("url");
+    json.String(g_url);
+    static const char kVad[] = "{\"enable_external_vad_module\":false}";
+    json.Key("voice_activity_detection_attributes");
+    json.Raw(kVad, sizeof(kVad) - 1);
+    json.Key("workspace");
+    json.String(g_workspace_dir);
+    json.Key("workspace_id");
+    json.String("llm-2d2jbauuwkp1250n");
+    json.Key("ws_version");
+    json.Int(3);
+    json.EndObject();
+    out.push_back('\n');  // FastWriter ended the document with a newline
+
+    LOGI("init params: %s", out.c_str());
+    return out;
 }
 
 std::string getExecutableDirectory() {
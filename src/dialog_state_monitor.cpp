@@ -0,0 +1,95 @@
+#include "dialog_state_monitor.h"
+
+#include <cstring>
+
+using namespace convsdk;
+
+const int DialogStateMonitor::kStateUnknown;
+const int DialogStateMonitor::kNumStates;
+
+DialogStateMonitor::DialogStateMonitor()
+    : state_(kStateUnknown),
+      seq_(0),
+      entered_at_(std::chrono::steady_clock::now()) {
+    std::memset(transitions_, 0, sizeof(transitions_));
+}
+
+void DialogStateMonitor::OnStateChanged(int state) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (state_ >= 0 && state_ < kNumStates && state >= 0 && state < kNumStates) {
+            uint64_t us = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(now - entered_at_).count());
+            TransitionStats& t = transitions_[state_][state];
+            t.count++;
+            t.total_us += us;
+            if (us > t.max_us) t.max_us = us;
+        }
+        state_ = state;
+        seq_++;
+        entered_at_ = now;
+    }
+    cv_.notify_all();
+}
+
+int DialogStateMonitor::Current() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return state_;
+}
+
+uint64_t DialogStateMonitor::Sequence() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return seq_;
+}
+
+bool DialogStateMonitor::WaitFor(ConvDialogState state, int timeout_ms,
+                                 uint64_t after_seq, uint64_t* entry_seq) {
+    std::unique_lock<std::mutex> guard(lock_);
+    auto ready = [this, state, after_seq]() {
+        return state_ == static_cast<int>(state) && seq_ > after_seq;
+    };
+    if (timeout_ms < 0) {
+        cv_.wait(guard, ready);
+    } else if (!cv_.wait_for(guard, std::chrono::milliseconds(timeout_ms), ready)) {
+        return false;
+    }
+    if (entry_seq) *entry_seq = seq_;
+    return true;
+}
+
+DialogStateMonitor::TransitionStats DialogStateMonitor::GetTransition(int from, int to) const {
+    TransitionStats empty = {0, 0, 0};
+    if (from < 0 || from >= kNumStates || to < 0 || to >= kNumStates) return empty;
+    std::lock_guard<std::mutex> guard(lock_);
+    return transitions_[from][to];
+}
+
+void DialogStateMonitor::PrintStats(std::ostream& os) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    os << "dialog state transitions (time spent in source state):" << std::endl;
+    for (int from = 0; from < kNumStates; ++from) {
+        for (int to = 0; to < kNumStates; ++to) {
+            const TransitionStats& t = transitions_[from][to];
+            if (t.count == 0) continue;
+            os << "  " << StateName(from) << " -> " << StateName(to) << ": n=" << t.count
+               << " avg=" << t.total_us / t.count / 1000.0 << "ms max=" << t.max_us / 1000.0
+               << "ms" << std::endl;
+        }
+    }
+}
+
+const char* DialogStateMonitor::StateName(int state) {
+    switch (state) {
+    case kDialogIdle:
+        return "IDLE";
+    case kDialogListening:
+        return "LISTENING";
+    case kDialogResponding:
+        return "RESPONDING";
+    case kDialogThinking:
+        return "THINKING";
+    default:
+        return "UNKNOWN";
+    }
+}
@@ -0,0 +1,270 @@
+#include "event_dispatcher.h"
+
+using namespace convsdk;
+
+namespace {
+// Upper bound on how long an idle worker sleeps before re-checking its queue.
+const std::chrono::milliseconds kIdleWait(10);
+// How long an SDK callback waits for room in a full lane before the event
+// is dropped.
+const std::chrono::milliseconds kFullWait(100);
+}
+
+void EventRecord::CopyFrom(ConvEvent* event) {
+    type = event->GetMsgType();
+    dialog_state = event->GetDialogStateChanged();
+    sound_level = event->GetSoundLevel();
+    status_code = event->GetStatusCode();
+    terminate = event->GetTerminate();
+
+    const char* s = event->GetSessionId();
+    session_id.assign(s ? s : "");
+    s = event->GetDialogId();
+    dialog_id.assign(s ? s : "");
+    s = event->GetRoundId();
+    round_id.assign(s ? s : "");
+
+    if (type == ConvEvent::kBinary) {
+        response.clear();
+        int size = event->GetBinaryDataSize();
+        const unsigned char* data = event->GetBinaryDataInChar();
+        if (size > 0 && data) {
+            binary.assign(data, data + size);
+        } else {
+            binary.clear();
+        }
+    } else {
+        s = event->GetAllResponse();
+        response.assign(s ? s : "");
+        binary.clear();
+    }
+    received_at = std::chrono::steady_clock::now();
+}
+
+EventDispatcher::LaneState::LaneState(std::size_t capacity)
+    : queue(capacity),
+      sleeping(false),
+      posted(0),
+      dispatched(0),
+      rejected(0),
+      max_depth(0),
+      total_wait_us(0),
+      max_wait_us(0) {}
+
+EventDispatcher::EventDispatcher(Handler handler, std::size_t lane_capacity)
+    : handler_(handler),
+      records_(lane_capacity * kNumLanes),
+      free_records_(lane_capacity * kNumLanes),
+      state_(kStopped),
+      posting_(0) {
+    for (std::size_t i = 0; i < records_.size(); ++i) {
+        free_records_.TryPush(&records_[i]);
+    }
+    for (int i = 0; i < kNumLanes; ++i) {
+        lanes_[i] = new LaneState(lane_capacity);
+    }
+}
+
+EventDispatcher::~EventDispatcher() {
+    Stop();
+    for (int i = 0; i < kNumLanes; ++i) {
+        delete lanes_[i];
+    }
+}
+
+bool EventDispatcher::Start() {
+    int expected = kStopped;
+    if (!state_.compare_exchange_strong(expected, kRunning)) return true;
+    for (int i = 0; i < kNumLanes; ++i) {
+        lanes_[i]->worker = std::thread(&EventDispatcher::WorkerMain, this, static_cast<Lane>(i));
+    }
+    return true;
+}
+
+void EventDispatcher::Stop() {
+    int expected = kRunning;
+    if (!state_.compare_exchange_strong(expected, kStopping)) return;
+    // A Post that saw kRunning may still be enqueuing; let it finish so
+    // nothing lands in a lane after its final drain below.
+    while (posting_.load() > 0) std::this_thread::yield();
+    for (int i = 0; i < kNumLanes; ++i) {
+        Wake(*lanes_[i]);
+    }
+    for (int i = 0; i < kNumLanes; ++i) {
+        if (lanes_[i]->worker.joinable()) lanes_[i]->worker.join();
+        // The worker may have seen an empty queue just before the last
+        // posts; dispatch those here.
+        Drain(*lanes_[i]);
+    }
+    state_.store(kStopped);
+}
+
+bool EventDispatcher::WaitDispatched(Lane lane, int timeout_ms) const {
+    const LaneState& state = *lanes_[lane];
+    const uint64_t target = state.posted.load();
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    // Handlers are short; poll rather than signal from the hot path.
+    while (state.dispatched.load() < target) {
+        if (!running()) return true;  // Stop() drains the lanes itself
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+EventDispatcher::Lane EventDispatcher::LaneOf(ConvEvent::ConvEventType type) {
+    return type == ConvEvent::kBinary ? kLaneAudio : kLaneControl;
+}
+
+bool EventDispatcher::BeginPost(LaneState& lane) {
+    // Pairs with Stop(): either Stop() sees this post in flight and waits
+    // for it, or this post sees the state change and backs out.
+    posting_++;
+    const int state = state_.load();
+    if (state == kRunning) return true;
+    posting_--;
+    if (state == kStopping) lane.rejected++;
+    return false;
+}
+
+bool EventDispatcher::WaitForRoom(std::chrono::steady_clock::time_point deadline) {
+    if (std::chrono::steady_clock::now() >= deadline) return false;
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    return true;
+}
+
+bool EventDispatcher::Post(ConvEvent* event) {
+    if (!event) return false;
+    LaneState& lane = *lanes_[LaneOf(event->GetMsgType())];
+    if (!BeginPost(lane)) return false;
+
+    // Wait briefly rather than reorder: the event must not overtake the
+    // ones already queued in its lane.
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + kFullWait;
+    EventRecord* record = nullptr;
+    while (!free_records_.TryPop(record)) {
+        if (!WaitForRoom(deadline)) {
+            lane.rejected++;
+            posting_--;
+            return false;
+        }
+    }
+    record->CopyFrom(event);
+    bool ok = Enqueue(lane, record, deadline);
+    posting_--;
+    return ok;
+}
+
+bool EventDispatcher::Post(const EventRecord& source) {
+    LaneState& lane = *lanes_[LaneOf(source.type)];
+    if (!BeginPost(lane)) return false;
+
+    EventRecord* record = nullptr;
+    if (!free_records_.TryPop(record)) {
+        lane.rejected++;
+        posting_--;
+        return false;
+    }
+    // Assignment keeps the pooled record's string/vector capacity.
+    *record = source;
+    record->received_at = std::chrono::steady_clock::now();
+    bool ok = Enqueue(lane, record, std::chrono::steady_clock::time_point());
+    posting_--;
+    return ok;
+}
+
+bool EventDispatcher::Enqueue(LaneState& lane, EventRecord* record,
+                              std::chrono::steady_clock::time_point deadline) {
+    while (!lane.queue.TryPush(record)) {
+        if (!WaitForRoom(deadline)) {
+            free_records_.TryPush(record);
+            lane.rejected++;
+            return false;
+        }
+    }
+    lane.posted++;
+    UpdateMax(lane.max_depth, lane.queue.SizeApprox());
+    Wake(lane);
+    return true;
+}
+
+void EventDispatcher::Wake(LaneState& lane) {
+    // Pairs with the fence in WorkerMain: either the worker sees the new
+    // element, or we see it sleeping and notify.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (lane.sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard(lane.wake_lock);
+        lane.wake_cv.notify_one();
+    }
+}
+
+bool EventDispatcher::DispatchOne(LaneState& lane) {
+    EventRecord* record = nullptr;
+    if (!lane.queue.TryPop(record)) return false;
+    uint64_t wait_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - record->received_at).count());
+    lane.total_wait_us += wait_us;
+    UpdateMax(lane.max_wait_us, wait_us);
+
+    if (handler_) handler_(*record);
+    lane.dispatched++;
+    free_records_.TryPush(record);
+    return true;
+}
+
+void EventDispatcher::Drain(LaneState& lane) {
+    while (DispatchOne(lane)) {
+    }
+}
+
+void EventDispatcher::WorkerMain(Lane lane_id) {
+    LaneState& lane = *lanes_[lane_id];
+    for (;;) {
+        if (DispatchOne(lane)) continue;
+
+        if (!running()) break;
+
+        std::unique_lock<std::mutex> guard(lane.wake_lock);
+        lane.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (lane.queue.SizeApprox() == 0 && running()) {
+            lane.wake_cv.wait_for(guard, kIdleWait);
+        }
+        lane.sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+void EventDispatcher::UpdateMax(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t cur = target.load(std::memory_order_relaxed);
+    while (value > cur && !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+    }
+}
+
+std::size_t EventDispatcher::Depth(Lane lane) const {
+    return lanes_[lane]->queue.SizeApprox();
+}
+
+EventDispatcher::LaneStats EventDispatcher::GetStats(Lane lane_id) const {
+    const LaneState& lane = *lanes_[lane_id];
+    LaneStats st;
+    st.posted = lane.posted.load();
+    st.dispatched = lane.dispatched.load();
+    st.rejected = lane.rejected.load();
+    st.max_depth = lane.max_depth.load();
+    st.total_wait_us = lane.total_wait_us.load();
+    st.max_wait_us = lane.max_wait_us.load();
+    return st;
+}
+
+void EventDispatcher::PrintStats(std::ostream& os) const {
+    static const char* kLaneNames[kNumLanes] = {"audio", "control"};
+    for (int i = 0; i < kNumLanes; ++i) {
+        LaneStats st = GetStats(static_cast<Lane>(i));
+        os << "dispatch lane " << kLaneNames[i] << ": posted " << st.posted << ", dispatched "
+           << st.dispatched << ", rejected " << st.rejected << ", depth " << Depth(static_cast<Lane>(i))
+           << " (max " << st.max_depth << "), wait avg "
+           << (st.dispatched ? st.total_wait_us / st.dispatched : 0) << " us, max "
+           << st.max_wait_us << " us" << std::endl;
+    }
+}
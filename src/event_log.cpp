@@ -0,0 +1,306 @@
+#include "event_log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "audio_pacer.h"
+#include "sys_util.h"
+
+using namespace convsdk;
+
+namespace {
+
+const char kMagic[8] = {'C', 'O', 'N', 'V', 'E', 'V', 'T', '1'};
+const uint32_t kVersion = 1;
+const std::size_t kHeaderSize = 24;
+// t_ns + four i32 + terminate + three u16 + two u32 lengths.
+const std::size_t kFixedRecordSize = 8 + 4 * 4 + 1 + 3 * 2 + 2 * 4;
+// A recording session can burst far more events than a PCM session.
+const std::size_t kMaxQueuedRecords = 4096;
+
+void AppendLE(std::vector<unsigned char>& out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<unsigned char>(v >> (8 * i)));
+    }
+}
+
+void AppendBytes(std::vector<unsigned char>& out, const void* data, std::size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    out.insert(out.end(), p, p + size);
+}
+
+// u16 length prefix; IDs longer than that are cut (they never are in practice).
+void AppendShortString(std::vector<unsigned char>& out, const char* s) {
+    std::size_t len = s ? std::strlen(s) : 0;
+    if (len > 0xFFFF) len = 0xFFFF;
+    AppendLE(out, len, 2);
+    AppendBytes(out, s, len);
+}
+
+uint64_t GetLE(const unsigned char* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) {
+        v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+uint64_t NowUnixNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+void SetError(std::string* error, const std::string& msg) {
+    if (error) *error = msg;
+}
+
+}  // namespace
+
+EventLogWriter::EventLogWriter(const std::string& path)
+    : out_(path, PcmSessionWriter::kContainerRaw, 24000, 1, kMaxQueuedRecords),
+      start_(std::chrono::steady_clock::now()),
+      records_(0) {}
+
+EventLogWriter::~EventLogWriter() {
+    Close();
+}
+
+bool EventLogWriter::Open() {
+    if (!out_.Open()) return false;
+    start_ = std::chrono::steady_clock::now();
+
+    std::vector<unsigned char> header;
+    AppendBytes(header, kMagic, sizeof(kMagic));
+    AppendLE(header, kVersion, 4);
+    AppendLE(header, 0, 4);
+    AppendLE(header, NowUnixNs(), 8);
+    return out_.Push(header);
+}
+
+void EventLogWriter::Append(ConvEvent* event) {
+    if (!event) return;
+    uint64_t t_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count());
+
+    // Push() swaps in a recycled buffer, so this stays allocation free once
+    // the writer's pool has warmed up.
+    static thread_local std::vector<unsigned char> buf;
+    buf.clear();
+
+    ConvEvent::ConvEventType type = event->GetMsgType();
+    const unsigned char* binary = NULL;
+    std::size_t binary_size = 0;
+    const char* response = NULL;
+    // Audio packets keep only their payload, matching EventRecord::CopyFrom.
+    if (type == ConvEvent::kBinary) {
+        int size = event->GetBinaryDataSize();
+        binary = event->GetBinaryDataInChar();
+        if (size > 0 && binary) binary_size = static_cast<std::size_t>(size);
+    } else {
+        response = event->GetAllResponse();
+    }
+    std::size_t response_size = response ? std::strlen(response) : 0;
+
+    AppendLE(buf, 0, 4);  // record size, patched below
+    AppendLE(buf, t_ns, 8);
+    AppendLE(buf, static_cast<uint32_t>(type), 4);
+    AppendLE(buf, static_cast<uint32_t>(event->GetDialogStateChanged()), 4);
+    AppendLE(buf, static_cast<uint32_t>(event->GetSoundLevel()), 4);
+    AppendLE(buf, static_cast<uint32_t>(event->GetStatusCode()), 4);
+    buf.push_back(event->GetTerminate() ? 1 : 0);
+    AppendShortString(buf, event->GetSessionId());
+    AppendShortString(buf, event->GetDialogId());
+    AppendShortString(buf, event->GetRoundId());
+    AppendLE(buf, response_size, 4);
+    AppendBytes(buf, response, response_size);
+    AppendLE(buf, binary_size, 4);
+    AppendBytes(buf, binary, binary_size);
+
+    uint32_t size = static_cast<uint32_t>(buf.size() - 4);
+    for (int i = 0; i < 4; ++i) {
+        buf[i] = static_cast<unsigned char>(size >> (8 * i));
+    }
+    if (out_.Push(buf)) records_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void EventLogWriter::Close() {
+    out_.Close();
+}
+
+EventLogReader::EventLogReader() : data_(NULL), size_(0), pos_(0), wall_start_ns_(0) {}
+
+EventLogReader::~EventLogReader() {
+    Unmap();
+}
+
+void EventLogReader::Unmap() {
+    if (data_) {
+        munmap(const_cast<unsigned char*>(data_), size_);
+    }
+    data_ = NULL;
+    size_ = 0;
+    pos_ = 0;
+}
+
+bool EventLogReader::Open(const std::string& path, std::string* error) {
+    Unmap();
+    error_.clear();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        SetError(error, "open " + path + ": " + std::strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        SetError(error, "stat " + path + ": " + std::strerror(errno));
+        close(fd);
+        return false;
+    }
+    if (static_cast<std::size_t>(st.st_size) < kHeaderSize) {
+        SetError(error, path + ": not an event log (too short)");
+        close(fd);
+        return false;
+    }
+    void* base = mmap(NULL, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        SetError(error, "mmap " + path + ": " + std::strerror(errno));
+        return false;
+    }
+    data_ = static_cast<const unsigned char*>(base);
+    size_ = static_cast<std::size_t>(st.st_size);
+    madvise(base, size_, MADV_SEQUENTIAL);
+
+    if (std::memcmp(data_, kMagic, sizeof(kMagic)) != 0) {
+        SetError(error, path + ": not an event log (bad magic)");
+        Unmap();
+        return false;
+    }
+    uint32_t version = static_cast<uint32_t>(GetLE(data_ + 8, 4));
+    if (version != kVersion) {
+        SetError(error, path + ": unsupported event log version " + std::to_string(version));
+        Unmap();
+        return false;
+    }
+    wall_start_ns_ = GetLE(data_ + 16, 8);
+    pos_ = kHeaderSize;
+    return true;
+}
+
+bool EventLogReader::Next(EventRecord* record, uint64_t* offset_ns) {
+    if (!data_ || pos_ >= size_) return false;
+    if (size_ - pos_ < 4) {
+        error_ = "truncated record header at offset " + std::to_string(pos_);
+        pos_ = size_;
+        return false;
+    }
+    std::size_t size = static_cast<std::size_t>(GetLE(data_ + pos_, 4));
+    if (size < kFixedRecordSize || size > size_ - pos_ - 4) {
+        error_ = "truncated record at offset " + std::to_string(pos_);
+        pos_ = size_;
+        return false;
+    }
+    const unsigned char* p = data_ + pos_ + 4;
+    const unsigned char* end = p + size;
+
+    *offset_ns = GetLE(p, 8);
+    record->type = static_cast<ConvEvent::ConvEventType>(static_cast<int32_t>(GetLE(p + 8, 4)));
+    record->dialog_state = static_cast<int32_t>(GetLE(p + 12, 4));
+    record->sound_level = static_cast<int32_t>(GetLE(p + 16, 4));
+    record->status_code = static_cast<int32_t>(GetLE(p + 20, 4));
+    record->terminate = p[24] != 0;
+    p += 25;
+
+    // Each variable-length field must leave room for the length fields
+    // still to come (remaining u16 ID lengths, response and binary u32s).
+    std::string* ids[3] = {&record->session_id, &record->dialog_id, &record->round_id};
+    for (int i = 0; i < 3; ++i) {
+        std::size_t len = static_cast<std::size_t>(GetLE(p, 2));
+        p += 2;
+        std::size_t left = static_cast<std::size_t>(end - p);
+        std::size_t reserved = 2 * static_cast<std::size_t>(2 - i) + 8;
+        if (left < reserved || len > left - reserved) return Corrupt();
+        ids[i]->assign(reinterpret_cast<const char*>(p), len);
+        p += len;
+    }
+    std::size_t response_size = static_cast<std::size_t>(GetLE(p, 4));
+    p += 4;
+    std::size_t left = static_cast<std::size_t>(end - p);
+    if (left < 4 || response_size > left - 4) return Corrupt();
+    record->response.assign(reinterpret_cast<const char*>(p), response_size);
+    p += response_size;
+    std::size_t binary_size = static_cast<std::size_t>(GetLE(p, 4));
+    p += 4;
+    if (binary_size != static_cast<std::size_t>(end - p)) return Corrupt();
+    record->binary.assign(p, end);
+
+    pos_ += 4 + size;
+    return true;
+}
+
+bool EventLogReader::Corrupt() {
+    error_ = "corrupt record at offset " + std::to_string(pos_);
+    pos_ = size_;
+    return false;
+}
+
+bool ReplayEventLog(const std::string& path, double speed, EventDispatcher& dispatcher,
+                    ReplayStats* stats, std::string* error) {
+    ReplayStats result;
+    EventLogReader reader;
+    if (!reader.Open(path, error)) return false;
+    if (!dispatcher.running()) {
+        SetError(error, "event dispatcher is not running");
+        return false;
+    }
+
+    EventRecord record;
+    uint64_t offset_ns = 0;
+    uint64_t last_ns = 0;
+    AudioPacer pacer(speed);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pacer.Start();
+    while (reader.Next(&record, &offset_ns)) {
+        pacer.WaitUntil(offset_ns);
+        while (!dispatcher.Post(record)) {
+            if (!dispatcher.running()) {
+                SetError(error, "event dispatcher stopped during replay");
+                return false;
+            }
+            result.full_waits++;
+            std::this_thread::yield();
+        }
+        result.events++;
+        result.binary_bytes += record.binary.size();
+        if (offset_ns > last_ns) last_ns = offset_ns;
+    }
+    pacer.Finish(last_ns);
+
+    // The rate counts handled events, so wait until both lanes are idle.
+    for (;;) {
+        bool drained = true;
+        for (int i = 0; i < EventDispatcher::kNumLanes; ++i) {
+            EventDispatcher::LaneStats st = dispatcher.GetStats(static_cast<EventDispatcher::Lane>(i));
+            if (st.dispatched < st.posted) drained = false;
+        }
+        if (drained) break;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    result.wall_us = ElapsedUs(start);
+    result.media_us = last_ns / 1000;
+    result.late_events = pacer.stats().late_chunks;
+
+    if (stats) *stats = result;
+    if (!reader.error().empty()) {
+        SetError(error, path + ": " + reader.error());
+        return false;
+    }
+    return true;
+}
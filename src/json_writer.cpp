@@ -0,0 +1,113 @@
+#include "json_writer.h"
+
+namespace {
+// 0: copy as is; otherwise the character after the backslash, or 'u' for
+// \u00XX.
+struct EscapeTable {
+    char code[256];
+    EscapeTable() {
+        std::memset(code, 0, sizeof(code));
+        for (int c = 1; c < 0x20; ++c) code[c] = 'u';
+        code[0] = 'u';
+        code[static_cast<unsigned char>('"')] = '"';
+        code[static_cast<unsigned char>('\\')] = '\\';
+        code[static_cast<unsigned char>('\b')] = 'b';
+        code[static_cast<unsigned char>('\f')] = 'f';
+        code[static_cast<unsigned char>('\n')] = 'n';
+        code[static_cast<unsigned char>('\r')] = 'r';
+        code[static_cast<unsigned char>('\t')] = 't';
+    }
+};
+const EscapeTable kEscape;
+const char kHexDigits[] = "0123456789ABCDEF";
+}
+
+void JsonAppendQuoted(std::string* out, const char* value, std::size_t len) {
+    out->push_back('"');
+    const char* run = value;
+    const char* end = value + len;
+    for (const char* p = value; p != end; ++p) {
+        const char code = kEscape.code[static_cast<unsigned char>(*p)];
+        if (code == 0) continue;
+        out->append(run, p - run);
+        run = p + 1;
+        if (code == 'u') {
+            const unsigned char c = static_cast<unsigned char>(*p);
+            const char escaped[6] = {'\\', 'u', '0', '0', kHexDigits[c >> 4], kHexDigits[c & 0xf]};
+            out->append(escaped, sizeof(escaped));
+        } else {
+            const char escaped[2] = {'\\', code};
+            out->append(escaped, sizeof(escaped));
+        }
+    }
+    out->append(run, end - run);
+    out->push_back('"');
+}
+
+void JsonWriter::Separate() {
+    if (after_key_) {
+        after_key_ = false;
+        return;
+    }
+    const uint32_t bit = 1u << depth_;
+    if (has_items_ & bit) out_->push_back(',');
+    has_items_ |= bit;
+}
+
+void JsonWriter::Open(char bracket) {
+    Separate();
+    out_->push_back(bracket);
+    if (depth_ + 1 < kMaxDepth) ++depth_;
+    has_items_ &= ~(1u << depth_);
+}
+
+void JsonWriter::Close(char bracket) {
+    if (depth_ > 0) --depth_;
+    out_->push_back(bracket);
+}
+
+void JsonWriter::Key(const char* key, std::size_t len) {
+    Separate();
+    JsonAppendQuoted(out_, key, len);
+    out_->push_back(':');
+    after_key_ = true;
+}
+
+void JsonWriter::String(const char* value, std::size_t len) {
+    Separate();
+    JsonAppendQuoted(out_, value, len);
+}
+
+void JsonWriter::Int(int64_t value) {
+    Separate();
+    char digits[24];
+    char* p = digits + sizeof(digits);
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    do {
+        *--p = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) *--p = '-';
+    out_->append(p, digits + sizeof(digits) - p);
+}
+
+void JsonWriter::Bool(bool value) {
+    Separate();
+    if (value) {
+        out_->append("true", 4);
+    } else {
+        out_->append("false", 5);
+    }
+}
+
+void JsonWriter::Raw(const char* json, std::size_t len) {
+    Separate();
+    out_->append(json, len);
+}
+
+std::string& JsonScratchBuffer() {
+    static thread_local std::string buffer;
+    if (buffer.capacity() > kJsonScratchRetainBytes) std::string().swap(buffer);
+    buffer.clear();
+    return buffer;
+}
@@ -0,0 +1,70 @@
+#include "latency_histogram.h"
+
+#include <cstring>
+
+const int LatencyHistogram::kSubBucketBits;
+const int LatencyHistogram::kSubBuckets;
+const int LatencyHistogram::kMaxShift;
+const int LatencyHistogram::kNumBuckets;
+
+namespace {
+const uint64_t kMaxValue = (1ULL << 37) - 1;
+}
+
+void LatencyHistogram::Reset() {
+    std::memset(counts_, 0, sizeof(counts_));
+    count_ = 0;
+    sum_ = 0;
+    min_ = 0;
+    max_ = 0;
+}
+
+int LatencyHistogram::BucketIndex(uint64_t value) {
+    if (value > kMaxValue) value = kMaxValue;
+    int msb = 63 - __builtin_clzll(value | 1);
+    int shift = msb > kSubBucketBits ? msb - kSubBucketBits : 0;
+    return shift * kSubBuckets + static_cast<int>(value >> shift);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(int index) {
+    int shift = index < 2 * kSubBuckets ? 0 : index / kSubBuckets - 1;
+    uint64_t lower = static_cast<uint64_t>(index - shift * kSubBuckets) << shift;
+    return lower + (1ULL << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t value) {
+    if (value > kMaxValue) value = kMaxValue;
+    counts_[BucketIndex(value)]++;
+    if (count_ == 0 || value < min_) min_ = value;
+    if (value > max_) max_ = value;
+    count_++;
+    sum_ += value;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    if (other.count_ == 0) return;
+    for (int i = 0; i < kNumBuckets; ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    if (count_ == 0 || other.min_ < min_) min_ = other.min_;
+    if (other.max_ > max_) max_ = other.max_;
+    count_ += other.count_;
+    sum_ += other.sum_;
+}
+
+uint64_t LatencyHistogram::Percentile(double p) const {
+    if (count_ == 0) return 0;
+    if (p < 0) p = 0;
+    if (p > 100) p = 100;
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * count_ + 0.5);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; ++i) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            uint64_t v = BucketUpperBound(i);
+            return v < max_ ? v : max_;
+        }
+    }
+    return max_;
+}
@@ -1,5 +1,9 @@
 #include <iostream>
 #include <cstring>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
 #include <signal.h>
 #include <string>
 #include <fstream>
@@ -9,55 +13,109 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <memory>
 #include <pthread.h>
 
 #include "conversation_handler.h"
 #include "audio_handler.h"
+#include "async_log.h"
+#include "audio_pipeline.h"
+#include "batch_runner.h"
+#include "startup_preloader.h"
+#include "worker_pool.h"
 
 #include "conversation.h"
 #include "conversation_utils.h"
 #include "json/json.h"
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sstream>
 #include <ctime>
 
 using namespace convsdk;
 
 static std::string g_apikey = "";
-static std::string g_url = "wss://dashscope.aliyuncs.com/api-ws/v1/inference";
+std::string g_url = "wss://dashscope.aliyuncs.com/api-ws/v1/inference"; /* 可指向本地回环服务端 ws://127.0.0.1:<port>/ */
 std::string g_log_level = "verbose"; /* version, debug, info, warn, error */
 std::string g_mode = "push2talk"; /* tap2talk, push2talk, duplex, kws_duplex */
+std::string g_output_dir = "tmp"; /* per worker: tmp/worker-<n> */
+std::string g_workspace_dir = "/home/zijian/linux_cpp_multimodal/Linux_Multimodal_App/resources_aec_kws_vad_android";
 std::string g_exeDir = getExecutableDirectory();
 std::string audio_file_path = g_exeDir + "/audio_16k.pcm";
 std::string g_image_file_path = g_exeDir + "/test_img.jpg";
 
 Conversation *conversation;
-std::atomic<bool> can_send_audio{false};
+DialogStateMonitor g_dialog_state;
+EventDispatcher g_event_dispatcher(HandleEventRecord);
+RoundTracer g_round_tracer;
+ConnectionManager g_connection;
+double g_send_speed = 1.0; /* audio upload pacing: 1.0 real time, 0 as fast as possible */
+std::string g_uplink_format = "pcm"; /* --uplink: pcm, or opus from the frame cache */
+std::string g_opus_cache_dir = "tmp/opus_cache"; /* --opus-cache: shared by all workers */
+EventLogWriter* g_event_log = NULL;
+VqaCache g_vqa_cache;
+TtsQueue g_tts_queue;
+TranscriptStore g_transcripts;
+
+static std::string g_record_path;  /* --record: log every onMessage event */
+static std::string g_replay_path;  /* --replay: feed a recorded log to the handlers, no connection */
+static double g_replay_speed = 1.0; /* 1.0 original timing, 0 as fast as possible */
+static std::string g_batch_path;   /* --batch: run a manifest instead of the CLI */
+static int g_workers = 1;          /* --workers: batch rounds spread over N processes */
+static long g_vqa_cache_mb = VqaCache::kDefaultBudgetBytes >> 20; /* --vqa-cache-mb, 0 disables */
+static bool g_vqa_cache_answers = false; /* --vqa-cache-answers: repeat images answered from cache */
+static long g_transcript_mb = TranscriptStore::kDefaultBudgetBytes >> 20; /* --transcript-mb: stored dialogue text */
+static std::unique_ptr<BatchRunner> g_batch;
+static StartupPreloader g_startup;  /* assets prepared while connecting + phase timings */
+
+// Push-to-talk capture/send pipeline, created on first press.
+static std::unique_ptr<AudioPipeline> g_pipeline;
+
+static AudioPipeline* GetPipeline() {
+    if (!g_pipeline) {
+        std::string error;
+        std::shared_ptr<const MappedAudioFile> file = MappedAudioFile::Open(audio_file_path, &error);
+        if (!file) {
+            std::cerr << "Pipeline source unavailable: " << error << std::endl;
+            return nullptr;
+        }
+        // The file stands in for the microphone and is looped in real time.
+        std::unique_ptr<AudioSource> source(new FileAudioSource(file, 16000));
+        g_pipeline.reset(new AudioPipeline(conversation, std::move(source)));
+        if (!g_pipeline->Start()) {
+            g_pipeline.reset();
+            return nullptr;
+        }
+    }
+    return g_pipeline.get();
+}
+
+static void PrintPipelineStats() {
+    if (!g_pipeline) return;
+    AudioPipeline::Stats st = g_pipeline->GetStats();
+    std::cout << "pipeline: captured " << st.frames_captured << ", sent " << st.frames_sent
+              << ", flushed " << st.frames_flushed << ", overruns " << st.overruns
+              << ", idle drops " << st.idle_drops << ", underruns " << st.underruns
+              << ", send errors " << st.send_errors << std::endl;
+}
 
 struct ConnectThreadResult {
     ConvRetCode ret{convsdk::kDefaultError};
+    StartupPreloader::Clock::time_point start;
+    StartupPreloader::Clock::time_point end;
 };
 
 static void* ConnectThreadMain(void* arg) {
     auto* result = static_cast<ConnectThreadResult*>(arg);
     if (!result) return nullptr;
 
-    ConversationCallbackMethod on_message_callback = onMessage;
-    EventTrackCallbackMethod on_et_callback = onEtMessage;
-
-    conversation = Conversation::CreateConversation(on_message_callback, on_et_callback, NULL);
-    if (!conversation) {
-        result->ret = convsdk::kNotCreateConversation;
-        return nullptr;
-    }
-
-    std::string params = gen_init_params();
-    result->ret = conversation->Connect(params.c_str());
-    if (result->ret != convsdk::kSuccess) {
-        conversation->DestroyConversation();
-        conversation = NULL;
-    }
+    // Creates the conversation (onMessage / onEtMessage callbacks) and keeps
+    // it connected from here on.
+    result->start = StartupPreloader::Clock::now();
+    result->ret = g_connection.Connect();
+    result->end = StartupPreloader::Clock::now();
     return nullptr;
 }
 
@@ -79,6 +137,29 @@ void signalHandlerQUIT(int signum)
     std::exit(0);
 }
 
+/**
+ * @brief 解析非负数参数；整串都须是数字，拼写错误不会被当作0
+ */
+static bool ParseNonNegative(const char* text, double* out)
+{
+    char* end = nullptr;
+    errno = 0;
+    double value = strtod(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !std::isfinite(value) || value < 0) return false;
+    *out = value;
+    return true;
+}
+
+static bool ParseNonNegative(const char* text, long* out)
+{
+    char* end = nullptr;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || value < 0) return false;
+    *out = value;
+    return true;
+}
+
 /**
  * @brief 解析命令行参数
  */
@@ -89,7 +170,10 @@ int parse_arg(int argc, char *argv[])
     {
         if (!strcmp(argv[index], "--help"))
         {
-            std::cout << "Usage: --apikey <key> [--url <wss-url>]" << std::endl;
+            std::cout << "Usage: --apikey <key> [--url <wss-url|ws://127.0.0.1:port/>] [--speed <factor>] [--record <event-log>] [--batch <manifest.json> [--workers <n>]]" << std::endl;
+            std::cout << "       [--vqa-cache-mb <n>] [--vqa-cache-answers] [--transcript-mb <n>]" << std::endl;
+            std::cout << "       [--uplink <pcm|opus>] [--opus-cache <dir>]" << std::endl;
+            std::cout << "       --replay <event-log> [--replay-speed <factor>]" << std::endl;
             return 1;
         }
         else if (!strcmp(argv[index], "--apikey"))
@@ -112,6 +196,137 @@ int parse_arg(int argc, char *argv[])
             }
             g_url = argv[index];
         }
+        else if (!strcmp(argv[index], "--speed"))
+        {
+            index++;
+            if (index >= argc)
+            {
+                std::cerr << "--speed requires a value" << std::endl;
+                return 1;
+            }
+            if (!ParseNonNegative(argv[index], &g_send_speed))
+            {
+                std::cerr << "--speed must be a number >= 0" << std::endl;
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[index], "--batch"))
+        {
+            index++;
+            if (index >= argc)
+            {
+                std::cerr << "--batch requires a value" << std::endl;
+                return 1;
+            }
+            g_batch_path = argv[index];
+        }
+        else if (!strcmp(argv[index], "--workers"))
+        {
+            index++;
+            if (index >= argc)
+            {
+                std::cerr << "--workers requires a value" << std::endl;
+                return 1;
+            }
+            long value = 0;
+            if (!ParseNonNegative(argv[index], &value) || value < 1 || value > INT_MAX)
+            {
+                std::cerr << "--workers must be an integer >= 1" << std::endl;
+                return 1;
+            }
+            g_workers = static_cast<int>(value);
+        }
+        else if (!strcmp(argv[index], "--vqa-cache-mb"))
+        {
+            index++;
+            if (index >= argc)
+            {
+                std::cerr << "--vqa-cache-mb requires a value" << std::endl;
+                return 1;
+            }
+            if (!ParseNonNegative(argv[index], &g_vqa_cache_mb))
+            {
+                std::cerr << "--vqa-cache-mb must be an integer >= 0" << std::endl;
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[index], "--vqa-cache-answers"))
+        {
+            g_vqa_cache_answers = true;
+        }
+        else if (!strcmp(argv[index], "--uplink"))
+        {
+            index++;
+            if (index >= argc)
+            {
+                std::cerr << "--uplink requires a value" << std::endl;
+                return 1;
+            }
+            g_uplink_format = argv[index];
+            if (g_uplink_format != "pcm" && g_uplink_format != "opus")
+            {
+                std::cerr << "--uplink must be pcm or opus" << std::endl;
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[index], "--opus-cache"))
+        {
+            index++;
+            if (index >= argc)
+            {
+                std::cerr << "--opus-cache requires a value" << std::endl;
+                return 1;
+            }
+            g_opus_cache_dir = argv[index];
+        }
+        else if (!strcmp(argv[index], "--transcript-mb"))
+        {
+            index++;
+            if (index >= argc)
+            {
+                std::cerr << "--transcript-mb requires a value" << std::endl;
+                return 1;
+            }
+            if (!ParseNonNegative(argv[index], &g_transcript_mb))
+            {
+                std::cerr << "--transcript-mb must be an integer >= 0" << std::endl;
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[index], "--record"))
+        {
+            index++;
+            if (index >= argc)
+            {
+                std::cerr << "--record requires a value" << std::endl;
+                return 1;
+            }
+            g_record_path = argv[index];
+        }
+        else if (!strcmp(argv[index], "--replay"))
+        {
+            index++;
+            if (index >= argc)
+            {
+                std::cerr << "--replay requires a value" << std::endl;
+                return 1;
+            }
+            g_replay_path = argv[index];
+        }
+        else if (!strcmp(argv[index], "--replay-speed"))
+        {
+            index++;
+            if (index >= argc)
+            {
+                std::cerr << "--replay-speed requires a value" << std::endl;
+                return 1;
+            }
+            if (!ParseNonNegative(argv[index], &g_replay_speed))
+            {
+                std::cerr << "--replay-speed must be a number >= 0" << std::endl;
+                return 1;
+            }
+        }
         else
         {
             std::cout << "unknown arg: " << argv[index] << std::endl;
@@ -119,7 +334,13 @@ int parse_arg(int argc, char *argv[])
         index++;
     }
 
-    if (g_apikey.empty())
+    if (g_workers > 1 && (g_batch_path.empty() || !g_record_path.empty() || !g_replay_path.empty()))
+    {
+        std::cerr << "--workers needs --batch and cannot be combined with --record/--replay" << std::endl;
+        return 1;
+    }
+    // Replay never connects, so it needs no key.
+    if (g_apikey.empty() && g_replay_path.empty())
     {
         std::cerr << "--apikey is required" << std::endl;
         return 1;
@@ -128,22 +349,115 @@ int parse_arg(int argc, char *argv[])
 }
 
 /**
- * @brief 主函数
+ * @brief 回放事件日志并打印吞吐
  */
-int main(int argc, char *argv[])
+static int RunReplay()
 {
-    // Parse command line arguments
-    if (parse_arg(argc, argv))
-    {
-        return -1;
+    std::cout << "replaying " << g_replay_path << " at speed " << g_replay_speed << std::endl;
+    ReplayStats stats;
+    std::string error;
+    bool ok = ReplayEventLog(g_replay_path, g_replay_speed, g_event_dispatcher, &stats, &error);
+    if (!ok) {
+        std::cerr << "replay: " << error << std::endl;
     }
-    std::cout << "parsed apikey: " << g_apikey << std::endl;
-    std::cout << "using url: " << g_url << std::endl;
+    double wall_s = stats.wall_us / 1e6;
+    std::cout << "replay: " << stats.events << " events (" << stats.binary_bytes
+              << " binary bytes) in " << stats.wall_us / 1000 << " ms, recorded span "
+              << stats.media_us / 1000 << " ms, "
+              << static_cast<uint64_t>(wall_s > 0 ? stats.events / wall_s : 0) << " events/s, "
+              << stats.full_waits << " full waits, " << stats.late_events << " late" << std::endl;
+    return ok ? 0 : -1;
+}
 
-    signal(SIGINT, signalHandlerINT);
-    signal(SIGQUIT, signalHandlerQUIT);
+/**
+ * @brief 交互命令行，直到 q 或标准输入结束
+ */
+static void RunCli()
+{
+    // 进入 CLI 等待用户输入指令
+    const char* kCliHelp = "CLI commands: 1=send audio, 2=tts, tts <text>=queue text, 3=vqa, 4=press to talk, 5=release, history=recent transcripts, stats=latency report, q=quit, help=show commands";
+    std::cout << kCliHelp << std::endl;
+    for (std::string cmd;;) {
+        std::cout << ">> " << std::flush;
+        if (!std::getline(std::cin, cmd)) {
+            break;
+        }
+        if (cmd == "1") {
+            // send recorded audio file
+            trigger_audio_send_once(audio_file_path);
+        }else if (cmd == "2") {
+            // request to have tts respond (sentence-split, queued)
+            g_tts_queue.Submit("幸福是一种技能，是你摒弃了外在多余欲望后的内心平和。");
+        }else if (cmd.compare(0, 4, "tts ") == 0) {
+            uint64_t job = g_tts_queue.Submit(cmd.substr(4));
+            if (job) std::cout << "tts job " << job << " queued" << std::endl;
+        }else if(cmd == "3"){
+            // VQA request
+            // replace with your image path
+            std::string image_path = g_image_file_path; 
+            vqa_send_request(image_path);
+        } else if (cmd == "4") {
+            // push-to-talk: start streaming the capture pipeline
+            AudioPipeline* pipeline = GetPipeline();
+            if (pipeline) pipeline->Press();
+        } else if (cmd == "5") {
+            // push-to-talk: stop streaming
+            if (g_pipeline) {
+                g_pipeline->Release();
+                PrintPipelineStats();
+            }
+        } else if (cmd == "history") {
+            g_transcripts.PrintRecent(std::cout, 10);
+        } else if (cmd == "stats") {
+            AsyncLog::Instance().Flush();
+            g_round_tracer.Dump(std::cout);
+        } else if (cmd == "help") {
+            std::cout << kCliHelp << std::endl;
+        } else if (cmd == "q" || cmd == "quit" || cmd == "exit") {
+            break;
+        } else if (!cmd.empty()) {
+            std::cout << "Unknown command: " << cmd << std::endl;
+        }
+    }
+}
 
-    // Create + Connect in a dedicated pthread
+/**
+ * @brief 批量模式：按清单连续执行各轮并打印吞吐
+ */
+static int RunBatch(BatchRunner& batch)
+{
+    bool ok = batch.Run();
+    AsyncLog::Instance().Flush();
+    batch.PrintReport(std::cout);
+    return ok ? 0 : -1;
+}
+
+/**
+ * @brief 登记本次会话需要预加载的素材
+ */
+static void PlanPreload(BatchRunner* batch)
+{
+    if (batch) {
+        std::vector<std::string> audio, images;
+        batch->CollectAssets(&audio, &images);
+        for (const std::string& path : audio) g_startup.AddAudio(path);
+        for (const std::string& path : images) g_startup.AddImage(path);
+    } else {
+        // CLI commands 1 and 3.
+        g_startup.AddAudio(audio_file_path);
+        g_startup.AddImage(g_image_file_path);
+    }
+    g_startup.AddDirectory(g_output_dir);
+    g_startup.SetWorkspace(g_workspace_dir);
+    if (g_uplink_format == "opus") g_startup.SetOpusCache(g_opus_cache_dir);
+}
+
+/**
+ * @brief 建连后进入交互命令行（或执行批量清单），退出时断开连接
+ */
+static int RunSession(BatchRunner* batch)
+{
+    // Create + Connect in a dedicated pthread while this thread preloads.
     pthread_t connect_thread;
     ConnectThreadResult connect_result;
     int cret = pthread_create(&connect_thread, nullptr, &ConnectThreadMain, &connect_result);
@@ -151,9 +465,13 @@ int main(int argc, char *argv[])
         std::cerr << "pthread_create failed: " << cret << std::endl;
         return -1;
     }
+    PlanPreload(batch);
+    g_startup.Run();
     pthread_join(connect_thread, nullptr);
 
     ConvRetCode ret = connect_result.ret;
+    g_startup.Record("connect", connect_result.start, connect_result.end, ret == convsdk::kSuccess);
+    g_startup.PrintBreakdown(std::cout);
     if (ret != convsdk::kSuccess)
     {
         std::cout << "connect failed: " << ret;
@@ -165,42 +483,180 @@ int main(int argc, char *argv[])
     }
 
     std::cout << "connect success: " << std::endl;
-    // 进入 CLI 等待用户输入指令
-    std::cout << "CLI commands: 1=send audio, q=quit, help=show commands" << std::endl;
-    for (std::string cmd;;) {
-        std::cout << ">> " << std::flush;
-        if (!std::getline(std::cin, cmd)) {
-            break;
-        }
-        if (cmd == "1") {
-            // send recorded audio file
-            trigger_audio_send_once(audio_file_path);
-        }else if (cmd == "2") {
-            // request to have tts respond
-            text_to_speech_request("幸福是一种技能，是你摒弃了外在多余欲望后的内心平和。");
-        }else if(cmd == "3"){
-            // VQA request
-            // replace with your image path
-            std::string image_path = g_image_file_path; 
-            vqa_send_request(image_path);
-        } else if (cmd == "help") {
-            std::cout << "CLI commands: 1=send audio, q=quit, help=show commands" << std::endl;
-        } else if (cmd == "q" || cmd == "quit" || cmd == "exit") {
-            break;
-        } else if (!cmd.empty()) {
-            std::cout << "Unknown command: " << cmd << std::endl;
-        }
+    int exit_code = 0;
+    if (batch) {
+        exit_code = RunBatch(*batch);
+    } else {
+        RunCli();
+    }
+
+    if (g_pipeline) {
+        g_pipeline->Stop();
+        PrintPipelineStats();
+        g_pipeline.reset();
     }
 
+    // Abandon queued TTS text; the segment in flight finishes first.
+    g_tts_queue.Stop();
+
     std::cout << "\n 断开连接..." << std::endl;
-    ret = conversation->Disconnect();
+    // 停止重连，断开并销毁Conversation实例，释放资源
+    ret = g_connection.Shutdown();
     if (ret == 0)
     {
         std::cout << "disconnect success" << std::endl;
     }
-    // 销毁Conversation实例，释放资源
-    conversation->DestroyConversation();
-    conversation = NULL;
+    return exit_code;
+}
 
-    return 0;
+/**
+ * @brief 停止分发器、关闭写入器并打印统计
+ */
+static void Shutdown()
+{
+    g_event_dispatcher.Stop();
+    CloseSessionWriters();
+
+    // Let queued log lines out before printing the summaries.
+    AsyncLog::Instance().Flush();
+    g_event_dispatcher.PrintStats(std::cout);
+    g_connection.PrintStats(std::cout);
+    g_vqa_cache.PrintStats(std::cout);
+    g_tts_queue.PrintStats(std::cout);
+    g_transcripts.PrintStats(std::cout);
+    g_dialog_state.PrintStats(std::cout);
+    g_round_tracer.Dump(std::cout);
+    AsyncLog::Stats log_stats = AsyncLog::Instance().GetStats();
+    std::cout << "log: " << log_stats.written << " lines written, " << log_stats.dropped
+              << " dropped, " << log_stats.truncated << " truncated" << std::endl;
+    AsyncLog::Instance().Stop();
+}
+
+/**
+ * @brief 启动日志、信号处理与事件分发线程
+ */
+static void StartRuntime()
+{
+    AsyncLog::Instance().SetLevel(AsyncLog::ParseLevel(g_log_level));
+    AsyncLog::Instance().Start();
+
+    signal(SIGINT, signalHandlerINT);
+    signal(SIGQUIT, signalHandlerQUIT);
+
+    // onMessage only copies events; handlers run on the dispatcher's threads.
+    g_event_dispatcher.Start();
+}
+
+/**
+ * @brief 工作进程：独立的Conversation与输出目录，从共享计数器领取批量轮次
+ */
+static int RunWorker(int index, WorkerPool::Slot* slot, std::atomic<uint64_t>* next_round)
+{
+    g_startup.Begin();
+    g_output_dir = "tmp/worker-" + std::to_string(index);
+    mkdir("tmp", 0755);
+    mkdir(g_output_dir.c_str(), 0755);
+
+    // Console output of each worker goes to its own file.
+    std::string console = g_output_dir + "/console.log";
+    int fd = open(console.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd >= 0) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+    }
+
+    StartRuntime();
+    g_batch->ShareRoundCounter(next_round);
+    int exit_code = RunSession(g_batch.get());
+
+    slot->batch = g_batch->report();
+    slot->traced_rounds = g_round_tracer.Snapshot(slot->tracer);
+    slot->published = 1;
+
+    Shutdown();
+    return exit_code;
+}
+
+/**
+ * @brief 主进程：fork工作进程并汇总指标
+ */
+static int RunSupervisor()
+{
+    std::cout << "starting " << g_workers << " workers, " << g_batch->TotalRounds()
+              << " rounds, output under tmp/worker-<n>/" << std::endl;
+    WorkerPool pool(g_workers);
+    std::string error;
+    bool started = pool.Start(&RunWorker, &error);
+    if (!started) {
+        std::cerr << "workers: " << error << std::endl;
+    }
+    int failed = pool.Wait();
+    pool.PrintReport(std::cout);
+    return started && failed == 0 ? 0 : -1;
+}
+
+/**
+ * @brief 主函数
+ */
+int main(int argc, char *argv[])
+{
+    g_startup.Begin();
+    // Parse command line arguments
+    if (parse_arg(argc, argv))
+    {
+        return -1;
+    }
+    g_vqa_cache.Configure(static_cast<std::size_t>(g_vqa_cache_mb) << 20, g_vqa_cache_answers);
+    g_transcripts.Configure(static_cast<std::size_t>(g_transcript_mb) << 20);
+    if (g_replay_path.empty()) {
+        std::cout << "parsed apikey: " << g_apikey << std::endl;
+        std::cout << "using url: " << g_url << std::endl;
+    }
+
+    // Check the manifest before connecting.
+    if (!g_batch_path.empty()) {
+        std::string error;
+        StartupPreloader::Clock::time_point start = StartupPreloader::Clock::now();
+        g_batch.reset(new BatchRunner());
+        if (!g_batch->Load(g_batch_path, &error)) {
+            std::cerr << "batch: " << error << std::endl;
+            return -1;
+        }
+        g_startup.Record("manifest", start, StartupPreloader::Clock::now(), true);
+    }
+    // Workers are forked before any thread exists in this process.
+    if (g_workers > 1) {
+        return RunSupervisor();
+    }
+
+    StartRuntime();
+
+    if (!g_replay_path.empty()) {
+        int exit_code = RunReplay();
+        Shutdown();
+        return exit_code;
+    }
+    std::unique_ptr<EventLogWriter> recorder;
+    if (!g_record_path.empty()) {
+        recorder.reset(new EventLogWriter(g_record_path));
+        if (!recorder->Open()) {
+            std::cerr << "cannot record to " << g_record_path << std::endl;
+            return -1;
+        }
+        g_event_log = recorder.get();
+    }
+
+    int exit_code = RunSession(g_batch.get());
+    if (recorder) {
+        g_event_log = NULL;
+        recorder->Close();
+        PcmSessionWriter::Stats rst = recorder->GetStats();
+        std::cout << "record: " << recorder->records() << " events, " << rst.bytes_written
+                  << " bytes to " << recorder->path() << ", dropped " << rst.dropped_chunks << std::endl;
+    }
+
+    Shutdown();
+
+    return exit_code;
 }
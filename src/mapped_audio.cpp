@@ -0,0 +1,212 @@
+#include "mapped_audio.h"
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const int MappedAudioFile::kFormatPcm;
+const std::size_t MappedAudioFile::kMaxCachedFiles;
+
+namespace {
+
+const uint16_t kWaveFormatExtensible = 0xFFFE;
+// Size left in the header by writers that cannot seek back to patch it.
+const uint32_t kUnknownSize = 0xFFFFFFFF;
+
+struct CacheEntry {
+    std::shared_ptr<const MappedAudioFile> file;
+    uint64_t last_use;
+};
+
+std::mutex g_cache_lock;
+std::map<std::string, CacheEntry> g_cache;
+uint64_t g_cache_tick = 0;
+
+// Drop the least recently opened mapping once the cache is full.
+void EvictLocked() {
+    while (g_cache.size() > MappedAudioFile::kMaxCachedFiles) {
+        std::map<std::string, CacheEntry>::iterator oldest = g_cache.begin();
+        for (std::map<std::string, CacheEntry>::iterator it = g_cache.begin(); it != g_cache.end(); ++it) {
+            if (it->second.last_use < oldest->second.last_use) oldest = it;
+        }
+        g_cache.erase(oldest);
+    }
+}
+
+uint16_t GetLE16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t GetLE32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+int64_t MtimeNs(const struct stat& st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+void SetError(std::string* error, const std::string& msg) {
+    if (error) *error = msg;
+}
+
+}  // namespace
+
+MappedAudioFile::MappedAudioFile()
+    : base_(nullptr),
+      size_(0),
+      payload_offset_(0),
+      payload_size_(0),
+      is_wav_(false),
+      format_tag_(0),
+      channels_(0),
+      sample_rate_(0),
+      bits_per_sample_(0),
+      dev_(0),
+      ino_(0),
+      file_size_(0),
+      mtime_ns_(0) {}
+
+MappedAudioFile::~MappedAudioFile() {
+    if (base_) {
+        munmap(const_cast<uint8_t*>(base_), size_);
+    }
+}
+
+std::shared_ptr<const MappedAudioFile> MappedAudioFile::Open(const std::string& path,
+                                                             std::string* error) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        SetError(error, "stat " + path + ": " + std::strerror(errno));
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> guard(g_cache_lock);
+    auto it = g_cache.find(path);
+    if (it != g_cache.end()) {
+        const MappedAudioFile& cached = *it->second.file;
+        if (cached.dev_ == st.st_dev && cached.ino_ == st.st_ino &&
+            cached.file_size_ == st.st_size && cached.mtime_ns_ == MtimeNs(st)) {
+            it->second.last_use = ++g_cache_tick;
+            return it->second.file;
+        }
+        g_cache.erase(it);
+    }
+
+    std::shared_ptr<MappedAudioFile> file(new MappedAudioFile());
+    if (!file->Map(path, error) || !file->ParseRiff(error)) {
+        return nullptr;
+    }
+    CacheEntry& entry = g_cache[path];
+    entry.file = file;
+    entry.last_use = ++g_cache_tick;
+    EvictLocked();
+    return file;
+}
+
+void MappedAudioFile::ClearCache() {
+    std::lock_guard<std::mutex> guard(g_cache_lock);
+    g_cache.clear();
+}
+
+bool MappedAudioFile::Map(const std::string& path, std::string* error) {
+    path_ = path;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        SetError(error, "open " + path + ": " + std::strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        SetError(error, "fstat " + path + ": " + std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size <= 0) {
+        SetError(error, path + " is empty");
+        ::close(fd);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // the mapping keeps the file referenced
+    if (addr == MAP_FAILED) {
+        SetError(error, "mmap " + path + ": " + std::strerror(errno));
+        return false;
+    }
+    madvise(addr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    base_ = static_cast<const uint8_t*>(addr);
+    size_ = static_cast<std::size_t>(st.st_size);
+    payload_offset_ = 0;
+    payload_size_ = size_;
+    dev_ = st.st_dev;
+    ino_ = st.st_ino;
+    file_size_ = st.st_size;
+    mtime_ns_ = MtimeNs(st);
+    return true;
+}
+
+bool MappedAudioFile::ParseRiff(std::string* error) {
+    if (size_ < 12 || std::memcmp(base_, "RIFF", 4) != 0 || std::memcmp(base_ + 8, "WAVE", 4) != 0) {
+        return true;  // headerless audio, payload is the whole file
+    }
+
+    bool have_fmt = false;
+    std::size_t pos = 12;
+    while (pos + 8 <= size_) {
+        const uint8_t* chunk = base_ + pos;
+        uint32_t chunk_size = GetLE32(chunk + 4);
+        std::size_t body = pos + 8;
+        std::size_t avail = size_ - body;
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            if (chunk_size < 16 || avail < 16) {
+                SetError(error, path_ + ": truncated fmt chunk");
+                return false;
+            }
+            const uint8_t* f = base_ + body;
+            format_tag_ = GetLE16(f);
+            channels_ = GetLE16(f + 2);
+            sample_rate_ = static_cast<int>(GetLE32(f + 4));
+            bits_per_sample_ = GetLE16(f + 14);
+            // WAVE_FORMAT_EXTENSIBLE: the real format is the first 2 bytes of the SubFormat GUID.
+            if (format_tag_ == kWaveFormatExtensible && chunk_size >= 40 && avail >= 40) {
+                format_tag_ = GetLE16(f + 24);
+            }
+            have_fmt = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) {
+                SetError(error, path_ + ": data chunk before fmt chunk");
+                return false;
+            }
+            // Streaming writers leave the size as 0xFFFFFFFF, or as 0 together
+            // with an unpatched RIFF size; the audio then runs to the end of
+            // the file. Any other 0 is an empty chunk. Sizes past the end
+            // (a truncated file) are clamped.
+            const uint32_t riff_size = GetLE32(base_ + 4);
+            const bool streaming = chunk_size == kUnknownSize ||
+                                   (chunk_size == 0 && (riff_size == 0 || riff_size == kUnknownSize));
+            std::size_t data_size = chunk_size;
+            if (streaming || data_size > avail) data_size = avail;
+            is_wav_ = true;
+            payload_offset_ = body;
+            payload_size_ = data_size;
+            return true;
+        }
+
+        // Chunks are word aligned.
+        std::size_t next = body + chunk_size + (chunk_size & 1);
+        if (next <= pos || next > size_) break;
+        pos = next;
+    }
+
+    SetError(error, path_ + ": RIFF/WAVE without a data chunk");
+    return false;
+}
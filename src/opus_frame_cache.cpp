@@ -0,0 +1,196 @@
+#include "opus_frame_cache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "content_hash.h"
+#include "conversation_utils.h"
+#include "sys_util.h"
+
+namespace {
+const char kMagic[8] = {'C', 'O', 'N', 'V', 'O', 'P', 'U', '2'};
+const uint32_t kVersion = 1;
+const std::size_t kHeaderBytes = 32;
+// Largest opus packet for one frame (RFC 6716: 1275 bytes).
+const int kMaxPacketBytes = 1500;
+
+void PutLe32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+void PutLe64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+uint32_t GetLe32(const uint8_t* p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+uint64_t GetLe64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+void BuildHeader(uint8_t* header, uint32_t count, uint64_t source_hash) {
+    std::memcpy(header, kMagic, sizeof(kMagic));
+    PutLe32(header + 8, kVersion);
+    PutLe32(header + 12, OpusFrameCache::kSampleRate);
+    PutLe32(header + 16, static_cast<uint32_t>(OpusFrameCache::kFrameBytes));
+    PutLe32(header + 20, count);
+    PutLe64(header + 24, source_hash);
+}
+
+std::string BaseName(const std::string& path) {
+    std::size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Map `path` and check it is a cache entry for `source_hash`.
+bool OpenEntry(const std::string& path, uint64_t source_hash, OpusFrameCache::Frames* frames,
+               std::string* error) {
+    std::shared_ptr<const MappedAudioFile> file = MappedAudioFile::Open(path, error);
+    if (!file) return false;
+    const uint8_t* header = file->data();
+    if (file->size() < kHeaderBytes || std::memcmp(header, kMagic, sizeof(kMagic)) != 0 ||
+        GetLe32(header + 8) != kVersion || GetLe32(header + 12) != OpusFrameCache::kSampleRate ||
+        GetLe32(header + 16) != OpusFrameCache::kFrameBytes || GetLe64(header + 24) != source_hash) {
+        *error = path + " is not an opus cache entry for this audio";
+        return false;
+    }
+    const uint32_t count = GetLe32(header + 20);
+    const uint8_t* body = header + kHeaderBytes;
+    const std::size_t body_size = file->size() - kHeaderBytes;
+    std::size_t off = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        std::size_t framed = OpusFrameCache::FramedSize(body + off, body_size - off);
+        if (framed == 0) break;
+        off += framed;
+    }
+    if (off != body_size) {
+        *error = path + " is truncated or corrupt";
+        return false;
+    }
+    frames->file = file;
+    frames->data = body;
+    frames->size = body_size;
+    frames->count = count;
+    frames->path = path;
+    return true;
+}
+
+bool EncodeEntry(const uint8_t* pcm, std::size_t pcm_size, uint64_t source_hash, const std::string& path,
+                 std::string* error) {
+    convsdk::ConversationUtils utils;
+    int code = 0;
+    if (utils.TryCreateAudioEncoder("opus", 1, OpusFrameCache::kSampleRate, &code) != 0) {
+        *error = "cannot create opus encoder (" + std::to_string(code) + ")";
+        return false;
+    }
+    utils.SetFrameSampleBytes(static_cast<int>(OpusFrameCache::kFrameBytes));
+
+    const std::size_t count = (pcm_size + OpusFrameCache::kFrameBytes - 1) / OpusFrameCache::kFrameBytes;
+    std::vector<uint8_t> out(kHeaderBytes);
+    out.reserve(kHeaderBytes + count * 128);
+    uint8_t frame[OpusFrameCache::kFrameBytes];
+    uint8_t packet[kMaxPacketBytes];
+    bool ok = true;
+    for (std::size_t off = 0; off < pcm_size; off += OpusFrameCache::kFrameBytes) {
+        const std::size_t n = std::min(OpusFrameCache::kFrameBytes, pcm_size - off);
+        const uint8_t* input = pcm + off;
+        if (n < OpusFrameCache::kFrameBytes) {
+            std::memcpy(frame, input, n);
+            std::memset(frame + n, 0, sizeof(frame) - n);
+            input = frame;
+        }
+        int len = utils.AudioEncoding(input, static_cast<int>(OpusFrameCache::kFrameBytes), packet,
+                                      sizeof(packet));
+        if (len <= 0 || len > 0xffff) {
+            *error = "opus encoding failed (" + std::to_string(len) + ") at byte " + std::to_string(off);
+            ok = false;
+            break;
+        }
+        out.push_back(static_cast<uint8_t>(len >> 8));
+        out.push_back(static_cast<uint8_t>(len & 0xff));
+        out.insert(out.end(), packet, packet + len);
+    }
+    utils.DestroyAudioEncoder();
+    if (!ok) return false;
+    BuildHeader(&out[0], static_cast<uint32_t>(count), source_hash);
+
+    const std::string tmp = path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream file(tmp.c_str(), std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+        if (!file) {
+            *error = "cannot write " + tmp;
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        *error = "rename " + tmp + ": " + strerror(errno);
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+}
+
+const int OpusFrameCache::kSampleRate;
+const std::size_t OpusFrameCache::kFrameBytes;
+const uint64_t OpusFrameCache::kFrameNs;
+
+std::size_t OpusFrameCache::FramedSize(const uint8_t* data, std::size_t available) {
+    if (available < 2) return 0;
+    const std::size_t len = (static_cast<std::size_t>(data[0]) << 8) | data[1];
+    return len > 0 && len + 2 <= available ? len + 2 : 0;
+}
+
+bool OpusFrameCache::Load(const std::string& pcm_path, const std::string& cache_dir, Frames* frames,
+                          std::string* error) {
+    std::string why;
+    std::shared_ptr<const MappedAudioFile> source = MappedAudioFile::Open(pcm_path, &why);
+    if (!source) {
+        *error = pcm_path + ": " + why;
+        return false;
+    }
+    if (source->is_wav() && (source->format_tag() != MappedAudioFile::kFormatPcm || source->channels() != 1 ||
+                             source->sample_rate() != kSampleRate || source->bits_per_sample() != 16)) {
+        *error = pcm_path + " is not 16 kHz mono 16-bit PCM";
+        return false;
+    }
+    if (source->payload_size() == 0) {
+        *error = pcm_path + " has no audio";
+        return false;
+    }
+
+    const uint64_t hash = ContentHash64(source->payload(), source->payload_size());
+    char suffix[24];
+    std::snprintf(suffix, sizeof(suffix), ".%016llx.opu2", static_cast<unsigned long long>(hash));
+    const std::string path = cache_dir + "/" + BaseName(pcm_path) + suffix;
+
+    *frames = Frames();
+    frames->pcm_bytes = source->payload_size();
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && OpenEntry(path, hash, frames, &why)) return true;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!MakeDirs(cache_dir, error)) return false;
+    if (!EncodeEntry(source->payload(), source->payload_size(), hash, path, error)) return false;
+    if (!OpenEntry(path, hash, frames, error)) return false;
+    frames->pcm_bytes = source->payload_size();
+    frames->encoded = true;
+    frames->encode_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                  std::chrono::steady_clock::now() - start).count());
+    return true;
+}
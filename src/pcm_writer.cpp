@@ -0,0 +1,268 @@
+#include "pcm_writer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "async_log.h"
+
+namespace {
+// Upper bound of iovecs handed to a single writev() call.
+const std::size_t kMaxIovPerWrite = 64;
+const std::size_t kWavHeaderSize = 44;
+
+void PutLE16(unsigned char* p, uint16_t v) {
+    p[0] = static_cast<unsigned char>(v & 0xff);
+    p[1] = static_cast<unsigned char>((v >> 8) & 0xff);
+}
+
+void PutLE32(unsigned char* p, uint32_t v) {
+    p[0] = static_cast<unsigned char>(v & 0xff);
+    p[1] = static_cast<unsigned char>((v >> 8) & 0xff);
+    p[2] = static_cast<unsigned char>((v >> 16) & 0xff);
+    p[3] = static_cast<unsigned char>((v >> 24) & 0xff);
+}
+
+bool PwriteAll(int fd, const unsigned char* data, std::size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, data, size, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+}
+
+PcmSessionWriter::PcmSessionWriter(const std::string& path,
+                                   Container container,
+                                   int sample_rate,
+                                   int channels,
+                                   std::size_t max_queued_chunks)
+    : path_(path),
+      container_(container),
+      sample_rate_(sample_rate),
+      channels_(channels > 0 ? channels : 1),
+      data_bytes_(0),
+      max_queued_chunks_(max_queued_chunks > 0 ? max_queued_chunks : 1),
+      fd_(-1),
+      running_(false) {}
+
+PcmSessionWriter::~PcmSessionWriter() {
+    Close();
+}
+
+bool PcmSessionWriter::Open() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (running_) return true;
+
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        LOGE("PcmSessionWriter: failed to open %s: %s", path_.c_str(), std::strerror(errno));
+        return false;
+    }
+    if (container_ == kContainerWav && !WriteWavHeader()) {
+        LOGE("PcmSessionWriter: failed to write WAV header to %s: %s", path_.c_str(), std::strerror(errno));
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    running_ = true;
+    io_thread_ = std::thread(&PcmSessionWriter::IoThreadMain, this);
+    return true;
+}
+
+bool PcmSessionWriter::Push(const unsigned char* data, std::size_t size) {
+    if (!data || size == 0) return true;
+
+    std::unique_lock<std::mutex> guard(lock_);
+    if (!running_ || queue_.size() >= max_queued_chunks_) {
+        stats_.dropped_chunks++;
+        return false;
+    }
+
+    std::vector<unsigned char> buf;
+    if (!free_buffers_.empty()) {
+        buf.swap(free_buffers_.back());
+        free_buffers_.pop_back();
+    }
+    if (buf.capacity() >= size) {
+        stats_.allocations_avoided++;
+    } else {
+        stats_.buffer_allocations++;
+    }
+    buf.assign(data, data + size);
+    stats_.bytes_copied += size;
+    queue_.push_back(std::vector<unsigned char>());
+    queue_.back().swap(buf);
+    guard.unlock();
+    cv_.notify_one();
+    return true;
+}
+
+bool PcmSessionWriter::Push(std::vector<unsigned char>& buf) {
+    if (buf.empty()) return true;
+
+    std::unique_lock<std::mutex> guard(lock_);
+    if (!running_ || queue_.size() >= max_queued_chunks_) {
+        stats_.dropped_chunks++;
+        return false;
+    }
+    stats_.bytes_copied += buf.size();
+    queue_.push_back(std::vector<unsigned char>());
+    queue_.back().swap(buf);
+    // The caller refills `buf` next time; it only allocates if we have no
+    // recycled buffer to give back.
+    if (!free_buffers_.empty()) {
+        buf.swap(free_buffers_.back());
+        free_buffers_.pop_back();
+        stats_.allocations_avoided++;
+    } else {
+        stats_.buffer_allocations++;
+    }
+    buf.clear();
+    guard.unlock();
+    cv_.notify_one();
+    return true;
+}
+
+void PcmSessionWriter::Close() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_one();
+    if (io_thread_.joinable()) {
+        io_thread_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+PcmSessionWriter::Stats PcmSessionWriter::GetStats() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return stats_;
+}
+
+void PcmSessionWriter::IoThreadMain() {
+    std::deque<std::vector<unsigned char> > batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            cv_.wait(guard, [this]() { return !running_ || !queue_.empty(); });
+            if (queue_.empty() && !running_) break;
+            batch.swap(queue_);
+        }
+
+        WriteBatch(batch);
+        RecycleBuffers(batch);
+        if (container_ == kContainerWav && !PatchWavSizes()) {
+            LOGE("PcmSessionWriter: failed to patch WAV header of %s: %s", path_.c_str(), std::strerror(errno));
+        }
+    }
+}
+
+bool PcmSessionWriter::WriteBatch(std::deque<std::vector<unsigned char> >& batch) {
+    std::size_t next = 0;
+    uint64_t bytes = 0;
+    uint64_t chunks = 0;
+    bool ok = true;
+
+    while (next < batch.size() && ok) {
+        struct iovec iov[kMaxIovPerWrite];
+        int iovcnt = 0;
+        for (; next < batch.size() && iovcnt < static_cast<int>(kMaxIovPerWrite); ++next) {
+            iov[iovcnt].iov_base = batch[next].data();
+            iov[iovcnt].iov_len = batch[next].size();
+            iovcnt++;
+        }
+
+        // writev() may write partially; advance through the iovec array until done.
+        struct iovec* cur = iov;
+        int left = iovcnt;
+        while (left > 0) {
+            ssize_t n = ::writev(fd_, cur, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                LOGE("PcmSessionWriter: writev failed for %s: %s", path_.c_str(), std::strerror(errno));
+                ok = false;
+                break;
+            }
+            bytes += static_cast<uint64_t>(n);
+            while (left > 0 && static_cast<std::size_t>(n) >= cur->iov_len) {
+                n -= static_cast<ssize_t>(cur->iov_len);
+                cur++;
+                left--;
+                chunks++;
+            }
+            if (left > 0 && n > 0) {
+                cur->iov_base = static_cast<char*>(cur->iov_base) + n;
+                cur->iov_len -= static_cast<std::size_t>(n);
+            }
+        }
+    }
+
+    data_bytes_ += bytes;
+
+    std::lock_guard<std::mutex> guard(lock_);
+    stats_.chunks_written += chunks;
+    stats_.bytes_written += bytes;
+    stats_.batches++;
+    if (!ok) stats_.write_errors++;
+    return ok;
+}
+
+void PcmSessionWriter::RecycleBuffers(std::deque<std::vector<unsigned char> >& batch) {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        if (free_buffers_.size() >= max_queued_chunks_) break;
+        free_buffers_.push_back(std::vector<unsigned char>());
+        free_buffers_.back().swap(batch[i]);
+    }
+    batch.clear();
+}
+
+bool PcmSessionWriter::WriteWavHeader() {
+    const uint16_t bits_per_sample = 16;
+    const uint16_t block_align = static_cast<uint16_t>(channels_ * bits_per_sample / 8);
+    const uint32_t byte_rate = static_cast<uint32_t>(sample_rate_) * block_align;
+
+    unsigned char h[kWavHeaderSize];
+    std::memcpy(h, "RIFF", 4);
+    PutLE32(h + 4, 36);  // patched as data arrives
+    std::memcpy(h + 8, "WAVE", 4);
+    std::memcpy(h + 12, "fmt ", 4);
+    PutLE32(h + 16, 16);
+    PutLE16(h + 20, 1);  // PCM
+    PutLE16(h + 22, static_cast<uint16_t>(channels_));
+    PutLE32(h + 24, static_cast<uint32_t>(sample_rate_));
+    PutLE32(h + 28, byte_rate);
+    PutLE16(h + 32, block_align);
+    PutLE16(h + 34, bits_per_sample);
+    std::memcpy(h + 36, "data", 4);
+    PutLE32(h + 40, 0);  // patched as data arrives
+
+    if (!PwriteAll(fd_, h, sizeof(h), 0)) return false;
+    return ::lseek(fd_, static_cast<off_t>(kWavHeaderSize), SEEK_SET) >= 0;
+}
+
+bool PcmSessionWriter::PatchWavSizes() {
+    // RIFF sizes are 32 bit; clamp rather than wrap for very long sessions.
+    uint64_t data = data_bytes_;
+    if (data > 0xffffffffULL - 36) data = 0xffffffffULL - 36;
+
+    unsigned char riff[4];
+    unsigned char size[4];
+    PutLE32(riff, static_cast<uint32_t>(36 + data));
+    PutLE32(size, static_cast<uint32_t>(data));
+    return PwriteAll(fd_, riff, 4, 4) && PwriteAll(fd_, size, 4, 40);
+}
@@ -0,0 +1,281 @@
+#include "response_fields.h"
+
+#include <cstdint>
+#include <cstring>
+
+void ResponseFields::Clear() {
+    text.clear();
+    round_id.clear();
+    content_type.clear();
+    has_text = false;
+    finished = false;
+}
+
+namespace {
+enum FieldBit {
+    kFieldText = 1,
+    kFieldFinished = 2,
+    kFieldRoundId = 4,
+    kFieldContentType = 8,
+    kAllFields = 15,
+};
+
+// Depth of the objects on the way to the fields: {} -> payload -> output.
+enum Level { kLevelRoot, kLevelPayload, kLevelOutput };
+
+bool KeyIs(const char* key, std::size_t len, const char* literal) {
+    return std::strlen(literal) == len && std::memcmp(key, literal, len) == 0;
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void AppendUtf8(std::string* out, uint32_t cp) {
+    if (cp < 0x80) {
+        out->push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out->push_back(static_cast<char>(0xc0 | (cp >> 6)));
+        out->push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+        out->push_back(static_cast<char>(0xe0 | (cp >> 12)));
+        out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+        out->push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    } else {
+        out->push_back(static_cast<char>(0xf0 | (cp >> 18)));
+        out->push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+        out->push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+        out->push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    }
+}
+
+class Scanner {
+ public:
+    Scanner(const char* json, std::size_t len, ResponseFields* fields)
+        : p_(json), end_(json + len), fields_(fields), found_(0), done_(false) {}
+
+    bool Run() {
+        SkipSpace();
+        return ScanObject(kLevelRoot);
+    }
+
+ private:
+    void SkipSpace() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) ++p_;
+    }
+
+    bool Consume(char c) {
+        SkipSpace();
+        if (p_ >= end_ || *p_ != c) return false;
+        ++p_;
+        return true;
+    }
+
+    // String at p_ (on the opening quote). Without `out` it is only skipped;
+    // with it, unescaped into `out` (replacing its contents).
+    bool ReadString(std::string* out) {
+        if (p_ >= end_ || *p_ != '"') return false;
+        ++p_;
+        if (out) out->clear();
+        for (;;) {
+            const char* quote = static_cast<const char*>(std::memchr(p_, '"', end_ - p_));
+            if (!quote) return false;
+            const char* escape = static_cast<const char*>(std::memchr(p_, '\\', quote - p_));
+            if (!escape) {
+                if (out) out->append(p_, quote - p_);
+                p_ = quote + 1;
+                return true;
+            }
+            if (out) out->append(p_, escape - p_);
+            p_ = escape + 1;
+            if (p_ >= end_) return false;
+            if (!out) {
+                ++p_;
+            } else if (!ReadEscape(out)) {
+                return false;
+            }
+        }
+    }
+
+    // Escape after the backslash, p_ on its letter.
+    bool ReadEscape(std::string* out) {
+        const char c = *p_++;
+        switch (c) {
+        case '"': out->push_back('"'); return true;
+        case '\\': out->push_back('\\'); return true;
+        case '/': out->push_back('/'); return true;
+        case 'b': out->push_back('\b'); return true;
+        case 'f': out->push_back('\f'); return true;
+        case 'n': out->push_back('\n'); return true;
+        case 'r': out->push_back('\r'); return true;
+        case 't': out->push_back('\t'); return true;
+        case 'u': break;
+        default: return false;
+        }
+        uint32_t cp = 0;
+        if (!ReadHex4(&cp)) return false;
+        if (cp >= 0xd800 && cp <= 0xdbff) {
+            // Surrogate pair: the low half must follow as another \u escape.
+            uint32_t low = 0;
+            if (end_ - p_ >= 6 && p_[0] == '\\' && p_[1] == 'u') {
+                const char* save = p_;
+                p_ += 2;
+                if (ReadHex4(&low) && low >= 0xdc00 && low <= 0xdfff) {
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                } else {
+                    p_ = save;
+                    cp = 0xfffd;
+                }
+            } else {
+                cp = 0xfffd;
+            }
+        } else if (cp >= 0xdc00 && cp <= 0xdfff) {
+            cp = 0xfffd;
+        }
+        AppendUtf8(out, cp);
+        return true;
+    }
+
+    bool ReadHex4(uint32_t* cp) {
+        if (end_ - p_ < 4) return false;
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            int digit = HexValue(p_[i]);
+            if (digit < 0) return false;
+            value = (value << 4) | static_cast<uint32_t>(digit);
+        }
+        p_ += 4;
+        *cp = value;
+        return true;
+    }
+
+    // Skip one value of any type without decoding it.
+    bool SkipValue() {
+        SkipSpace();
+        if (p_ >= end_) return false;
+        if (*p_ == '"') return ReadString(NULL);
+        if (*p_ != '{' && *p_ != '[') {
+            // Scalar: runs up to the next delimiter.
+            const char* start = p_;
+            while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' && *p_ != ' ' &&
+                   *p_ != '\n' && *p_ != '\r' && *p_ != '\t') {
+                ++p_;
+            }
+            return p_ > start;
+        }
+        int depth = 0;
+        while (p_ < end_) {
+            const char c = *p_;
+            if (c == '"') {
+                if (!ReadString(NULL)) return false;
+                continue;
+            }
+            ++p_;
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) return true;
+            }
+        }
+        return false;
+    }
+
+    bool ReadLiteral(const char* literal) {
+        const std::size_t len = std::strlen(literal);
+        if (static_cast<std::size_t>(end_ - p_) < len || std::memcmp(p_, literal, len) != 0) return false;
+        p_ += len;
+        return true;
+    }
+
+    // A wanted string member: strings are decoded, null reads as empty, any
+    // other type is skipped and leaves the field unset.
+    bool ReadStringField(std::string* out, int bit) {
+        if (p_ < end_ && *p_ == '"') {
+            if (!ReadString(out)) return false;
+        } else if (p_ < end_ && *p_ == 'n') {
+            if (!ReadLiteral("null")) return false;
+            out->clear();
+        } else {
+            return SkipValue();
+        }
+        found_ |= bit;
+        return true;
+    }
+
+    bool ReadMember(Level level, const char* key, std::size_t key_len) {
+        SkipSpace();
+        if (p_ >= end_) return false;
+        const bool object = *p_ == '{';
+        if (level == kLevelRoot && object && KeyIs(key, key_len, "payload")) return ScanObject(kLevelPayload);
+        if (level == kLevelPayload && object && KeyIs(key, key_len, "output")) {
+            if (!ScanObject(kLevelOutput)) return false;
+            done_ = true;  // nothing outside output is wanted
+            return true;
+        }
+        if (level != kLevelOutput) return SkipValue();
+
+        if (KeyIs(key, key_len, "text")) {
+            if (!ReadStringField(&fields_->text, kFieldText)) return false;
+            fields_->has_text = (found_ & kFieldText) != 0;
+            return true;
+        }
+        if (KeyIs(key, key_len, "round_id")) return ReadStringField(&fields_->round_id, kFieldRoundId);
+        if (KeyIs(key, key_len, "content_type")) return ReadStringField(&fields_->content_type, kFieldContentType);
+        if (KeyIs(key, key_len, "finished")) {
+            if (ReadLiteral("true")) {
+                fields_->finished = true;
+            } else if (ReadLiteral("false")) {
+                fields_->finished = false;
+            } else {
+                return SkipValue();
+            }
+            found_ |= kFieldFinished;
+            return true;
+        }
+        return SkipValue();
+    }
+
+    bool ScanObject(Level level) {
+        if (!Consume('{')) return false;
+        SkipSpace();
+        if (p_ < end_ && *p_ == '}') {
+            ++p_;
+            return true;
+        }
+        for (;;) {
+            SkipSpace();
+            // Keys are matched raw: the wanted ones contain no escapes.
+            const char* key = p_ + 1;
+            if (!ReadString(NULL)) return false;
+            const std::size_t key_len = static_cast<std::size_t>(p_ - 1 - key);
+            if (!Consume(':')) return false;
+            if (!ReadMember(level, key, key_len)) return false;
+            if (done_ || found_ == kAllFields) {
+                done_ = true;
+                return true;
+            }
+            SkipSpace();
+            if (p_ >= end_) return false;
+            const char c = *p_++;
+            if (c == '}') return true;
+            if (c != ',') return false;
+        }
+    }
+
+    const char* p_;
+    const char* end_;
+    ResponseFields* fields_;
+    int found_;
+    bool done_;
+};
+}
+
+bool ExtractResponseFields(const char* json, std::size_t len, ResponseFields* fields) {
+    fields->Clear();
+    if (!json) return false;
+    Scanner scanner(json, len, fields);
+    return scanner.Run();
+}
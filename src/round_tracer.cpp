@@ -0,0 +1,170 @@
+#include "round_tracer.h"
+
+#include <iomanip>
+
+#include "async_log.h"
+
+RoundTracer::RoundTracer() : rounds_(0), downlink_total_(0) {
+    current_.Clear();
+}
+
+void RoundTracer::Timeline::Clear() {
+    round_id.clear();
+    dialog_id.clear();
+    for (int i = 0; i < kNumTracePoints; ++i) has[i] = false;
+    downlink_bytes = 0;
+    active = false;
+}
+
+RoundTracer::Timeline* RoundTracer::RoundFor(TracePoint point, const std::string& round_id,
+                                            const std::string& dialog_id) {
+    if (point == kTraceIdle) {
+        // IDLE closes whatever round is in flight. One with no round behind
+        // it (the IDLE after connecting, or a repeated one) is not a round.
+        if (!current_.active || current_.has[kTraceIdle]) return NULL;
+        return &current_;
+    }
+    bool new_round = false;
+    if (current_.active) {
+        if (point == kTraceRequestSent) {
+            // Client starts a new round.
+            new_round = true;
+        } else if (!round_id.empty() && !current_.round_id.empty() && round_id != current_.round_id) {
+            new_round = true;
+        } else if (current_.has[kTraceIdle] && round_id.empty()) {
+            // Anonymous mark after the previous round went back to IDLE.
+            new_round = point != kTraceFirstBinary;
+        }
+    }
+    if (new_round) Finalize();
+
+    current_.active = true;
+    if (current_.round_id.empty() && !round_id.empty()) current_.round_id = round_id;
+    if (current_.dialog_id.empty() && !dialog_id.empty()) current_.dialog_id = dialog_id;
+    return &current_;
+}
+
+void RoundTracer::Mark(TracePoint point, const std::string& round_id, const std::string& dialog_id,
+                       Clock::time_point when) {
+    std::lock_guard<std::mutex> guard(lock_);
+    Timeline* t = RoundFor(point, round_id, dialog_id);
+    if (!t) return;
+    // Keep the first occurrence, except for the last audio packet.
+    if (!t->has[point] || point == kTraceLastAudioSent) {
+        t->has[point] = true;
+        t->at[point] = when;
+    }
+}
+
+void RoundTracer::AddDownlink(std::size_t bytes, const std::string& round_id,
+                              const std::string& dialog_id, Clock::time_point when) {
+    std::lock_guard<std::mutex> guard(lock_);
+    Timeline* t = RoundFor(kTraceFirstBinary, round_id, dialog_id);
+    if (!t->has[kTraceFirstBinary]) {
+        t->has[kTraceFirstBinary] = true;
+        t->at[kTraceFirstBinary] = when;
+    }
+    t->downlink_bytes += bytes;
+    downlink_total_ += bytes;
+}
+
+void RoundTracer::RecordSpan(Metric metric, TracePoint from, TracePoint to) {
+    if (!current_.has[from] || !current_.has[to]) return;
+    Clock::duration d = current_.at[to] - current_.at[from];
+    if (d < Clock::duration::zero()) return;
+    histograms_[metric].Record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(d).count()));
+}
+
+void RoundTracer::Finalize() {
+    if (!current_.active) return;
+    const Timeline& t = current_;
+
+    RecordSpan(kMetricUpload, kTraceRequestSent, kTraceLastAudioSent);
+    RecordSpan(kMetricEosToSentenceEnd, kTraceLastAudioSent, kTraceSentenceEnd);
+    RecordSpan(kMetricEosToThinking, kTraceLastAudioSent, kTraceThinking);
+    RecordSpan(kMetricEosToResponse, kTraceLastAudioSent, kTraceOutputStarted);
+    // Text requests (TTS/VQA) have no audio upload; measure from the request.
+    RecordSpan(kMetricTimeToAudio, t.has[kTraceLastAudioSent] ? kTraceLastAudioSent : kTraceRequestSent,
+               kTraceFirstBinary);
+    RecordSpan(kMetricOutputDuration, kTraceFirstBinary, kTraceOutputCompleted);
+
+    Clock::time_point first = Clock::time_point::max();
+    for (int i = 0; i < kNumTracePoints; ++i) {
+        if (t.has[i] && t.at[i] < first) first = t.at[i];
+    }
+    if (t.has[kTraceIdle] && first < t.at[kTraceIdle]) {
+        histograms_[kMetricRoundTotal].Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(t.at[kTraceIdle] - first).count()));
+    }
+    if (t.has[kTraceFirstBinary] && t.has[kTraceOutputCompleted] && t.downlink_bytes > 0) {
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                         t.at[kTraceOutputCompleted] - t.at[kTraceFirstBinary]).count();
+        if (us > 0) {
+            histograms_[kMetricTtsThroughput].Record(t.downlink_bytes * 1000000ULL / static_cast<uint64_t>(us));
+        }
+    }
+
+    LOGI("round %s/%s finished: %llu downlink bytes", t.dialog_id.c_str(), t.round_id.c_str(),
+         (unsigned long long)t.downlink_bytes);
+    rounds_++;
+    current_.Clear();
+}
+
+uint64_t RoundTracer::RoundsCompleted() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return rounds_;
+}
+
+uint64_t RoundTracer::DownlinkBytes() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return downlink_total_;
+}
+
+LatencyHistogram RoundTracer::Histogram(Metric metric) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return histograms_[metric];
+}
+
+const char* RoundTracer::MetricName(Metric metric) {
+    static const char* kNames[kNumMetrics] = {
+        "upload", "eos_to_sentence_end", "eos_to_thinking", "eos_to_response",
+        "time_to_audio", "output_duration", "round_total", "tts_throughput",
+    };
+    return metric >= 0 && metric < kNumMetrics ? kNames[metric] : "unknown";
+}
+
+void RoundTracer::Dump(std::ostream& os) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (current_.active && current_.has[kTraceIdle]) Finalize();
+    PrintHistograms(os, histograms_, rounds_);
+}
+
+uint64_t RoundTracer::Snapshot(LatencyHistogram out[kNumMetrics]) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (current_.active && current_.has[kTraceIdle]) Finalize();
+    for (int i = 0; i < kNumMetrics; ++i) out[i] = histograms_[i];
+    return rounds_;
+}
+
+void RoundTracer::PrintHistograms(std::ostream& os, const LatencyHistogram hist[kNumMetrics],
+                                  uint64_t rounds) {
+    os << "round latency (" << rounds << " rounds; ms, throughput in bytes/s):" << std::endl;
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+    for (int i = 0; i < kNumMetrics; ++i) {
+        const LatencyHistogram& h = hist[i];
+        if (h.Count() == 0) continue;
+        // Throughput is already in its final unit; latencies are in us.
+        double scale = i == kMetricTtsThroughput ? 1.0 : 1000.0;
+        os << "  " << std::left << std::setw(20) << MetricName(static_cast<Metric>(i)) << std::right
+           << " n=" << h.Count()
+           << " p50=" << h.Percentile(50) / scale
+           << " p90=" << h.Percentile(90) / scale
+           << " p99=" << h.Percentile(99) / scale
+           << " max=" << h.Max() / scale << std::endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
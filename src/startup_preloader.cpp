@@ -0,0 +1,246 @@
+#include "startup_preloader.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "async_log.h"
+#include "audio_handler.h"
+#include "conversation_handler.h"
+#include "mapped_audio.h"
+#include "opus_frame_cache.h"
+#include "sys_util.h"
+
+namespace {
+
+// Uplink format expected from WAV inputs.
+const int kUplinkSampleRate = 16000;
+// Bound the workspace walk; the resource tree is a few dozen model files.
+const int kMaxWorkspaceDepth = 4;
+const int kMaxWorkspaceFiles = 4096;
+
+// Fault every page of the mapping in now rather than on the first send.
+void Prefault(const MappedAudioFile& file) {
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) page = 4096;
+    madvise(const_cast<uint8_t*>(file.data()), file.size(), MADV_WILLNEED);
+    volatile uint8_t sink = 0;
+    for (std::size_t off = 0; off < file.size(); off += static_cast<std::size_t>(page)) {
+        sink ^= file.data()[off];
+    }
+    (void)sink;
+}
+
+// posix_fadvise(WILLNEED) every regular file below `dir`.
+void ReadAheadTree(const std::string& dir, int depth, int* files, uint64_t* bytes) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+    while (struct dirent* entry = readdir(d)) {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+        if (*files >= kMaxWorkspaceFiles) break;
+        std::string path = dir + "/" + entry->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            if (depth < kMaxWorkspaceDepth) ReadAheadTree(path, depth + 1, files, bytes);
+        } else if (S_ISREG(st.st_mode)) {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            close(fd);
+            (*files)++;
+            *bytes += static_cast<uint64_t>(st.st_size);
+        }
+    }
+    closedir(d);
+}
+
+}  // namespace
+
+StartupPreloader::StartupPreloader() : begin_(Clock::now()) {}
+
+void StartupPreloader::AddUnique(std::vector<std::string>* list, const std::string& path) {
+    if (path.empty()) return;
+    if (std::find(list->begin(), list->end(), path) == list->end()) list->push_back(path);
+}
+
+void StartupPreloader::AddAudio(const std::string& path) { AddUnique(&audio_, path); }
+void StartupPreloader::AddImage(const std::string& path) { AddUnique(&images_, path); }
+void StartupPreloader::AddDirectory(const std::string& path) { AddUnique(&dirs_, path); }
+void StartupPreloader::SetWorkspace(const std::string& path) { workspace_ = path; }
+void StartupPreloader::SetOpusCache(const std::string& dir) { opus_cache_ = dir; }
+
+void StartupPreloader::Begin() {
+    std::lock_guard<std::mutex> guard(lock_);
+    begin_ = Clock::now();
+    phases_.clear();
+}
+
+bool StartupPreloader::Run() {
+    if (!audio_.empty()) RunPhase("audio corpus", &StartupPreloader::LoadAudio);
+    if (!audio_.empty() && !opus_cache_.empty()) RunPhase("opus frames", &StartupPreloader::LoadOpusFrames);
+    if (!images_.empty()) RunPhase("vqa image", &StartupPreloader::EncodeImages);
+    if (!dirs_.empty()) RunPhase("output dirs", &StartupPreloader::MakeDirectories);
+    if (!workspace_.empty()) RunPhase("sdk workspace", &StartupPreloader::ReadAheadWorkspace);
+
+    std::lock_guard<std::mutex> guard(lock_);
+    for (std::size_t i = 0; i < phases_.size(); ++i) {
+        if (!phases_[i].ok) return false;
+    }
+    return true;
+}
+
+void StartupPreloader::RunPhase(const std::string& name, bool (StartupPreloader::*step)(std::string*)) {
+    Clock::time_point start = Clock::now();
+    std::string detail;
+    bool ok = (this->*step)(&detail);
+    Record(name, start, Clock::now(), ok, detail);
+    if (!ok) LOGW("startup: %s: %s", name.c_str(), detail.c_str());
+}
+
+bool StartupPreloader::LoadAudio(std::string* detail) {
+    uint64_t bytes = 0;
+    int loaded = 0;
+    std::string error;
+    for (std::size_t i = 0; i < audio_.size(); ++i) {
+        std::string why;
+        std::shared_ptr<const MappedAudioFile> file = MappedAudioFile::Open(audio_[i], &why);
+        if (file && file->is_wav() &&
+            (file->sample_rate() != kUplinkSampleRate || file->channels() != 1 || file->bits_per_sample() != 16)) {
+            why = audio_[i] + " is not 16 kHz mono 16-bit";
+            file.reset();
+        } else if (file && file->payload_size() % 2 != 0) {
+            why = audio_[i] + " has an odd number of bytes";
+            file.reset();
+        }
+        if (!file) {
+            if (error.empty()) error = why;
+            continue;
+        }
+        // The mapping stays in MappedAudioFile's cache for the sends.
+        Prefault(*file);
+        bytes += file->size();
+        loaded++;
+    }
+    std::ostringstream oss;
+    oss << loaded << "/" << audio_.size() << " files, " << bytes / 1024 << " KB";
+    if (!error.empty()) oss << "; " << error;
+    *detail = oss.str();
+    return error.empty();
+}
+
+bool StartupPreloader::LoadOpusFrames(std::string* detail) {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    int encoded = 0;
+    std::string error;
+    for (std::size_t i = 0; i < audio_.size(); ++i) {
+        OpusFrameCache::Frames frames;
+        std::string why;
+        if (!OpusFrameCache::Load(audio_[i], opus_cache_, &frames, &why)) {
+            if (error.empty()) error = why;
+            continue;
+        }
+        packets += frames.count;
+        bytes += frames.size;
+        if (frames.encoded) encoded++;
+    }
+    std::ostringstream oss;
+    oss << packets << " packets, " << bytes / 1024 << " KB, " << encoded << "/" << audio_.size() << " encoded now";
+    if (!error.empty()) oss << "; " << error;
+    *detail = oss.str();
+    return error.empty();
+}
+
+bool StartupPreloader::EncodeImages(std::string* detail) {
+    std::size_t encoded = 0;
+    int loaded = 0;
+    std::string error;
+    for (std::size_t i = 0; i < images_.size(); ++i) {
+        std::size_t size = 0;
+        if (!preload_vqa_image(images_[i], &size)) {
+            if (error.empty()) error = "cannot encode " + images_[i];
+            continue;
+        }
+        encoded += size;
+        loaded++;
+    }
+    std::ostringstream oss;
+    oss << loaded << "/" << images_.size() << " images, " << encoded / 1024 << " KB of requests";
+    if (!error.empty()) oss << "; " << error;
+    *detail = oss.str();
+    return error.empty();
+}
+
+bool StartupPreloader::MakeDirectories(std::string* detail) {
+    for (std::size_t i = 0; i < dirs_.size(); ++i) {
+        if (!MakeDirs(dirs_[i], detail)) return false;
+    }
+    *detail = dirs_.size() == 1 ? dirs_[0] : std::to_string(dirs_.size()) + " dirs";
+    return true;
+}
+
+bool StartupPreloader::ReadAheadWorkspace(std::string* detail) {
+    struct stat st;
+    if (stat(workspace_.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        // The SDK reports a missing workspace itself when it needs one.
+        *detail = "not present, skipped";
+        return true;
+    }
+    int files = 0;
+    uint64_t bytes = 0;
+    ReadAheadTree(workspace_, 0, &files, &bytes);
+    std::ostringstream oss;
+    oss << files << " files, " << bytes / 1024 << " KB read ahead";
+    *detail = oss.str();
+    return true;
+}
+
+void StartupPreloader::Record(const std::string& name, Clock::time_point start, Clock::time_point end,
+                              bool ok, const std::string& detail) {
+    std::lock_guard<std::mutex> guard(lock_);
+    Phase phase;
+    phase.name = name;
+    phase.start_us = ElapsedUs(begin_, start);
+    phase.us = ElapsedUs(start, end);
+    phase.ok = ok;
+    phase.detail = detail;
+    phases_.push_back(phase);
+}
+
+std::vector<StartupPreloader::Phase> StartupPreloader::phases() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return phases_;
+}
+
+void StartupPreloader::PrintBreakdown(std::ostream& os) const {
+    std::vector<Phase> list = phases();
+    std::sort(list.begin(), list.end(), [](const Phase& a, const Phase& b) { return a.start_us < b.start_us; });
+    uint64_t ready_us = 0;
+    uint64_t serial_us = 0;
+    for (std::size_t i = 0; i < list.size(); ++i) {
+        ready_us = std::max(ready_us, list[i].start_us + list[i].us);
+        serial_us += list[i].us;
+    }
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+    os << "startup: ready in " << ready_us / 1000.0 << " ms (phases run one after another: "
+       << serial_us / 1000.0 << " ms)" << std::endl;
+    for (std::size_t i = 0; i < list.size(); ++i) {
+        const Phase& p = list[i];
+        os << "  " << std::left << std::setw(14) << p.name << std::right
+           << " +" << std::setw(7) << p.start_us / 1000.0
+           << " " << std::setw(8) << p.us / 1000.0 << " ms  " << (p.ok ? "ok" : "FAILED");
+        if (!p.detail.empty()) os << "  " << p.detail;
+        os << std::endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
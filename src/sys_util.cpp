@@ -0,0 +1,23 @@
+#include "sys_util.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+
+uint64_t ElapsedUs(std::chrono::steady_clock::time_point since, std::chrono::steady_clock::time_point now) {
+    if (now < since) return 0;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - since).count());
+}
+
+bool MakeDirs(const std::string& path, std::string* error) {
+    std::string partial;
+    std::string::size_type pos = 0;
+    while (pos != std::string::npos) {
+        pos = path.find('/', pos + 1);
+        partial = path.substr(0, pos);
+        if (partial.empty() || mkdir(partial.c_str(), 0755) == 0 || errno == EEXIST) continue;
+        if (error) *error = "mkdir " + partial + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
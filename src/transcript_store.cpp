@@ -0,0 +1,278 @@
+#include "transcript_store.h"
+
+#include <cstring>
+
+namespace {
+const char kKeySeparator = '\x1f';
+const char* const kSpeakerNames[TranscriptStore::kNumSpeakers] = {"user", "assistant"};
+}
+
+TranscriptStore::TranscriptStore()
+    : budget_(kDefaultBudgetBytes),
+      first_round_(0),
+      first_block_(0),
+      block_bytes_(0),
+      overhead_bytes_(0),
+      text_bytes_(0) {}
+
+void TranscriptStore::Configure(std::size_t budget_bytes) {
+    std::lock_guard<std::mutex> guard(lock_);
+    budget_ = budget_bytes;
+    EvictLocked(rounds_.empty() ? NULL : &rounds_.back());
+}
+
+std::size_t TranscriptStore::RoundOverhead(const Round& round) {
+    // Ids are held twice (round and index key); segment lists are bounded
+    // by kMaxSegments, so count them at their worst.
+    return sizeof(Round) + 2 * (round.dialog_id.size() + round.round_id.size() + 1) +
+           kNumSpeakers * (kMaxSegments + 1) * sizeof(Segment);
+}
+
+TranscriptStore::Round* TranscriptStore::FindOrAddLocked(Speaker speaker, const std::string& dialog_id,
+                                                         const std::string& round_id, bool* added) {
+    *added = false;
+    if (!rounds_.empty()) {
+        Round& latest = rounds_.back();
+        if (latest.dialog_id == dialog_id &&
+            (round_id.empty() ? !latest.sides[speaker].finished : latest.round_id == round_id)) {
+            return &latest;
+        }
+    }
+    if (!round_id.empty()) {
+        key_.assign(dialog_id);
+        key_ += kKeySeparator;
+        key_ += round_id;
+        std::unordered_map<std::string, uint64_t>::const_iterator it = index_.find(key_);
+        if (it != index_.end()) return &rounds_[it->second - first_round_];
+        index_[key_] = first_round_ + rounds_.size();
+    }
+    rounds_.push_back(Round());
+    Round& round = rounds_.back();
+    round.dialog_id = dialog_id;
+    round.round_id = round_id;
+    overhead_bytes_ += RoundOverhead(round);
+    *added = true;
+    return &round;
+}
+
+std::size_t TranscriptStore::CommonPrefixLocked(const Side& side, const std::string& text) const {
+    std::size_t keep = 0;
+    for (std::size_t i = 0; i < side.segments.size(); ++i) {
+        const Segment& segment = side.segments[i];
+        const char* stored = blocks_[segment.block - first_block_].data.get() + segment.offset;
+        std::size_t n = segment.size;
+        if (n > text.size() - keep) n = text.size() - keep;
+        std::size_t j = 0;
+        while (j < n && stored[j] == text[keep + j]) ++j;
+        keep += j;
+        if (j < segment.size) break;
+    }
+    return keep;
+}
+
+void TranscriptStore::ReleaseLocked(const Segment& segment) {
+    Block& block = blocks_[segment.block - first_block_];
+    if (--block.refs > 0 || &block == &blocks_.back()) return;
+    // Nothing refers to this block any more and nothing will be appended.
+    block_bytes_ -= block.capacity;
+    block.data.reset();
+    block.capacity = 0;
+    block.used = 0;
+    while (blocks_.size() > 1 && !blocks_.front().data) {
+        blocks_.pop_front();
+        ++first_block_;
+    }
+}
+
+void TranscriptStore::TruncateLocked(Side* side, std::size_t size) {
+    text_bytes_ -= side->size - size;
+    while (side->size > size) {
+        Segment& last = side->segments.back();
+        const std::size_t excess = side->size - size;
+        if (last.size > excess) {
+            last.size -= static_cast<uint32_t>(excess);
+            side->size = size;
+            break;
+        }
+        side->size -= last.size;
+        Segment released = last;
+        side->segments.pop_back();
+        ReleaseLocked(released);
+    }
+}
+
+const char* TranscriptStore::AppendLocked(Side* side, const char* data, std::size_t len) {
+    if (len == 0) return "";
+    // Appends are never split across blocks, so the suffix handed back to
+    // the caller is contiguous.
+    if (blocks_.empty() || blocks_.back().capacity - blocks_.back().used < len) {
+        if (!blocks_.empty() && blocks_.back().refs == 0) {
+            block_bytes_ -= blocks_.back().capacity;
+            blocks_.back().data.reset();
+            blocks_.back().capacity = 0;
+        }
+        Block block;
+        block.capacity = len > kBlockBytes ? len : kBlockBytes;
+        block.data.reset(new char[block.capacity]);
+        block.used = 0;
+        block.refs = 0;
+        blocks_.push_back(std::move(block));
+        block_bytes_ += blocks_.back().capacity;
+        while (blocks_.size() > 1 && !blocks_.front().data) {
+            blocks_.pop_front();
+            ++first_block_;
+        }
+    }
+    Block& tail = blocks_.back();
+    const uint64_t number = first_block_ + blocks_.size() - 1;
+    char* dst = tail.data.get() + tail.used;
+    std::memcpy(dst, data, len);
+
+    Segment* last = side->segments.empty() ? NULL : &side->segments.back();
+    if (last && last->block == number && last->offset + last->size == tail.used) {
+        last->size += static_cast<uint32_t>(len);
+    } else {
+        Segment segment;
+        segment.block = number;
+        segment.offset = static_cast<uint32_t>(tail.used);
+        segment.size = static_cast<uint32_t>(len);
+        side->segments.push_back(segment);
+        ++tail.refs;
+    }
+    tail.used += len;
+    side->size += len;
+    text_bytes_ += len;
+    return dst;
+}
+
+void TranscriptStore::CompactLocked(Side* side) {
+    std::string text;
+    CopyTextLocked(*side, &text);
+    TruncateLocked(side, 0);
+    AppendLocked(side, text.data(), text.size());
+    stats_.compactions++;
+}
+
+void TranscriptStore::EvictLocked(const Round* keep) {
+    while (block_bytes_ + overhead_bytes_ > budget_ && !rounds_.empty() && &rounds_.front() != keep) {
+        Round& victim = rounds_.front();
+        for (int s = 0; s < kNumSpeakers; ++s) TruncateLocked(&victim.sides[s], 0);
+        if (!victim.round_id.empty()) {
+            key_.assign(victim.dialog_id);
+            key_ += kKeySeparator;
+            key_ += victim.round_id;
+            index_.erase(key_);
+        }
+        overhead_bytes_ -= RoundOverhead(victim);
+        rounds_.pop_front();
+        ++first_round_;
+        stats_.evicted_rounds++;
+    }
+}
+
+TranscriptStore::Change TranscriptStore::Update(Speaker speaker, const std::string& dialog_id,
+                                                const std::string& round_id, const std::string& text,
+                                                bool finished) {
+    std::lock_guard<std::mutex> guard(lock_);
+    Change change;
+    Round* round = FindOrAddLocked(speaker, dialog_id, round_id, &change.new_round);
+    Side* side = &round->sides[speaker];
+
+    std::size_t keep = CommonPrefixLocked(*side, text);
+    // Do not split a multi-byte character: back off to its lead byte.
+    while (keep > 0 && keep < text.size() && (static_cast<unsigned char>(text[keep]) & 0xc0) == 0x80) --keep;
+    change.kept = keep;
+    change.dropped = side->size - keep;
+    if (change.dropped > 0) {
+        stats_.revisions++;
+        TruncateLocked(side, keep);
+    }
+    change.size = text.size() - keep;
+    change.data = AppendLocked(side, text.data() + keep, change.size);
+    if (side->segments.size() > kMaxSegments) {
+        CompactLocked(side);
+        const Segment& whole = side->segments.front();
+        change.data = blocks_[whole.block - first_block_].data.get() + whole.offset + keep;
+    }
+    side->finished = finished;
+    change.finished = finished;
+    stats_.updates++;
+    EvictLocked(round);
+    return change;
+}
+
+void TranscriptStore::CopyTextLocked(const Side& side, std::string* out) const {
+    out->clear();
+    out->reserve(side.size);
+    for (std::size_t i = 0; i < side.segments.size(); ++i) {
+        const Segment& segment = side.segments[i];
+        out->append(blocks_[segment.block - first_block_].data.get() + segment.offset, segment.size);
+    }
+}
+
+void TranscriptStore::CopyRoundLocked(const Round& round, RoundText* out) const {
+    out->dialog_id = round.dialog_id;
+    out->round_id = round.round_id;
+    for (int s = 0; s < kNumSpeakers; ++s) {
+        CopyTextLocked(round.sides[s], &out->text[s]);
+        out->finished[s] = round.sides[s].finished;
+    }
+}
+
+bool TranscriptStore::Get(const std::string& dialog_id, const std::string& round_id, RoundText* out) const {
+    std::string key = dialog_id;
+    key += kKeySeparator;
+    key += round_id;
+    std::lock_guard<std::mutex> guard(lock_);
+    std::unordered_map<std::string, uint64_t>::const_iterator it = index_.find(key);
+    if (it == index_.end()) return false;
+    CopyRoundLocked(rounds_[it->second - first_round_], out);
+    return true;
+}
+
+std::vector<TranscriptStore::RoundText> TranscriptStore::Recent(std::size_t count) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    std::size_t first = rounds_.size() > count ? rounds_.size() - count : 0;
+    std::vector<RoundText> out(rounds_.size() - first);
+    for (std::size_t i = first; i < rounds_.size(); ++i) CopyRoundLocked(rounds_[i], &out[i - first]);
+    return out;
+}
+
+TranscriptStore::Stats TranscriptStore::GetStats() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    Stats st = stats_;
+    st.rounds = rounds_.size();
+    st.blocks = 0;
+    for (std::size_t i = 0; i < blocks_.size(); ++i) {
+        if (blocks_[i].data) st.blocks++;
+    }
+    st.text_bytes = text_bytes_;
+    st.memory_bytes = block_bytes_ + overhead_bytes_;
+    return st;
+}
+
+void TranscriptStore::PrintStats(std::ostream& os) const {
+    Stats st = GetStats();
+    std::size_t budget;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        budget = budget_;
+    }
+    os << "transcripts: " << st.rounds << " rounds, " << st.text_bytes / 1024 << " KB text, "
+       << st.memory_bytes / 1024 << " KB in " << st.blocks << " blocks (budget " << budget / 1024 << " KB), "
+       << st.updates << " updates, " << st.revisions << " revisions, " << st.compactions << " compactions, "
+       << st.evicted_rounds << " rounds evicted" << std::endl;
+}
+
+void TranscriptStore::PrintRecent(std::ostream& os, std::size_t count) const {
+    std::vector<RoundText> rounds = Recent(count);
+    for (std::size_t i = 0; i < rounds.size(); ++i) {
+        const RoundText& round = rounds[i];
+        os << "[" << round.dialog_id << " / " << (round.round_id.empty() ? "-" : round.round_id) << "]" << std::endl;
+        for (int s = 0; s < kNumSpeakers; ++s) {
+            if (round.text[s].empty()) continue;
+            os << "  " << kSpeakerNames[s] << ": " << round.text[s] << (round.finished[s] ? "" : " ...")
+               << std::endl;
+        }
+    }
+}
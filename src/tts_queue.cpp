@@ -0,0 +1,334 @@
+#include "tts_queue.h"
+
+#include <cstring>
+#include <iomanip>
+
+#include "async_log.h"
+#include "conversation_handler.h"
+#include "sys_util.h"
+
+using namespace convsdk;
+
+namespace {
+
+// Must match downstream.sample_rate in gen_init_params().
+const int kDownlinkSampleRate = 24000;
+// Shorter fragments ("好。") are merged into the following sentence.
+const std::size_t kMinSegmentChars = 4;
+// A refused segment is retried on the next IDLE, at most this often.
+const int kMaxSendRetries = 2;
+// Upper bound for the audio lane to catch up after a round's IDLE.
+const int kAudioDrainMs = 2000;
+// Finished jobs remembered for Wait().
+const std::size_t kMaxFinishedJobs = 256;
+
+// Byte length of the UTF-8 sequence starting with `c` (1 for stray bytes).
+std::size_t Utf8Length(unsigned char c) {
+    if (c >= 0xF0) return 4;
+    if (c >= 0xE0) return 3;
+    if (c >= 0xC0) return 2;
+    return 1;
+}
+
+bool IsTerminator(const std::string& ch) {
+    static const char* kTerminators[] = {"。", "！", "？", "；", "!", "?", ";", "\n", "…"};
+    for (std::size_t i = 0; i < sizeof(kTerminators) / sizeof(kTerminators[0]); ++i) {
+        if (ch == kTerminators[i]) return true;
+    }
+    return false;
+}
+
+bool IsClosing(const std::string& ch) {
+    static const char* kClosing[] = {"”", "’", "」", "』", "）", ")", "\"", "'"};
+    for (std::size_t i = 0; i < sizeof(kClosing) / sizeof(kClosing[0]); ++i) {
+        if (ch == kClosing[i]) return true;
+    }
+    return false;
+}
+
+bool IsSoftBreak(const std::string& ch) {
+    return ch == "，" || ch == "、" || ch == "," || ch == " " || ch == "：" || ch == ":";
+}
+
+bool IsBlank(const std::string& text) {
+    return text.find_first_not_of(" \t\r\n") == std::string::npos;
+}
+
+std::string Trim(const std::string& text) {
+    std::string::size_type b = text.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) return std::string();
+    std::string::size_type e = text.find_last_not_of(" \t\r\n");
+    return text.substr(b, e - b + 1);
+}
+
+}  // namespace
+
+std::size_t TtsQueue::CountChars(const std::string& text) {
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < text.size(); i += Utf8Length(static_cast<unsigned char>(text[i]))) n++;
+    return n;
+}
+
+std::vector<std::string> TtsQueue::SplitSentences(const std::string& text, std::size_t max_chars) {
+    if (max_chars < kMinSegmentChars) max_chars = kMinSegmentChars;
+
+    // Split into code points once.
+    std::vector<std::string> chars;
+    for (std::size_t i = 0; i < text.size();) {
+        std::size_t len = Utf8Length(static_cast<unsigned char>(text[i]));
+        chars.push_back(text.substr(i, len));
+        i += len;
+    }
+
+    std::vector<std::string> sentences;
+    std::string current;
+    std::size_t current_chars = 0;
+    std::size_t last_soft = 0;  // code points of `current` up to the last soft break
+    std::string last_soft_bytes;
+
+    for (std::size_t i = 0; i < chars.size(); ++i) {
+        current += chars[i];
+        current_chars++;
+        if (IsSoftBreak(chars[i])) {
+            last_soft = current_chars;
+            last_soft_bytes = current;
+        }
+
+        bool end = IsTerminator(chars[i]) ||
+                   (chars[i] == "." && (i + 1 == chars.size() || chars[i + 1] == " " || chars[i + 1] == "\n"));
+        if (end) {
+            while (i + 1 < chars.size() && (IsClosing(chars[i + 1]) || IsTerminator(chars[i + 1]))) {
+                current += chars[++i];
+                current_chars++;
+            }
+        } else if (current_chars >= max_chars) {
+            // Too long: cut at the last soft break if there is a useful one.
+            if (last_soft >= kMinSegmentChars) {
+                std::string rest = current.substr(last_soft_bytes.size());
+                sentences.push_back(last_soft_bytes);
+                current = rest;
+                current_chars -= last_soft;
+            } else {
+                sentences.push_back(current);
+                current.clear();
+                current_chars = 0;
+            }
+            last_soft = 0;
+            last_soft_bytes.clear();
+            continue;
+        } else {
+            continue;
+        }
+
+        if (current_chars >= kMinSegmentChars || IsBlank(current)) {
+            sentences.push_back(current);
+            current.clear();
+            current_chars = 0;
+        }
+        last_soft = 0;
+        last_soft_bytes.clear();
+    }
+    if (!current.empty()) sentences.push_back(current);
+
+    std::vector<std::string> out;
+    for (std::size_t i = 0; i < sentences.size(); ++i) {
+        std::string s = Trim(sentences[i]);
+        if (!s.empty()) out.push_back(s);
+    }
+    return out;
+}
+
+TtsQueue::TtsQueue()
+    : stopping_(false), next_id_(1), running_id_(0), active_(NULL), total_chars_(0), total_us_(0) {}
+
+TtsQueue::~TtsQueue() {
+    Stop();
+}
+
+void TtsQueue::Configure(const Options& options) {
+    std::lock_guard<std::mutex> guard(lock_);
+    options_ = options;
+}
+
+uint64_t TtsQueue::Submit(const std::string& text) {
+    if (IsBlank(text)) return 0;
+    std::shared_ptr<Job> job(new Job());
+    job->text = text;
+    job->submitted = Clock::now();
+    job->first_audio = false;
+    job->stats.chars = CountChars(text);
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (stopping_) return 0;
+    job->stats.id = next_id_++;
+    pending_.push_back(job);
+    if (!worker_.joinable()) worker_ = std::thread(&TtsQueue::WorkerMain, this);
+    cv_.notify_all();
+    return job->stats.id;
+}
+
+bool TtsQueue::Wait(uint64_t id, JobStats* stats) {
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;) {
+        for (std::size_t i = 0; i < finished_.size(); ++i) {
+            if (finished_[i]->stats.id == id) {
+                if (stats) *stats = finished_[i]->stats;
+                return finished_[i]->stats.ok;
+            }
+        }
+        bool known = false;
+        for (std::size_t i = 0; i < pending_.size(); ++i) known = known || pending_[i]->stats.id == id;
+        if (running_id_ == id) known = true;
+        if (!known) return false;
+        cv_.wait(guard);
+    }
+}
+
+bool TtsQueue::OnAudio(EventRecord& record) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!active_ || record.binary.empty()) return false;
+    if (!active_->first_audio) {
+        active_->first_audio = true;
+        active_->stats.first_audio_us = ElapsedUs(active_->submitted, record.received_at);
+    }
+    active_->stats.audio_bytes += record.binary.size();
+    if (active_->writer && !active_->writer->Push(record.binary)) {
+        LOGW("TTS job %llu: writer queue full, dropped audio", (unsigned long long)active_->stats.id);
+    }
+    return true;
+}
+
+void TtsQueue::Stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stopping_ = true;
+        pending_.clear();
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void TtsQueue::WorkerMain() {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            cv_.wait(guard, [this]() { return stopping_ || !pending_.empty(); });
+            if (pending_.empty()) return;
+            job = pending_.front();
+            pending_.pop_front();
+            running_id_ = job->stats.id;
+        }
+        RunJob(job.get());
+
+        std::lock_guard<std::mutex> guard(lock_);
+        if (job->stats.ok) {
+            if (job->first_audio) first_audio_us_.Record(job->stats.first_audio_us);
+            total_chars_ += job->stats.chars;
+            total_us_ += job->stats.total_us;
+        }
+        finished_.push_back(job);
+        if (finished_.size() > kMaxFinishedJobs) finished_.erase(finished_.begin());
+        running_id_ = 0;
+        cv_.notify_all();
+    }
+}
+
+bool TtsQueue::SendSegment(const std::string& request, int timeout_ms, uint64_t* idle_seq) {
+    for (int attempt = 0;; ++attempt) {
+        g_round_tracer.Mark(RoundTracer::kTraceRequestSent);
+        ConvRetCode ret = conversation ? conversation->SendResponseData(request.c_str()) : kNotConnected;
+        if (ret == kSuccess) return true;
+        LOGW("TTS segment refused (ret=%d)", ret);
+        // The dialog may have left IDLE under us (or be reconnecting): retry
+        // on the next IDLE period.
+        if (attempt >= kMaxSendRetries ||
+            !g_dialog_state.WaitFor(kDialogIdle, timeout_ms, *idle_seq, idle_seq)) {
+            return false;
+        }
+    }
+}
+
+void TtsQueue::RunJob(Job* job) {
+    Options options;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        options = options_;
+    }
+    std::vector<std::string> segments = SplitSentences(job->text, options.max_segment_chars);
+    job->stats.segments = segments.size();
+    job->stats.path = g_output_dir + "/tts_job_" + std::to_string(job->stats.id) + ".wav";
+    job->writer.reset(new PcmSessionWriter(job->stats.path, PcmSessionWriter::kContainerWav,
+                                           kDownlinkSampleRate, 1));
+    if (!job->writer->Open()) {
+        LOGE("TTS job %llu: cannot open %s", (unsigned long long)job->stats.id, job->stats.path.c_str());
+        job->writer.reset();
+    }
+    LOGI("TTS job %llu: %zu chars in %zu segments", (unsigned long long)job->stats.id,
+         job->stats.chars, segments.size());
+
+    uint64_t idle_seq = 0;
+    bool ok = g_dialog_state.WaitFor(kDialogIdle, options.round_timeout_ms, 0, &idle_seq);
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        active_ = job;
+    }
+    for (std::size_t i = 0; ok && i < segments.size(); ++i) {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            if (stopping_) {
+                ok = false;
+                break;
+            }
+        }
+        if (!SendSegment(gen_tts_request(segments[i]), options.round_timeout_ms, &idle_seq)) {
+            LOGE("TTS job %llu: segment %zu not accepted", (unsigned long long)job->stats.id, i + 1);
+            ok = false;
+            break;
+        }
+        if (!g_dialog_state.WaitFor(kDialogIdle, options.round_timeout_ms, idle_seq, &idle_seq)) {
+            LOGE("TTS job %llu: segment %zu did not return to IDLE within %d ms",
+                 (unsigned long long)job->stats.id, i + 1, options.round_timeout_ms);
+            ok = false;
+            break;
+        }
+        // Audio of this round may still sit in the audio lane.
+        g_event_dispatcher.WaitDispatched(EventDispatcher::kLaneAudio, kAudioDrainMs);
+        job->stats.segments_done++;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        active_ = NULL;
+    }
+    if (job->writer) job->writer->Close();
+
+    job->stats.ok = ok && job->stats.segments_done == job->stats.segments;
+    job->stats.total_us = ElapsedUs(job->submitted);
+    double seconds = job->stats.total_us / 1e6;
+    LOGI("TTS job %llu %s: %zu/%zu segments, %zu chars, %.1f chars/s, first audio %.1f ms, %llu bytes -> %s",
+         (unsigned long long)job->stats.id, job->stats.ok ? "done" : "FAILED", job->stats.segments_done,
+         job->stats.segments, job->stats.chars, seconds > 0 ? job->stats.chars / seconds : 0.0,
+         job->stats.first_audio_us / 1000.0, (unsigned long long)job->stats.audio_bytes,
+         job->stats.path.c_str());
+}
+
+void TtsQueue::PrintStats(std::ostream& os) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (finished_.empty()) return;
+    std::size_t ok = 0;
+    for (std::size_t i = 0; i < finished_.size(); ++i) ok += finished_[i]->stats.ok ? 1 : 0;
+    double seconds = total_us_ / 1e6;
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+    os << "tts queue: " << finished_.size() << " jobs, " << finished_.size() - ok << " failed, "
+       << total_chars_ << " chars, " << (seconds > 0 ? total_chars_ / seconds : 0.0) << " chars/s" << std::endl;
+    if (first_audio_us_.Count() > 0) {
+        os << "  first audio          n=" << first_audio_us_.Count()
+           << " p50=" << first_audio_us_.Percentile(50) / 1000.0
+           << " p90=" << first_audio_us_.Percentile(90) / 1000.0
+           << " max=" << first_audio_us_.Max() / 1000.0 << " ms" << std::endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
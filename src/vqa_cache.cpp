@@ -0,0 +1,118 @@
+#include "vqa_cache.h"
+
+VqaCache::VqaCache()
+    : budget_(kDefaultBudgetBytes),
+      serve_answers_(false),
+      bytes_(0),
+      pending_(false),
+      pending_key_(0) {}
+
+void VqaCache::Configure(std::size_t budget_bytes, bool serve_answers) {
+    std::lock_guard<std::mutex> guard(lock_);
+    budget_ = budget_bytes;
+    serve_answers_ = serve_answers;
+    EvictLocked();
+}
+
+bool VqaCache::enabled() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return budget_ > 0;
+}
+
+std::size_t VqaCache::EntryBytes(const Entry& entry) {
+    return (entry.body ? entry.body->size() : 0) + entry.answer.size();
+}
+
+std::shared_ptr<const std::string> VqaCache::Lookup(uint64_t key, std::string* answer) {
+    std::lock_guard<std::mutex> guard(lock_);
+    std::unordered_map<uint64_t, LruList::iterator>::iterator it = index_.find(key);
+    if (it == index_.end()) {
+        stats_.misses++;
+        return std::shared_ptr<const std::string>();
+    }
+    stats_.hits++;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    const Entry& entry = *it->second;
+    if (serve_answers_ && answer && !entry.answer.empty()) {
+        *answer = entry.answer;
+        stats_.answered++;
+    }
+    return entry.body;
+}
+
+void VqaCache::Insert(uint64_t key, const std::shared_ptr<const std::string>& body) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!body || body->size() > budget_) return;
+    std::unordered_map<uint64_t, LruList::iterator>::iterator it = index_.find(key);
+    if (it != index_.end()) {
+        bytes_ -= EntryBytes(*it->second);
+        it->second->body = body;
+        bytes_ += EntryBytes(*it->second);
+        lru_.splice(lru_.begin(), lru_, it->second);
+    } else {
+        Entry entry;
+        entry.key = key;
+        entry.body = body;
+        lru_.push_front(entry);
+        index_[key] = lru_.begin();
+        bytes_ += EntryBytes(entry);
+    }
+    EvictLocked();
+}
+
+void VqaCache::EvictLocked() {
+    while (bytes_ > budget_ && !lru_.empty()) {
+        const Entry& victim = lru_.back();
+        bytes_ -= EntryBytes(victim);
+        index_.erase(victim.key);
+        lru_.pop_back();
+        stats_.evictions++;
+    }
+}
+
+void VqaCache::BeginRound(uint64_t key) {
+    std::lock_guard<std::mutex> guard(lock_);
+    pending_ = true;
+    pending_key_ = key;
+    pending_answer_.clear();
+}
+
+void VqaCache::AbortRound() {
+    std::lock_guard<std::mutex> guard(lock_);
+    pending_ = false;
+    pending_answer_.clear();
+}
+
+void VqaCache::OnResponseDetail(const std::string& text) {
+    std::lock_guard<std::mutex> guard(lock_);
+    // Details carry the text so far; the last one of the round is the answer.
+    if (pending_) pending_answer_ = text;
+}
+
+void VqaCache::EndRound() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!pending_) return;
+    pending_ = false;
+    std::unordered_map<uint64_t, LruList::iterator>::iterator it = index_.find(pending_key_);
+    if (it == index_.end() || pending_answer_.empty()) return;
+    bytes_ -= EntryBytes(*it->second);
+    it->second->answer.swap(pending_answer_);
+    bytes_ += EntryBytes(*it->second);
+    pending_answer_.clear();
+    EvictLocked();
+}
+
+VqaCache::Stats VqaCache::GetStats() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    Stats st = stats_;
+    st.entries = lru_.size();
+    st.bytes = bytes_;
+    return st;
+}
+
+void VqaCache::PrintStats(std::ostream& os) const {
+    Stats st = GetStats();
+    os << "vqa cache: " << st.hits << " hits, " << st.misses << " misses, " << st.answered
+       << " answered locally, " << st.evictions << " evicted, " << st.entries << " entries, "
+       << st.bytes / 1024 << " KB" << std::endl;
+}
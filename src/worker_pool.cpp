@@ -0,0 +1,129 @@
+#include "worker_pool.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+// Keep every slot on its own cache lines.
+const std::size_t kSlotAlign = 64;
+
+std::size_t AlignUp(std::size_t n) {
+    return (n + kSlotAlign - 1) & ~(kSlotAlign - 1);
+}
+
+}  // namespace
+
+WorkerPool::WorkerPool(int workers)
+    : workers_(workers > 0 ? workers : 1),
+      region_(NULL),
+      region_size_(0),
+      shared_(NULL),
+      exit_status_(new int[workers > 0 ? workers : 1]),
+      wall_us_(0) {
+    for (int i = 0; i < workers_; ++i) exit_status_[i] = -1;
+}
+
+WorkerPool::~WorkerPool() {
+    if (region_) munmap(region_, region_size_);
+    delete[] exit_status_;
+}
+
+WorkerPool::Slot* WorkerPool::SlotAt(int index) const {
+    char* base = static_cast<char*>(region_) + AlignUp(sizeof(Shared));
+    return reinterpret_cast<Slot*>(base + index * AlignUp(sizeof(Slot)));
+}
+
+bool WorkerPool::Start(WorkerMain fn, std::string* error) {
+    region_size_ = AlignUp(sizeof(Shared)) + workers_ * AlignUp(sizeof(Slot));
+    region_ = mmap(NULL, region_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (region_ == MAP_FAILED) {
+        region_ = NULL;
+        if (error) *error = std::string("mmap shared region: ") + std::strerror(errno);
+        return false;
+    }
+    shared_ = new (region_) Shared();
+    shared_->next_round.store(0);
+    if (!shared_->next_round.is_lock_free()) {
+        if (error) *error = "64-bit atomics are not lock free; cannot share the round counter";
+        return false;
+    }
+    for (int i = 0; i < workers_; ++i) {
+        Slot* slot = new (SlotAt(i)) Slot();
+        slot->pid = 0;
+        slot->published = 0;
+        slot->traced_rounds = 0;
+    }
+
+    // Nothing buffered may be written twice by the children.
+    std::cout.flush();
+    std::fflush(NULL);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < workers_; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            if (error) *error = std::string("fork: ") + std::strerror(errno);
+            // Workers already running finish their share of the rounds.
+            workers_ = i;
+            return false;
+        }
+        if (pid == 0) {
+            Slot* slot = SlotAt(i);
+            slot->pid = getpid();
+            int code = fn(i, slot, &shared_->next_round);
+            std::cout.flush();
+            std::exit(code);
+        }
+        SlotAt(i)->pid = pid;
+    }
+    wall_us_ = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+int WorkerPool::Wait() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int failed = 0;
+    for (int i = 0; i < workers_; ++i) {
+        Slot* slot = SlotAt(i);
+        int status = 0;
+        while (waitpid(slot->pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        exit_status_[i] = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        if (exit_status_[i] != 0 || !slot->published) failed++;
+    }
+    wall_us_ += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    return failed;
+}
+
+void WorkerPool::PrintReport(std::ostream& os) const {
+    BatchRunner::Report total;
+    LatencyHistogram tracer[RoundTracer::kNumMetrics];
+    uint64_t traced_rounds = 0;
+    for (int i = 0; i < workers_; ++i) {
+        const Slot* slot = SlotAt(i);
+        os << "worker " << i << " (pid " << slot->pid << "): exit " << exit_status_[i];
+        if (!slot->published) {
+            os << ", no results" << std::endl;
+            continue;
+        }
+        os << ", " << slot->batch.rounds << " rounds, " << slot->batch.failed << " failed"
+           << (slot->batch.timeouts ? ", timed out" : "") << std::endl;
+        total.Merge(slot->batch);
+        for (int m = 0; m < RoundTracer::kNumMetrics; ++m) tracer[m].Merge(slot->tracer[m]);
+        traced_rounds += slot->traced_rounds;
+    }
+    os << workers_ << " workers, supervisor wall " << wall_us_ / 1000 << " ms" << std::endl;
+    BatchRunner::PrintReport(os, total);
+    RoundTracer::PrintHistograms(os, tracer, traced_rounds);
+}
@@ -0,0 +1,167 @@
+// Stand-in implementation of convsdk::ConvEvent for the offline stub SDK.
+// Events are built the way the real SDK builds them: from the server's JSON
+// reply (DashScope duplex protocol subset), optionally carrying binary audio.
+#include "conv_event.h"
+
+#include <memory>
+
+#include "conv_constants.h"
+#include "json/json.h"
+
+namespace convsdk {
+
+namespace {
+const char* kEventNames[] = {
+    "ConversationFailed", "ConversationConnected", "ConversationInitialized",
+    "ConversationStarted", "ConversationCompleted", "SentenceBegin", "SentenceEnd",
+    "DataOutputStarted", "DataOutputCompleted", "Binary", "SoundLevel",
+    "DialogStateChanged", "InterruptAccepted", "InterruptDenied",
+    "VoiceInterruptAccepted", "VoiceInterruptDenied", "ConnectionDisconnected",
+    "ConnectionConnected", "HumanSpeakingDetail", "RespondingDetail", "NetworkStatus",
+    "KeywordSpotted", "KeywordTrusted", "VoiceTimeout",
+};
+struct EventName {
+    const char* name;
+    ConvEvent::ConvEventType type;
+};
+
+// payload.output.event -> SDK event type
+const EventName kServerEvents[] = {
+    {"Started", ConvEvent::kConversationStarted},
+    {"Stopped", ConvEvent::kConversationCompleted},
+    {"DialogStateChanged", ConvEvent::kDialogStateChanged},
+    {"SpeechStarted", ConvEvent::kSentenceBegin},
+    {"SpeechEnded", ConvEvent::kSentenceEnd},
+    {"RespondingStarted", ConvEvent::kDataOutputStarted},
+    {"RespondingEnded", ConvEvent::kDataOutputCompleted},
+    {"SpeechContent", ConvEvent::kHumanSpeakingDetail},
+    {"RespondingContent", ConvEvent::kRespondingDetail},
+    {"RequestAccepted", ConvEvent::kInterruptAccepted},
+    {"RequestDenied", ConvEvent::kInterruptDenied},
+    {"AudioData", ConvEvent::kBinary},
+};
+
+int ParseDialogState(const std::string& state) {
+    if (state == "Listening") return kDialogListening;
+    if (state == "Responding") return kDialogResponding;
+    if (state == "Thinking") return kDialogThinking;
+    return kDialogIdle;
+}
+}  // namespace
+
+ConvEvent::ConvEvent()
+    : status_code_(0),
+      msg_type_(kConversationInvalid),
+      sub_msg_type_(kConversationInvalid),
+      dialog_state_(kDialogIdle),
+      interruption_policy_(kInterruptionPolicyNone),
+      terminate_(false),
+      sound_db_(-160.0f),
+      sound_level_(0),
+      sample_rate_(0),
+      channel_select_(kFirstChannel),
+      network_event_(kNetworkEventUnknown),
+      network_latency_(0) {}
+
+ConvEvent::ConvEvent(ConvEventType type) : ConvEvent() {
+    msg_type_ = type;
+}
+
+ConvEvent::ConvEvent(std::string msg, std::string task_id, std::string local_task_id)
+    : ConvEvent() {
+    task_id_ = task_id;
+    local_task_id_ = local_task_id;
+    ParseResponse(msg);
+}
+
+ConvEvent::ConvEvent(std::vector<unsigned char> data, std::string msg, std::string local_task_id)
+    : ConvEvent() {
+    local_task_id_ = local_task_id;
+    ParseResponse(msg);
+    binary_data_.swap(data);
+    msg_type_ = kBinary;
+    msg_.clear();
+}
+
+ConvEvent::ConvEvent(const ConvEvent& event) = default;
+ConvEvent& ConvEvent::operator=(const ConvEvent& rhs) = default;
+ConvEvent::~ConvEvent() {}
+
+int ConvEvent::GetStatusCode() { return status_code_; }
+const char* ConvEvent::GetAllResponse() { return msg_.c_str(); }
+void ConvEvent::UpdateAllResponse(const char* new_response) { msg_ = new_response ? new_response : ""; }
+const char* ConvEvent::GetErrorMessage() { return error_msg_.c_str(); }
+const char* ConvEvent::GetTaskId() { return task_id_.c_str(); }
+const char* ConvEvent::GetSessionId() { return session_id_.c_str(); }
+const char* ConvEvent::GetDialogId() { return dialog_id_.c_str(); }
+const char* ConvEvent::GetRoundId() { return round_id_.c_str(); }
+std::vector<unsigned char> ConvEvent::GetBinaryData() { return binary_data_; }
+unsigned char* ConvEvent::GetBinaryDataInChar() { return binary_data_.empty() ? nullptr : binary_data_.data(); }
+int ConvEvent::GetBinaryDataSize() { return static_cast<int>(binary_data_.size()); }
+void ConvEvent::SetMsgType(ConvEventType type) { msg_type_ = type; }
+ConvEvent::ConvEventType ConvEvent::GetMsgType() { return msg_type_; }
+
+const char* ConvEvent::GetMsgTypeString(int type) {
+    int t = type < 0 ? static_cast<int>(msg_type_) : type;
+    if (t >= 0 && t < static_cast<int>(sizeof(kEventNames) / sizeof(kEventNames[0]))) {
+        return kEventNames[t];
+    }
+    return "OtherMessage";
+}
+
+ConvEvent::ConvEventType ConvEvent::GetSubMsgType() { return sub_msg_type_; }
+int ConvEvent::GetDialogStateChanged() { return dialog_state_; }
+void ConvEvent::SetDialogStateChanged(int dialog_state) { dialog_state_ = dialog_state; }
+int ConvEvent::GetInterruptionPolicy() { return interruption_policy_; }
+bool ConvEvent::GetTerminate() { return terminate_; }
+float ConvEvent::GetSoundDb() { return sound_db_; }
+int ConvEvent::GetSoundLevel() { return sound_level_; }
+int ConvEvent::GetSampleRate() { return sample_rate_; }
+int ConvEvent::GetChannelSelect() { return channel_select_; }
+int ConvEvent::ParseMsgType(std::string name) {
+    for (std::size_t i = 0; i < sizeof(kServerEvents) / sizeof(kServerEvents[0]); ++i) {
+        if (name == kServerEvents[i].name) return kServerEvents[i].type;
+    }
+    return kConversationInvalid;
+}
+
+bool ConvEvent::ParseResponse(std::string response) {
+    msg_ = response;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    Json::Value root;
+    std::string errs;
+    if (!reader->parse(response.data(), response.data() + response.size(), &root, &errs) ||
+        !root.isObject()) {
+        msg_type_ = kConversationFailed;
+        status_code_ = kJsonParseFailed;
+        error_msg_ = errs;
+        return false;
+    }
+
+    const Json::Value& header = root["header"];
+    if (header.isMember("task_id")) task_id_ = header["task_id"].asString();
+    if (header["event"].asString() == "task-failed") {
+        msg_type_ = kConversationFailed;
+        status_code_ = header.get("error_code", kServerInternalError).asInt();
+        error_msg_ = header["error_message"].asString();
+        terminate_ = true;
+        return true;
+    }
+
+    const Json::Value& output = root["payload"]["output"];
+    msg_type_str = output["event"].asString();
+    msg_type_ = static_cast<ConvEventType>(ParseMsgType(msg_type_str));
+    dialog_id_ = output["dialog_id"].asString();
+    session_id_ = dialog_id_;
+    round_id_ = output["round_id"].asString();
+    if (msg_type_ == kDialogStateChanged) {
+        dialog_state_ = ParseDialogState(output["state"].asString());
+    }
+    return true;
+}
+
+ConvEvent::NetworkEventType ConvEvent::GetNetworkEvent() { return network_event_; }
+int ConvEvent::GetNetworkLatency() { return network_latency_; }
+
+}  // namespace convsdk
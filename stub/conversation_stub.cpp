@@ -0,0 +1,342 @@
+// Stand-in implementation of convsdk::Conversation. Instead of talking to
+// DashScope it replays a scripted server timeline (see scripted_dialog.h):
+// every server reply is rendered as the JSON the real service would send,
+// turned into a ConvEvent and delivered on an SDK-owned callback thread.
+#include "conversation.h"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "conv_event.h"
+#include "json/json.h"
+#include "scripted_dialog.h"
+#include "stub_scenario.h"
+
+namespace convsdk {
+
+namespace {
+const char* kStubVersion = "conv-stub-1.0";
+
+bool ParseJsonObject(const char* text, Json::Value* root, std::string* errs) {
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    return reader->parse(text, text + std::strlen(text), root, errs) && root->isObject();
+}
+}  // namespace
+
+class ConversationImpl {
+ public:
+    ConversationImpl(ConversationCallbackMethod on_message,
+                     EventTrackCallbackMethod on_track,
+                     void* user_data);
+    ~ConversationImpl();
+
+    ConvRetCode Connect(const char* params);
+    ConvRetCode Disconnect();
+    ConvRetCode Interrupt();
+    ConvRetCode SendAudioData(const uint8_t* data, size_t data_size);
+    ConvRetCode SendResponseData(const char* params);
+    ConvRetCode SetAction(ConvAction action);
+    int GetState(StateType type);
+    const char* GetParameter(const char* param);
+
+ private:
+    void OnText(const std::string& json);
+    void OnBinary(std::vector<unsigned char>& pcm, const std::string& round_id);
+    void Track(ConvLogLevel level, const std::string& msg);
+
+    ConversationCallbackMethod on_message_;
+    EventTrackCallbackMethod on_track_;
+    void* user_data_;
+
+    std::mutex lock_;
+    std::unique_ptr<ScriptedDialog> dialog_;
+    std::string task_id_;
+    std::string dialog_id_;
+    std::string parameter_;
+    uint64_t connects_ = 0;
+};
+
+ConversationImpl::ConversationImpl(ConversationCallbackMethod on_message,
+                                   EventTrackCallbackMethod on_track,
+                                   void* user_data)
+    : on_message_(on_message), on_track_(on_track), user_data_(user_data) {}
+
+ConversationImpl::~ConversationImpl() {
+    Disconnect();
+}
+
+ConvRetCode ConversationImpl::Connect(const char* params) {
+    Json::Value root;
+    std::string errs;
+    if (params && !ParseJsonObject(params, &root, &errs)) {
+        Track(kConvLogLevelError, "invalid init params: " + errs);
+        return kIllegalInitParam;
+    }
+
+    StubScenario scenario = StubScenario::FromEnv();
+    const Json::Value& downstream = root["downstream"];
+    if (downstream.isMember("sample_rate") && downstream["sample_rate"].asInt() > 0) {
+        scenario.tts_sample_rate = downstream["sample_rate"].asInt();
+    }
+
+    std::unique_ptr<ScriptedDialog> dialog(new ScriptedDialog(
+        scenario,
+        [this](const std::string& json) { OnText(json); },
+        [this](std::vector<unsigned char>& pcm, const std::string& round_id) { OnBinary(pcm, round_id); }));
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (dialog_) return kHasInvoked;
+    }
+
+    // The real SDK blocks in Connect() for the websocket + task handshake.
+    int connect_ms = dialog->Jittered(scenario.connect_ms);
+    std::this_thread::sleep_for(std::chrono::milliseconds(connect_ms));
+
+    // Like the service: a dialog_id passed in the params continues that
+    // dialog, otherwise every connect starts a new one.
+    std::string resume_id = root["dialog_attributes"]["dialog_id"].asString();
+    std::string connected_dialog;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (dialog_) return kHasInvoked;
+        ++connects_;
+        std::ostringstream task_id;
+        task_id << "stub-task-" << scenario.seed << "-" << connects_;
+        task_id_ = task_id.str();
+        if (resume_id.empty()) {
+            std::ostringstream dialog_id;
+            dialog_id << "stub-dialog-" << scenario.seed << "-" << connects_;
+            dialog_id_ = dialog_id.str();
+        } else {
+            dialog_id_ = resume_id;
+        }
+        dialog_.swap(dialog);
+        dialog_->Start(task_id_, dialog_id_);
+        connected_dialog = dialog_id_;
+    }
+
+    std::ostringstream msg;
+    msg << "stub connected in " << connect_ms << " ms, dialog " << connected_dialog
+        << (resume_id.empty() ? "" : " (resumed)") << ", tts " << scenario.tts_sample_rate
+        << " Hz, packet " << scenario.packet_bytes << " bytes, burst x" << scenario.burst_speed;
+    Track(kConvLogLevelInfo, msg.str());
+    return kSuccess;
+}
+
+ConvRetCode ConversationImpl::Disconnect() {
+    std::unique_ptr<ScriptedDialog> dialog;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        dialog.swap(dialog_);
+    }
+    if (!dialog) return kNotConnected;
+    dialog->Stop();
+
+    // Delivered on the caller's thread: the callback thread is gone by now.
+    OnText(dialog->RenderOutput("Stopped", Json::Value()));
+    std::ostringstream msg;
+    msg << "stub disconnected, " << dialog->uplink_bytes() << " uplink bytes, "
+        << dialog->rounds() << " rounds";
+    Track(kConvLogLevelInfo, msg.str());
+    return kSuccess;
+}
+
+ConvRetCode ConversationImpl::Interrupt() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!dialog_) return kNotConnected;
+    return dialog_->Interrupt() ? kSuccess : kInvalidState;
+}
+
+ConvRetCode ConversationImpl::SendAudioData(const uint8_t* data, size_t data_size) {
+    if (!data || data_size == 0) return kInvalidAudioData;
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!dialog_) return kNotConnected;
+    return dialog_->OnAudio(data_size) ? kSuccess : kSkipSendData;
+}
+
+ConvRetCode ConversationImpl::SendResponseData(const char* params) {
+    if (!params) return kIllegalParam;
+    Json::Value root;
+    std::string errs;
+    if (!ParseJsonObject(params, &root, &errs)) return kJsonFormatError;
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!dialog_) return kNotConnected;
+    bool with_llm = root["type"].asString() != "transcript";
+    return dialog_->Request(root["text"].asString(), with_llm) ? kSuccess : kInvalidState;
+}
+
+ConvRetCode ConversationImpl::SetAction(ConvAction action) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!dialog_) return kNotConnected;
+
+    switch (action) {
+    case kStartHumanSpeech:
+        return dialog_->StartSpeech() ? kSuccess : kInvalidState;
+    case kStopHumanSpeech:
+        return dialog_->StopSpeech() ? kSuccess : kInvalidState;
+    case kCancelHumanSpeech:
+        return dialog_->CancelSpeech() ? kSuccess : kInvalidState;
+    case kPlayerStopped:
+        // Harmless when nothing is playing, as with the real SDK.
+        dialog_->PlayerStopped();
+        return kSuccess;
+    default:
+        // kPlayerStarted and the reserved actions need no server round trip.
+        return kSuccess;
+    }
+}
+
+int ConversationImpl::GetState(StateType type) {
+    std::lock_guard<std::mutex> guard(lock_);
+    switch (type) {
+    case kTypeDialogState:
+        return dialog_ ? dialog_->dialog_state() : kDialogIdle;
+    case kTypeConnectionState:
+        return dialog_ ? kDialogConnected : kDialogDisconnected;
+    default:
+        return 0;
+    }
+}
+
+const char* ConversationImpl::GetParameter(const char* param) {
+    std::lock_guard<std::mutex> guard(lock_);
+    std::string name = param ? param : "";
+    if (name == "task_id") parameter_ = task_id_;
+    else if (name == "dialog_id") parameter_ = dialog_id_;
+    else parameter_.clear();
+    return parameter_.c_str();
+}
+
+void ConversationImpl::OnText(const std::string& json) {
+    ConvEvent event(json, task_id_, task_id_);
+    if (on_message_) on_message_(&event, user_data_);
+}
+
+void ConversationImpl::OnBinary(std::vector<unsigned char>& pcm, const std::string& round_id) {
+    Json::Value root;
+    root["header"]["task_id"] = task_id_;
+    root["payload"]["output"]["event"] = "AudioData";
+    root["payload"]["output"]["dialog_id"] = dialog_id_;
+    root["payload"]["output"]["round_id"] = round_id;
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+
+    ConvEvent event(pcm, Json::writeString(writer, root), task_id_);
+    if (on_message_) on_message_(&event, user_data_);
+}
+
+void ConversationImpl::Track(ConvLogLevel level, const std::string& msg) {
+    if (on_track_) on_track_(level, ("[conv-stub] " + msg).c_str(), user_data_);
+}
+
+// ---------------------------------------------------------------------------
+
+std::mutex Conversation::instances_lock_;
+std::atomic<bool> Conversation::connecting_flag_(false);
+
+Conversation::Conversation() : impl_(NULL) {}
+
+Conversation::~Conversation() {
+    delete impl_;
+}
+
+Conversation* Conversation::CreateConversation(const ConversationCallbackMethod onMessage,
+                                               const EventTrackCallbackMethod onEventTrackMessage,
+                                               void* user_data) {
+    static Conversation instance;
+    std::lock_guard<std::mutex> guard(instances_lock_);
+    std::lock_guard<std::mutex> instance_guard(instance.instance_lock_);
+    if (!instance.impl_) {
+        instance.impl_ = new ConversationImpl(onMessage, onEventTrackMessage, user_data);
+    }
+    return &instance;
+}
+
+ConvRetCode Conversation::DestroyConversation() {
+    std::lock_guard<std::mutex> guard(instance_lock_);
+    if (!impl_) return kNotCreateConversation;
+    delete impl_;
+    impl_ = NULL;
+    return kSuccess;
+}
+
+ConvRetCode Conversation::Connect(const char* params) {
+    if (!impl_) return kNotCreateConversation;
+    if (connecting_flag_.exchange(true)) return kHasInvoked;
+    ConvRetCode ret = impl_->Connect(params);
+    connecting_flag_ = false;
+    return ret;
+}
+
+ConvRetCode Conversation::Disconnect() {
+    return impl_ ? impl_->Disconnect() : kNotCreateConversation;
+}
+
+ConvRetCode Conversation::Interrupt() {
+    return impl_ ? impl_->Interrupt() : kNotCreateConversation;
+}
+
+ConvRetCode Conversation::SendAudioData(const uint8_t* data, size_t data_size,
+                                        EncoderType type, uint64_t timestamp) {
+    (void)timestamp;
+    if (type == kEncoderOpu2 && data) {
+        // Pre-encoded packets: whole frames of 2-byte big-endian size + data.
+        size_t off = 0;
+        while (off + 2 <= data_size) {
+            size_t len = (static_cast<size_t>(data[off]) << 8) | data[off + 1];
+            if (len == 0) break;
+            off += 2 + len;
+        }
+        if (off != data_size) return kInvalidAudioData;
+    }
+    return impl_ ? impl_->SendAudioData(data, data_size) : kNotCreateConversation;
+}
+
+ConvRetCode Conversation::SendRefData(const uint8_t* data, size_t data_size, uint64_t timestamp) {
+    (void)data;
+    (void)data_size;
+    (void)timestamp;
+    return impl_ ? kSuccess : kNotCreateConversation;
+}
+
+ConvRetCode Conversation::SendResponseData(const char* params) {
+    return impl_ ? impl_->SendResponseData(params) : kNotCreateConversation;
+}
+
+ConvRetCode Conversation::GetResponse(const char* params) {
+    (void)params;
+    return kUnsupportedMode;
+}
+
+ConvRetCode Conversation::SetAction(ConvAction action, const uint8_t* data, size_t data_size) {
+    (void)data;
+    (void)data_size;
+    return impl_ ? impl_->SetAction(action) : kNotCreateConversation;
+}
+
+int Conversation::GetState(StateType type) {
+    return impl_ ? impl_->GetState(type) : 0;
+}
+
+ConvRetCode Conversation::UpdateMessage(const char* params) {
+    (void)params;
+    return impl_ ? kSuccess : kNotCreateConversation;
+}
+
+const char* Conversation::GetVersion() {
+    return kStubVersion;
+}
+
+const char* Conversation::GetParameter(const char* param) {
+    return impl_ ? impl_->GetParameter(param) : "";
+}
+
+}  // namespace convsdk
@@ -0,0 +1,161 @@
+// Stand-in implementation of convsdk::ConversationUtils for the offline stub
+// SDK. Base64 and UUID helpers are real; the "encoder" has no opus behind it
+// and only produces frames of a realistic size, so upstream byte counts and
+// per-frame costs stay in the right ballpark for benchmarking.
+#include "conversation_utils.h"
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace convsdk {
+
+namespace {
+const char kBase64Chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 640 bytes = 20 ms of 16 kHz mono s16le, the SDK's only supported frame.
+const int kDefaultFrameBytes = 640;
+// 20 ms at ~32 kbit/s, what the real encoder typically yields for speech.
+const int kEncodedFrameBytes = 80;
+}  // namespace
+
+class ConversationUtilsImpl {
+ public:
+    ConversationUtilsImpl() : encoder_ready_(false), frame_bytes_(kDefaultFrameBytes) {}
+
+    bool encoder_ready_;
+    int frame_bytes_;
+};
+
+ConversationUtils::ConversationUtils() : impl_(new ConversationUtilsImpl()) {}
+
+ConversationUtils::~ConversationUtils() {
+    delete impl_;
+}
+
+ConversationUtils* ConversationUtils::CreateConversationUtils() {
+    return new ConversationUtils();
+}
+
+void ConversationUtils::DestroyConversationUtils(void* handler) {
+    delete static_cast<ConversationUtils*>(handler);
+}
+
+int ConversationUtils::TryCreateAudioEncoder(std::string type, int channels,
+                                             const int sample_rate, int* errorCode) {
+    bool ok = (type == "opus" || type == "opu" || type == "raw-opus") && channels == 1 &&
+              sample_rate > 0;
+    if (errorCode) *errorCode = ok ? 0 : -1;
+    impl_->encoder_ready_ = ok;
+    return ok ? 0 : -1;
+}
+
+int ConversationUtils::RecreateAudioEncoder(std::string type, int channels,
+                                            const int sample_rate, int* errorCode) {
+    DestroyAudioEncoder();
+    return TryCreateAudioEncoder(type, channels, sample_rate, errorCode);
+}
+
+int ConversationUtils::DestroyAudioEncoder() {
+    impl_->encoder_ready_ = false;
+    return 0;
+}
+
+int ConversationUtils::AudioEncoderSoftRestart() {
+    return impl_->encoder_ready_ ? 0 : -1;
+}
+
+int ConversationUtils::AudioEncoding(const uint8_t* frameBuff, const int frameLen,
+                                     unsigned char* outputBuffer, int outputSize) {
+    if (!impl_->encoder_ready_ || !frameBuff || !outputBuffer) return -1;
+    if (frameLen != impl_->frame_bytes_) return -1;
+    int out = kEncodedFrameBytes * impl_->frame_bytes_ / kDefaultFrameBytes;
+    if (out > outputSize) return -1;
+    // Decimated input: deterministic, content dependent, right size.
+    int stride = frameLen / out;
+    for (int i = 0; i < out; ++i) outputBuffer[i] = frameBuff[i * stride];
+    return out;
+}
+
+int ConversationUtils::GetFrameSampleBytes() {
+    return impl_->frame_bytes_;
+}
+
+int ConversationUtils::SetFrameSampleBytes(int bytes) {
+    if (bytes <= 0 || bytes % 2 != 0) return -1;
+    impl_->frame_bytes_ = bytes;
+    return 0;
+}
+
+int ConversationUtils::TryCreateAudioDecoder(std::string type, int channels,
+                                             const int sample_rate, int* errorCode) {
+    (void)type;
+    (void)channels;
+    (void)sample_rate;
+    if (errorCode) *errorCode = -1;
+    return -1;
+}
+
+int ConversationUtils::RecreateAudioDecoder(std::string type, int channels,
+                                            const int sample_rate, int* errorCode) {
+    return TryCreateAudioDecoder(type, channels, sample_rate, errorCode);
+}
+
+int ConversationUtils::DestroyAudioDecoder() {
+    return 0;
+}
+
+int ConversationUtils::AudioDecoding(const uint8_t* frameBuff, const int frameLen,
+                                     uint8_t* outputBuffer, int outputBufferBytes) {
+    (void)frameBuff;
+    (void)frameLen;
+    (void)outputBuffer;
+    (void)outputBufferBytes;
+    return -1;
+}
+
+std::string ConversationUtils::Base64Encode(const std::vector<uint8_t>& data) {
+    std::string out;
+    out.reserve((data.size() + 2) / 3 * 4);
+    std::size_t i = 0;
+    for (; i + 2 < data.size(); i += 3) {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out.push_back(kBase64Chars[(v >> 18) & 0x3f]);
+        out.push_back(kBase64Chars[(v >> 12) & 0x3f]);
+        out.push_back(kBase64Chars[(v >> 6) & 0x3f]);
+        out.push_back(kBase64Chars[v & 0x3f]);
+    }
+    if (i < data.size()) {
+        uint32_t v = data[i] << 16;
+        if (i + 1 < data.size()) v |= data[i + 1] << 8;
+        out.push_back(kBase64Chars[(v >> 18) & 0x3f]);
+        out.push_back(kBase64Chars[(v >> 12) & 0x3f]);
+        out.push_back(i + 1 < data.size() ? kBase64Chars[(v >> 6) & 0x3f] : '=');
+        out.push_back('=');
+    }
+    return out;
+}
+
+std::string ConversationUtils::Base64EncodeFromFilePath(const std::string filePath) {
+    std::ifstream in(filePath.c_str(), std::ios::binary);
+    if (!in) return std::string();
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return Base64Encode(data);
+}
+
+std::string ConversationUtils::RandomUUID() {
+    static const char kHex[] = "0123456789abcdef";
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<int> dist(0, 15);
+    std::string uuid = "xxxxxxxxxxxx4xxxyxxxxxxxxxxxxxxx";
+    for (std::size_t i = 0; i < uuid.size(); ++i) {
+        if (uuid[i] == 'x') uuid[i] = kHex[dist(gen)];
+        else if (uuid[i] == 'y') uuid[i] = kHex[8 + (dist(gen) & 3)];
+    }
+    return uuid;
+}
+
+}  // namespace convsdk
@@ -0,0 +1,399 @@
+#include "scripted_dialog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "conv_constants.h"
+
+namespace {
+const double kTwoPi = 6.283185307179586;
+
+const char* DialogStateName(int state) {
+    switch (state) {
+    case convsdk::kDialogListening: return "Listening";
+    case convsdk::kDialogResponding: return "Responding";
+    case convsdk::kDialogThinking: return "Thinking";
+    default: return "Idle";
+    }
+}
+
+// Split into UTF-8 code points so partial texts never cut a character.
+std::vector<std::string> SplitUtf8(const std::string& s) {
+    std::vector<std::string> out;
+    for (std::size_t i = 0; i < s.size();) {
+        std::size_t len = 1;
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0xf0) len = 4;
+        else if (c >= 0xe0) len = 3;
+        else if (c >= 0xc0) len = 2;
+        out.push_back(s.substr(i, len));
+        i += len;
+    }
+    return out;
+}
+}
+
+ScriptedDialog::ScriptedDialog(const StubScenario& scenario, TextSink on_text, BinarySink on_binary)
+    : scenario_(scenario),
+      on_text_(on_text),
+      on_binary_(on_binary),
+      running_(false),
+      phase_(kPhaseIdle),
+      dialog_state_(convsdk::kDialogIdle),
+      speech_started_(false),
+      round_seq_(0),
+      uplink_bytes_(0),
+      tone_phase_(0.0),
+      rng_(scenario.seed) {}
+
+ScriptedDialog::~ScriptedDialog() {
+    Stop();
+}
+
+void ScriptedDialog::Start(const std::string& task_id, const std::string& dialog_id) {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (running_) return;
+        task_id_ = task_id;
+        dialog_id_ = dialog_id;
+        running_ = true;
+        last_scheduled_ = Clock::now();
+        ScheduleAfter(0, [this]() { EmitOutput("Started", Json::Value()); });
+        ScheduleAfter(0, [this]() { EmitState(convsdk::kDialogIdle); });
+    }
+    worker_ = std::thread(&ScriptedDialog::WorkerMain, this);
+}
+
+void ScriptedDialog::Stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        running_ = false;
+        timeline_.clear();
+    }
+    cv_.notify_one();
+    if (worker_.joinable()) worker_.join();
+}
+
+bool ScriptedDialog::StartSpeech() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!running_ || phase_ != kPhaseIdle) return false;
+    phase_ = kPhaseListening;
+    speech_started_ = false;
+    ScheduleAfter(JitteredLocked(scenario_.listening_ms), [this]() { EmitState(convsdk::kDialogListening); });
+    cv_.notify_one();
+    return true;
+}
+
+bool ScriptedDialog::OnAudio(std::size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!running_ || phase_ != kPhaseListening) return false;
+    uplink_bytes_ += bytes;
+    if (!speech_started_) {
+        speech_started_ = true;
+        ScheduleAfter(0, [this]() { EmitOutput("SpeechStarted", Json::Value()); });
+        cv_.notify_one();
+    }
+    return true;
+}
+
+bool ScriptedDialog::StopSpeech() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!running_ || phase_ != kPhaseListening) return false;
+    ScheduleRound(scenario_.response_text, true);
+    cv_.notify_one();
+    return true;
+}
+
+bool ScriptedDialog::CancelSpeech() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!running_ || phase_ != kPhaseListening) return false;
+    phase_ = kPhaseBusy;
+    ScheduleIdle(0);
+    cv_.notify_one();
+    return true;
+}
+
+bool ScriptedDialog::Request(const std::string& text, bool with_llm) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!running_ || phase_ != kPhaseIdle) return false;
+    // A prompt is answered by the "LLM"; a transcript is synthesized verbatim.
+    std::string reply = with_llm || text.empty() ? scenario_.response_text : text;
+    ScheduleRound(reply, with_llm);
+    cv_.notify_one();
+    return true;
+}
+
+bool ScriptedDialog::PlayerStopped() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!running_ || phase_ != kPhaseWaitPlayer) return false;
+    phase_ = kPhaseBusy;
+    ScheduleIdle(JitteredLocked(scenario_.idle_ms));
+    cv_.notify_one();
+    return true;
+}
+
+bool ScriptedDialog::Interrupt() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!running_ || (phase_ != kPhaseBusy && phase_ != kPhaseWaitPlayer)) return false;
+    timeline_.clear();
+    last_scheduled_ = Clock::now();
+    phase_ = kPhaseBusy;
+    ScheduleAfter(0, [this]() { EmitOutput("RequestAccepted", Json::Value()); });
+    ScheduleIdle(JitteredLocked(scenario_.idle_ms));
+    cv_.notify_one();
+    return true;
+}
+
+std::string ScriptedDialog::RenderOutput(const char* event, Json::Value output) {
+    Json::Value root;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        root["header"]["task_id"] = task_id_;
+        output["dialog_id"] = dialog_id_;
+    }
+    root["header"]["event"] = "result-generated";
+    output["event"] = event;
+    root["payload"]["output"] = output;
+
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    return Json::writeString(writer, root);
+}
+
+int ScriptedDialog::Jittered(int ms) {
+    std::lock_guard<std::mutex> guard(lock_);
+    return JitteredLocked(ms);
+}
+
+int ScriptedDialog::dialog_state() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return dialog_state_;
+}
+
+uint64_t ScriptedDialog::uplink_bytes() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return uplink_bytes_;
+}
+
+uint64_t ScriptedDialog::rounds() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return round_seq_;
+}
+
+void ScriptedDialog::WorkerMain() {
+    std::unique_lock<std::mutex> guard(lock_);
+    while (running_) {
+        if (timeline_.empty()) {
+            cv_.wait(guard);
+            continue;
+        }
+        Clock::time_point when = timeline_.begin()->first;
+        if (Clock::now() < when) {
+            cv_.wait_until(guard, when);
+            continue;
+        }
+        Step step;
+        step.swap(timeline_.begin()->second);
+        timeline_.erase(timeline_.begin());
+        guard.unlock();
+        step();
+        guard.lock();
+    }
+}
+
+ScriptedDialog::Clock::time_point ScriptedDialog::NextTime(int delay_ms) const {
+    // Relative to the last scheduled step, or to "now" once the timeline
+    // has caught up.
+    Clock::time_point base = timeline_.empty() ? std::max(last_scheduled_, Clock::now()) : last_scheduled_;
+    return base + std::chrono::milliseconds(delay_ms);
+}
+
+void ScriptedDialog::ScheduleAfter(int delay_ms, Step step) {
+    ScheduleAt(NextTime(delay_ms), step);
+}
+
+void ScriptedDialog::ScheduleAt(Clock::time_point when, Step step) {
+    if (when < last_scheduled_) when = last_scheduled_;
+    last_scheduled_ = when;
+    timeline_.insert(std::make_pair(when, step));
+}
+
+void ScriptedDialog::ScheduleIdle(int delay_ms) {
+    ScheduleAfter(delay_ms, [this]() {
+        bool drop = false;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            phase_ = kPhaseIdle;
+            if (scenario_.drop_after_rounds > 0 &&
+                round_seq_ >= static_cast<uint64_t>(scenario_.drop_after_rounds)) {
+                phase_ = kPhaseDropped;
+                drop = true;
+            }
+        }
+        EmitState(convsdk::kDialogIdle);
+        if (drop) EmitTaskFailed("connection lost (scenario drop_after_rounds)");
+    });
+}
+
+void ScriptedDialog::ScheduleRound(const std::string& text, bool with_llm) {
+    phase_ = kPhaseBusy;
+    std::ostringstream id;
+    id << "stub-round-" << ++round_seq_;
+    round_id_ = id.str();
+    const std::string round_id = round_id_;
+
+    if (with_llm) {
+        if (speech_started_) {
+            std::string asr = scenario_.asr_text;
+            ScheduleAfter(JitteredLocked(scenario_.sentence_end_ms), [this, asr, round_id]() {
+                Json::Value output;
+                output["round_id"] = round_id;
+                output["text"] = asr;
+                output["finished"] = true;
+                EmitOutput("SpeechContent", output);
+            });
+            ScheduleAfter(0, [this, round_id]() {
+                Json::Value output;
+                output["round_id"] = round_id;
+                EmitOutput("SpeechEnded", output);
+            });
+        }
+        ScheduleAfter(0, [this]() { EmitState(convsdk::kDialogThinking); });
+        ScheduleAfter(JitteredLocked(scenario_.thinking_ms), [this]() { EmitState(convsdk::kDialogResponding); });
+    } else {
+        ScheduleAfter(0, [this]() { EmitState(convsdk::kDialogResponding); });
+    }
+    speech_started_ = false;
+
+    ScheduleAfter(0, [this, round_id]() {
+        Json::Value output;
+        output["round_id"] = round_id;
+        EmitOutput("RespondingStarted", output);
+    });
+
+    // Downlink: tts_ms (or tts_ms_per_char per reply character) of 16 bit
+    // mono PCM, cut into packet_bytes and sent burst_speed times faster than
+    // real time, with the transcript deltas spread evenly over the packets.
+    // synth_ms_per_char models a synthesizer that needs the whole text
+    // before its first packet.
+    std::vector<std::string> chars = SplitUtf8(text);
+    const std::size_t bytes_per_ms = static_cast<std::size_t>(scenario_.tts_sample_rate) * 2 / 1000;
+    const std::size_t audio_ms = scenario_.tts_ms_per_char > 0
+        ? chars.size() * static_cast<std::size_t>(scenario_.tts_ms_per_char)
+        : static_cast<std::size_t>(scenario_.tts_ms);
+    std::size_t total = audio_ms * bytes_per_ms;
+    std::size_t packet = static_cast<std::size_t>(scenario_.packet_bytes);
+    std::size_t packets = total == 0 ? 0 : (total + packet - 1) / packet;
+    std::size_t chunks = static_cast<std::size_t>(scenario_.detail_chunks);
+
+    const int synth_ms = static_cast<int>(chars.size()) * scenario_.synth_ms_per_char;
+    Clock::time_point start = NextTime(JitteredLocked(scenario_.first_packet_ms + synth_ms));
+    const double ns_per_byte = 1e6 / static_cast<double>(bytes_per_ms) / scenario_.burst_speed;
+    std::size_t sent_chunks = 0;
+    for (std::size_t i = 0; i < packets; ++i) {
+        std::size_t offset = i * packet;
+        std::size_t size = std::min(packet, total - offset);
+        Clock::time_point when = start + std::chrono::nanoseconds(static_cast<int64_t>(offset * ns_per_byte)) +
+                                 std::chrono::milliseconds(JitteredLocked(0));
+        ScheduleAt(when, [this, size]() { EmitBinary(size); });
+
+        // Text runs slightly ahead of audio, as the real service does.
+        while (sent_chunks < chunks && sent_chunks * packets <= i * chunks) {
+            ++sent_chunks;
+            std::size_t upto = chars.size() * sent_chunks / chunks;
+            std::string partial;
+            for (std::size_t c = 0; c < upto; ++c) partial += chars[c];
+            bool finished = sent_chunks == chunks;
+            ScheduleAt(when, [this, partial, finished, round_id]() {
+                Json::Value output;
+                output["round_id"] = round_id;
+                output["text"] = partial;
+                output["finished"] = finished;
+                EmitOutput("RespondingContent", output);
+            });
+        }
+    }
+    if (packets == 0) {
+        // Text-only reply: a single final detail.
+        std::string full = text;
+        ScheduleAfter(0, [this, full, round_id]() {
+            Json::Value output;
+            output["round_id"] = round_id;
+            output["text"] = full;
+            output["finished"] = true;
+            EmitOutput("RespondingContent", output);
+        });
+    }
+
+    ScheduleAfter(0, [this, round_id]() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            phase_ = kPhaseWaitPlayer;
+        }
+        Json::Value output;
+        output["round_id"] = round_id;
+        EmitOutput("RespondingEnded", output);
+    });
+}
+
+int ScriptedDialog::JitteredLocked(int ms) {
+    if (scenario_.jitter_ms <= 0) return ms;
+    std::uniform_int_distribution<int> dist(-scenario_.jitter_ms, scenario_.jitter_ms);
+    int value = ms + dist(rng_);
+    return value < 0 ? 0 : value;
+}
+
+void ScriptedDialog::EmitOutput(const char* event, Json::Value output) {
+    if (on_text_) on_text_(RenderOutput(event, output));
+}
+
+void ScriptedDialog::EmitTaskFailed(const std::string& message) {
+    Json::Value root;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        root["header"]["task_id"] = task_id_;
+    }
+    root["header"]["event"] = "task-failed";
+    root["header"]["error_message"] = message;
+    root["payload"] = Json::Value(Json::objectValue);
+
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    if (on_text_) on_text_(Json::writeString(writer, root));
+}
+
+void ScriptedDialog::EmitState(int state) {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        dialog_state_ = state;
+    }
+    Json::Value output;
+    output["state"] = DialogStateName(state);
+    EmitOutput("DialogStateChanged", output);
+}
+
+void ScriptedDialog::EmitBinary(std::size_t bytes) {
+    std::string round_id;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        round_id = round_id_;
+    }
+    std::vector<unsigned char> pcm = Synthesize(bytes);
+    if (on_binary_) on_binary_(pcm, round_id);
+}
+
+std::vector<unsigned char> ScriptedDialog::Synthesize(std::size_t bytes) {
+    // 440 Hz tone at -12 dBFS; phase carries over so packets join cleanly.
+    // Only the delivery thread calls this, so tone_phase_ needs no lock.
+    std::vector<unsigned char> pcm(bytes & ~static_cast<std::size_t>(1));
+    const double step = kTwoPi * 440.0 / scenario_.tts_sample_rate;
+    for (std::size_t i = 0; i + 1 < pcm.size(); i += 2) {
+        int16_t s = static_cast<int16_t>(8192.0 * std::sin(tone_phase_));
+        pcm[i] = static_cast<unsigned char>(s & 0xff);
+        pcm[i + 1] = static_cast<unsigned char>((s >> 8) & 0xff);
+        tone_phase_ += step;
+        if (tone_phase_ > kTwoPi) tone_phase_ -= kTwoPi;
+    }
+    return pcm;
+}
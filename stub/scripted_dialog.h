@@ -0,0 +1,123 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json/json.h"
+#include "stub_scenario.h"
+
+/**
+ * @brief 脚本化的服务端对话时间线
+ *
+ * The server half of a DashScope duplex dialog, driven by a StubScenario.
+ * Client inputs (speech start/stop, uplink audio, text requests, player
+ * stopped, interrupt) schedule the replies the service would send; a worker
+ * thread delivers them at their scheduled time through two sinks:
+ *
+ *   - text:   a complete `result-generated` JSON message
+ *             (payload.output.event = Started, DialogStateChanged, ...)
+ *   - binary: a downlink PCM packet of the current round
+ *
+ * Shared by the in-process stand-in SDK, which turns the messages into
+ * ConvEvents, and the loopback WebSocket server, which sends them as frames.
+ * Both therefore replay a scenario file identically.
+ */
+class ScriptedDialog {
+ public:
+    typedef std::function<void(const std::string& json)> TextSink;
+    typedef std::function<void(std::vector<unsigned char>& pcm, const std::string& round_id)> BinarySink;
+
+    ScriptedDialog(const StubScenario& scenario, TextSink on_text, BinarySink on_binary);
+    ~ScriptedDialog();
+
+    ScriptedDialog(const ScriptedDialog&) = delete;
+    ScriptedDialog& operator=(const ScriptedDialog&) = delete;
+
+    // Start the delivery thread and emit Started + IDLE.
+    void Start(const std::string& task_id, const std::string& dialog_id);
+    // Drop everything still scheduled and join the delivery thread.
+    void Stop();
+
+    // Client inputs. Each returns false if the dialog is not in a state
+    // where the server would accept it.
+    bool StartSpeech();
+    bool OnAudio(std::size_t bytes);
+    bool StopSpeech();
+    bool CancelSpeech();
+    // "prompt" (with_llm) goes through THINKING; "transcript" is spoken as-is.
+    bool Request(const std::string& text, bool with_llm);
+    bool PlayerStopped();
+    bool Interrupt();
+
+    // Render a `result-generated` message for `event`; used for replies
+    // outside the scripted timeline (e.g. Stopped on disconnect).
+    std::string RenderOutput(const char* event, Json::Value output);
+
+    // Milliseconds after the scenario's jitter, from the dialog's generator.
+    int Jittered(int ms);
+
+    int dialog_state() const;
+    uint64_t uplink_bytes() const;
+    uint64_t rounds() const;
+    const StubScenario& scenario() const { return scenario_; }
+
+ private:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<void()> Step;
+
+    // What the scripted server is waiting for. Changes synchronously with
+    // client inputs, unlike the dialog state, which is only updated when the
+    // corresponding event is delivered.
+    enum Phase {
+        kPhaseIdle,
+        kPhaseListening,
+        kPhaseBusy,        // thinking / synthesizing
+        kPhaseWaitPlayer,  // output done, waiting for the player to finish
+        kPhaseDropped,     // connection failed (drop_after_rounds); refuses everything
+    };
+
+    void WorkerMain();
+    // Everything below expects lock_ to be held, except the Emit* helpers.
+    Clock::time_point NextTime(int delay_ms) const;
+    void ScheduleAfter(int delay_ms, Step step);
+    void ScheduleAt(Clock::time_point when, Step step);
+    void ScheduleRound(const std::string& text, bool with_llm);
+    void ScheduleIdle(int delay_ms);
+    int JitteredLocked(int ms);
+
+    void EmitOutput(const char* event, Json::Value output);
+    void EmitTaskFailed(const std::string& message);
+    void EmitState(int state);
+    void EmitBinary(std::size_t bytes);
+    std::vector<unsigned char> Synthesize(std::size_t bytes);
+
+    StubScenario scenario_;
+    TextSink on_text_;
+    BinarySink on_binary_;
+
+    mutable std::mutex lock_;
+    std::condition_variable cv_;
+    std::multimap<Clock::time_point, Step> timeline_;
+    // Steps are scheduled monotonically so jitter never reorders events.
+    Clock::time_point last_scheduled_;
+    std::thread worker_;
+    bool running_;
+    Phase phase_;
+    int dialog_state_;
+    bool speech_started_;
+    uint64_t round_seq_;
+    uint64_t uplink_bytes_;
+    double tone_phase_;
+    std::string task_id_;
+    std::string dialog_id_;
+    std::string round_id_;
+    std::mt19937 rng_;
+};
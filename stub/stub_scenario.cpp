@@ -0,0 +1,79 @@
+#include "stub_scenario.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "json/json.h"
+
+namespace {
+void ReadInt(const Json::Value& root, const char* key, int* out) {
+    if (root.isMember(key) && root[key].isNumeric()) *out = root[key].asInt();
+}
+
+void ReadString(const Json::Value& root, const char* key, std::string* out) {
+    if (root.isMember(key) && root[key].isString()) *out = root[key].asString();
+}
+}
+
+bool StubScenario::LoadFile(const std::string& path, std::string* error) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        if (error) *error = "cannot open " + path;
+        return false;
+    }
+    Json::CharReaderBuilder builder;
+    Json::Value root;
+    std::string errs;
+    if (!Json::parseFromStream(builder, in, &root, &errs) || !root.isObject()) {
+        if (error) *error = "invalid scenario " + path + ": " + errs;
+        return false;
+    }
+
+    ReadInt(root, "connect_ms", &connect_ms);
+    ReadInt(root, "listening_ms", &listening_ms);
+    ReadInt(root, "sentence_end_ms", &sentence_end_ms);
+    ReadInt(root, "thinking_ms", &thinking_ms);
+    ReadInt(root, "first_packet_ms", &first_packet_ms);
+    ReadInt(root, "idle_ms", &idle_ms);
+    ReadInt(root, "drop_after_rounds", &drop_after_rounds);
+    ReadInt(root, "jitter_ms", &jitter_ms);
+    if (root.isMember("seed") && root["seed"].isNumeric()) seed = root["seed"].asUInt();
+
+    ReadInt(root, "tts_sample_rate", &tts_sample_rate);
+    ReadInt(root, "tts_ms", &tts_ms);
+    ReadInt(root, "tts_ms_per_char", &tts_ms_per_char);
+    ReadInt(root, "synth_ms_per_char", &synth_ms_per_char);
+    ReadInt(root, "packet_bytes", &packet_bytes);
+    if (root.isMember("burst_speed") && root["burst_speed"].isNumeric()) {
+        burst_speed = root["burst_speed"].asDouble();
+    }
+    ReadInt(root, "detail_chunks", &detail_chunks);
+
+    ReadString(root, "asr_text", &asr_text);
+    ReadString(root, "response_text", &response_text);
+
+    // Keep the generator well defined for hand-edited files.
+    if (packet_bytes < 2) packet_bytes = 2;
+    packet_bytes &= ~1;
+    if (burst_speed <= 0.0) burst_speed = 1.0;
+    if (detail_chunks < 1) detail_chunks = 1;
+    if (tts_sample_rate <= 0) tts_sample_rate = 24000;
+    if (jitter_ms < 0) jitter_ms = 0;
+    if (drop_after_rounds < 0) drop_after_rounds = 0;
+    if (tts_ms_per_char < 0) tts_ms_per_char = 0;
+    if (synth_ms_per_char < 0) synth_ms_per_char = 0;
+    return true;
+}
+
+StubScenario StubScenario::FromEnv() {
+    StubScenario scenario;
+    const char* path = std::getenv("CONV_STUB_SCENARIO");
+    if (path && *path) {
+        std::string error;
+        if (!scenario.LoadFile(path, &error)) {
+            std::cerr << "[conv-stub] " << error << ", using built-in defaults" << std::endl;
+        }
+    }
+    return scenario;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief 离线替身SDK的脚本参数
+ *
+ * Describes the timing and payload shape of the scripted server replies the
+ * stand-in SDK produces. All delays are in milliseconds and are relative to
+ * the previous step of the round; `jitter_ms` adds a uniform +/- offset to
+ * every scheduled step, drawn from a generator seeded with `seed`, so a given
+ * scenario file replays the exact same timeline on every run.
+ *
+ * Loaded from the JSON file named by $CONV_STUB_SCENARIO (see
+ * stub/scenarios/default.json); missing keys keep their defaults.
+ */
+struct StubScenario {
+    int connect_ms = 80;            // Connect() blocking time
+    int listening_ms = 30;          // StartHumanSpeech -> LISTENING
+    int sentence_end_ms = 120;      // StopHumanSpeech -> SentenceEnd + THINKING
+    int thinking_ms = 400;          // THINKING -> RESPONDING + DataOutputStarted
+    int first_packet_ms = 150;      // DataOutputStarted -> first kBinary
+    int idle_ms = 20;               // kPlayerStopped -> IDLE
+    int drop_after_rounds = 0;      // connection fails after this many rounds (0 = never)
+    int jitter_ms = 0;
+    uint32_t seed = 42;
+
+    int tts_sample_rate = 24000;    // overridden by downstream.sample_rate in Connect()
+    int tts_ms = 2000;              // synthesized audio per response
+    int tts_ms_per_char = 0;        // if > 0: audio length follows the reply text instead
+    int synth_ms_per_char = 0;      // extra first-packet delay per reply character
+    int packet_bytes = 3840;        // kBinary payload size (80 ms at 24 kHz)
+    double burst_speed = 4.0;       // downlink speed relative to real time
+    int detail_chunks = 6;          // kRespondingDetail events per response
+
+    std::string asr_text = "你好，请介绍一下你自己。";
+    std::string response_text = "你好，我是一个离线测试用的语音助手，这段回复由脚本生成。";
+
+    // Parse `path` over the defaults. Returns false and fills `error` if the
+    // file cannot be read or is not a JSON object.
+    bool LoadFile(const std::string& path, std::string* error);
+
+    // Defaults, or the file named by $CONV_STUB_SCENARIO when set.
+    static StubScenario FromEnv();
+};